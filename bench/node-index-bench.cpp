@@ -0,0 +1,213 @@
+/*
+Copyright (c) 2015 Perutka, Ondrej
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+
+#include "dictionary.hpp"
+#include "utils.hpp"
+#include "exception.hpp"
+#include "rb-node-index.hpp"
+
+using namespace alzw;
+
+/**
+ * Simple xorshift generator (both indices must see exactly the same 
+ * sequence of operations, so rand() is not used).
+ *
+ * @param state generator state
+ * @returns next pseudo-random number
+ */
+static uint64_t next_random(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+/**
+ * Grow a dictionary the way the decoder does: new (possibly collapsed) 
+ * nodes get the next free IDs and a given percentage of the steps splits 
+ * a random collapsed node, which inserts an ID in the middle of the index.
+ *
+ * @param allocator node allocator
+ * @param count     number of real nodes
+ * @param max_len   maximum length of a new phrase
+ * @param splits    percentage of splits
+ */
+static void build(node_allocator& allocator, size_t count, uint32_t max_len, 
+    uint32_t splits) {
+    std::vector<node*> collapsed;
+    std::vector<uint8_t> phrase(max_len);
+    node* root = allocator.alloc_root();
+    node* children[256];
+    uint64_t state = 88172645463325252ULL;
+    uint32_t len;
+    node* n;
+    
+    while (allocator.real_nodes() < count) {
+        if (!collapsed.empty() && next_random(state) % 100 < splits) {
+            size_t i = next_random(state) % collapsed.size();
+            n = collapsed[i];
+            allocator.split(n, next_random(state) % n->length());
+            n->get_children(children);
+            if (children[0]->collapsed())
+                collapsed.push_back(children[0]);
+            if (!n->collapsed()) {
+                collapsed[i] = collapsed.back();
+                collapsed.pop_back();
+            }
+        } else {
+            len = 1 + next_random(state) % max_len;
+            for (uint32_t i = 0; i < len; i++)
+                phrase[i] = next_random(state) & 3;
+            n = allocator.alloc(phrase.data(), len, root);
+            if (n->collapsed())
+                collapsed.push_back(n);
+        }
+    }
+}
+
+/**
+ * Look up a given number of random codewords.
+ *
+ * @param allocator node allocator
+ * @param count     number of lookups
+ * @returns checksum of the found node IDs
+ */
+template <class T>
+static uint64_t lookup(T& allocator, size_t count) {
+    uint64_t state = 2463534242ULL;
+    uint64_t codewords = allocator.next_id();
+    uint64_t sum = 0;
+    node* n;
+    
+    for (size_t i = 0; i < count; i++) {
+        if ((n = allocator.get(next_random(state) % codewords)))
+            sum += n->id();
+    }
+    
+    return sum;
+}
+
+/**
+ * Run the benchmark for a given node allocator and print the results.
+ *
+ * @param name      index name
+ * @param allocator node allocator
+ * @param nodes     number of real nodes
+ * @param gets      number of lookups
+ * @param max_len   maximum length of a new phrase
+ * @param splits    percentage of splits
+ */
+template <class T>
+static void run(const char* name, T& allocator, size_t nodes, size_t gets, 
+    uint32_t max_len, uint32_t splits) {
+    double t = utils::wall_time();
+    build(allocator, nodes, max_len, splits);
+    double build_time = utils::wall_time() - t;
+    
+    t = utils::wall_time();
+    uint64_t sum = lookup(allocator, gets);
+    double get_time = utils::wall_time() - t;
+    
+    printf("%s\n", name);
+    printf("    nodes:             %lu\n", (unsigned long)allocator.real_nodes());
+    printf("    codewords:         %lu\n", (unsigned long)allocator.next_id());
+    printf("    memory [MB]:       %.1f\n", allocator.used_memory() / 1048576.0);
+    printf("    insert/split [s]:  %f\n", build_time);
+    printf("    get [s]:           %f\n", get_time);
+    printf("    checksum:          %016llx\n", (unsigned long long)sum);
+}
+
+int main(int argc, const char** argv) {
+    const char* usage = 
+        "USAGE: node-index-bench [OPTIONS]\n\n"
+        "Compare the paged node index with the RB tree it replaced. Both indices\n"
+        "go through the same sequence of node insertions and splits and then\n"
+        "answer the same random codeword lookups (dictionary::get()).\n\n"
+        "OPTIONS\n\n"
+        "    -n num number of dictionary nodes [5000000]\n"
+        "    -g num number of lookups [10000000]\n"
+        "    -l len maximum phrase length, 1 gives dense IDs [1]\n"
+        "    -s pct percentage of steps splitting a collapsed node [20]\n"
+        "    -h     show help\n";
+    
+    size_t n = 5000000;
+    size_t g = 10000000;
+    uint32_t l = 1;
+    uint32_t s = 20;
+    
+    for (int i = 1; i < argc; i++) {
+        const char* option = argv[i] + 1;
+        
+        if (*argv[i] != '-' || !*option) {
+            fprintf(stderr, "unexpected argument: %s\n\n", argv[i]);
+            fprintf(stderr, "%s\n", usage);
+            return 1;
+        } else if (!strcmp("h", option)) {
+            printf("%s\n", usage);
+            return 0;
+        } else if (i + 1 >= argc) {
+            fprintf(stderr, "missing value of option: -%s\n\n", option);
+            fprintf(stderr, "%s\n", usage);
+            return 1;
+        } else if (!strcmp("n", option))
+            n = strtoul(argv[++i], NULL, 10);
+        else if (!strcmp("g", option))
+            g = strtoul(argv[++i], NULL, 10);
+        else if (!strcmp("l", option))
+            l = strtoul(argv[++i], NULL, 10);
+        else if (!strcmp("s", option))
+            s = strtoul(argv[++i], NULL, 10);
+        else {
+            fprintf(stderr, "unrecognized option: -%s\n\n", option);
+            fprintf(stderr, "%s\n", usage);
+            return 1;
+        }
+    }
+    
+    if (l < 1) {
+        fprintf(stderr, "invalid phrase length: %u\n\n", l);
+        fprintf(stderr, "%s\n", usage);
+        return 1;
+    }
+    
+    try {
+        // the RB tree is released before the paged index is built
+        rb_node_allocator* rb = new rb_node_allocator;
+        run("RB tree", *rb, n, g, l, s);
+        delete rb;
+        
+        indexed_node_allocator* paged = new indexed_node_allocator;
+        run("paged index", *paged, n, g, l, s);
+        delete paged;
+    } catch (std::exception& ex) {
+        fprintf(stderr, "ERROR: %s\n", ex.what());
+        return 2;
+    }
+    
+    return 0;
+}
+
@@ -0,0 +1,368 @@
+/*
+Copyright (c) 2015 Perutka, Ondrej
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "rb-node-index.hpp"
+#include "exception.hpp"
+
+using namespace alzw;
+
+// #####################
+// rb_node_index methods
+// #####################
+
+rb_node_index::rb_node_index() {
+    root = NULL;
+    count = 0;
+}
+
+rb_node_index::~rb_node_index() {
+    free_tree(root);
+}
+
+rb_node_index::rb_node::rb_node(node* n) {
+    this->n = n;
+    this->parent = NULL;
+    this->left = NULL;
+    this->right = NULL;
+    this->black = false;
+}
+
+void rb_node_index::free_tree(rb_node* n) {
+    if (!n)
+        return;
+    
+    free_tree(n->left);
+    free_tree(n->right);
+    delete n;
+}
+
+void rb_node_index::insert(rb_node* n) {
+    if (root)
+        insert(root, n);
+    else
+        root = n;
+    
+    insert_normalize(n);
+    
+    count++;
+}
+
+void rb_node_index::insert(rb_node* tree, rb_node* n) {
+    uint64_t tid, nid = n->n->id();
+    
+    while (!n->parent) {
+        tid = tree->n->id();
+        if (nid == tid)
+            throw runtime_exception("duplicate id");
+        else if (nid < tid && tree->left)
+            tree = tree->left;
+        else if (nid < tid) {
+            tree->left = n;
+            n->parent = tree;
+        } else if (tree->right)
+            tree = tree->right;
+        else {
+            tree->right = n;
+            n->parent = tree;
+        }
+    }
+}
+
+void rb_node_index::insert_normalize(rb_node* n) {
+    rb_node* parent = n->parent;
+    rb_node* gp = grandparent(n);
+    rb_node* u = uncle(n);
+    
+    if (!parent)
+        n->black = true;
+    if (!parent || parent->black)
+        return;
+    
+    if (u && !u->black) {
+        parent->black = true;
+        u->black = true;
+        gp->black = false;
+        insert_normalize(gp);
+    } else {
+        if (n == parent->right && parent == gp->left) {
+            rotate_left(parent);
+            n = n->left;
+        } else if (n == parent->left && parent == gp->right) {
+            rotate_right(parent);
+            n = n->right;
+        }
+        
+        parent = n->parent;
+        parent->black = true;
+        gp->black = false;
+        
+        if (n == parent->left)
+            rotate_right(gp);
+        else
+            rotate_left(gp);
+    }
+}
+
+rb_node_index::rb_node * rb_node_index::grandparent(rb_node* n) {
+    if (n && n->parent)
+        return n->parent->parent;
+    
+    return NULL;
+}
+
+rb_node_index::rb_node * rb_node_index::uncle(rb_node* n) {
+    rb_node* gp = grandparent(n);
+    if (!gp)
+        return NULL;
+    
+    if (n->parent == gp->left)
+        return gp->right;
+    
+    return gp->left;
+}
+
+void rb_node_index::add(node* n) {
+    insert(new rb_node(n));
+}
+
+void rb_node_index::remove(rb_node* n) {
+    // swap with predecessor if the node has both children
+    if (n->left && n->right) {
+        rb_node* tmp = pred(n);
+        n->n = tmp->n;
+        n = tmp;
+    }
+    
+    rb_node* tmp = n->left ? n->left : n->right;
+    rb_node* parent = n->parent;
+    
+    // set the child's parent
+    if (tmp)
+        tmp->parent = parent;
+    
+    // move the only child (if any) to the parent
+    if (!parent) {
+        if (tmp)
+            tmp->black = true;
+        root = tmp;
+    } else if (n == parent->left)
+        parent->left = tmp;
+    else
+        parent->right = tmp;
+    
+    if (is_black(n)) {
+        if (!is_black(tmp))
+            tmp->black = true;
+        else
+            remove_normalize(parent, tmp);
+    }
+    
+    delete n;
+    count--;
+}
+
+void rb_node_index::remove_normalize(rb_node* parent, rb_node* n) {
+    if (!parent)
+        return;
+    
+    rb_node* sibling = parent->left == n ? parent->right : parent->left;
+    if (!is_black(sibling)) {
+        parent->black = false;
+        sibling->black = true;
+        if (sibling == parent->left)
+            rotate_right(parent);
+        else
+            rotate_left(parent);
+    }
+    
+    remove_normalize2(parent, n);
+}
+
+void rb_node_index::remove_normalize2(rb_node* parent, rb_node* n) {
+    rb_node* sibling = parent->left == n ? parent->right : parent->left;
+    
+    if (is_black(parent)
+        && is_black(sibling)
+        && is_black(sibling->left) 
+        && is_black(sibling->right)) {
+        sibling->black = false;
+        remove_normalize(parent->parent, parent);
+    } else if (!is_black(parent)
+        && is_black(sibling)
+        && is_black(sibling->left) 
+        && is_black(sibling->right)) {
+        sibling->black = false;
+        parent->black = true;
+    } else
+        remove_normalize3(parent, n);
+}
+
+void rb_node_index::remove_normalize3(rb_node* parent, rb_node* n) {
+    rb_node* sibling = parent->left == n ? parent->right : parent->left;
+    
+    if (n == parent->left && is_black(sibling->right)) {
+        sibling->black = false;
+        sibling->left->black = true;
+        rotate_right(sibling);
+        sibling = sibling->parent;
+    } else if (n == parent->right && is_black(sibling->left)) {
+        sibling->black = false;
+        sibling->right->black = true;
+        rotate_left(sibling);
+        sibling = sibling->parent;
+    }
+    
+    sibling->black = parent->black;
+    parent->black = true;
+    
+    if (n == parent->left) {
+        sibling->right->black = true;
+        rotate_left(parent);
+    } else {
+        sibling->left->black = true;
+        rotate_right(parent);
+    }
+}
+
+void rb_node_index::rotate_left(rb_node* n) {
+    rb_node* parent = n->parent;
+    rb_node* right = n->right;
+    
+    n->right = right->left;
+    if (n->right)
+        n->right->parent = n;
+    
+    right->left = n;
+    right->parent = parent;
+    n->parent = right;
+    
+    if (!parent)
+        root = right;
+    else if (n == parent->left)
+        parent->left = right;
+    else
+        parent->right = right;
+}
+
+void rb_node_index::rotate_right(rb_node* n) {
+    rb_node* parent = n->parent;
+    rb_node* left = n->left;
+    
+    n->left = left->right;
+    if (n->left)
+        n->left->parent = n;
+    
+    left->right = n;
+    left->parent = parent;
+    n->parent = left;
+    
+    if (!parent)
+        root = left;
+    else if (n == parent->left)
+        parent->left = left;
+    else
+        parent->right = left;
+}
+
+bool rb_node_index::is_black(rb_node* n) {
+    return !n || n->black;
+}
+
+void rb_node_index::remove(node* n) {
+    uint64_t cid, nid = n->id();
+    rb_node* current = root;
+    
+    while (current && nid != (cid = current->n->id())) {
+        if (nid < cid)
+            current = current->left;
+        else
+            current = current->right;
+    }
+    
+    if (current)
+        remove(current);
+}
+
+rb_node_index::rb_node * rb_node_index::pred(rb_node* n) {
+    if (n->left)
+        return max(n->left);
+    
+    rb_node* prev;
+    
+    while ((prev = n->parent)) {
+        if (prev->right == n)
+            return prev;
+        n = prev;
+    }
+    
+    return NULL;
+}
+
+rb_node_index::rb_node * rb_node_index::max(rb_node* tree) {
+    if (!tree)
+        return NULL;
+    
+    while (tree->right)
+        tree = tree->right;
+    
+    return tree;
+}
+
+node * rb_node_index::get(uint64_t id) {
+    if (!root)
+        return NULL;
+    
+    rb_node* prev = NULL;
+    rb_node* current = root;
+    uint64_t cid;
+    
+    while (current != prev) {
+        cid = current->n->id();
+        prev = current;
+        if (id < cid && current->left)
+            current = current->left;
+        else if (id > cid && current->right)
+            current = current->right;
+    }
+    
+    if (cid <= id)
+        return current->n;
+    
+    current = pred(current);
+    if (current)
+        return current->n;
+    
+    return NULL;
+}
+
+// #########################
+// rb_node_allocator methods
+// #########################
+
+node * rb_node_allocator::get(uint64_t id) {
+    node* n = index.get(id);
+    if (id <= (n->id() + n->length()))
+        return n;
+    
+    return NULL;
+}
+
@@ -0,0 +1,245 @@
+/*
+Copyright (c) 2015 Perutka, Ondrej
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _RB_NODE_INDEX_HPP
+#define _RB_NODE_INDEX_HPP
+
+#include <stdint.h>
+
+#include "dictionary.hpp"
+
+/** @file */
+
+namespace alzw {
+    /**
+     * Node index based on RB tree. It is the node index used by the decoder 
+     * dictionary before the paged index and it is kept only as a baseline 
+     * for the node index benchmark.
+     */
+    class rb_node_index {
+        /**
+         * RB node.
+         */
+        struct rb_node {
+            node* n;
+            rb_node* parent;
+            rb_node* left;
+            rb_node* right;
+            bool black;
+            
+            rb_node(node* n);
+        };
+        
+        rb_node* root;
+        size_t count;
+        
+        /**
+         * Free a given RB (sub)tree.
+         *
+         * @param n RB (sub)tree
+         */
+        void free_tree(rb_node* n);
+        
+        /**
+         * Insert a given RB node.
+         *
+         * @param n RB node
+         */
+        void insert(rb_node* n);
+        
+        /**
+         * Insert a given RB node into a given RB tree.
+         *
+         * @param tree RB tree
+         * @param n    RB node
+         */
+        void insert(rb_node* tree, rb_node* n);
+        
+        /**
+         * Normalize RB tree after insertion.
+         *
+         * @param n inserted node
+         */
+        void insert_normalize(rb_node* n);
+        
+        /**
+         * Remove a given node from RB tree.
+         *
+         * @param n RB node to be removed
+         */
+        void remove(rb_node* n);
+        
+        /**
+         * Normalize RB tree after deletion.
+         *
+         * @param parent parent of the deleted node
+         * @param n      child of the deleted node
+         */
+        void remove_normalize(rb_node* parent, rb_node* n);
+        
+        /**
+         * Normalize RB tree after deletion (part 2).
+         *
+         * @param parent parent of the deleted node
+         * @param n      child of the deleted node
+         */
+        void remove_normalize2(rb_node* parent, rb_node* n);
+        
+        /**
+         * Normalize RB tree after deletion (part 3).
+         *
+         * @param parent parent of the deleted node
+         * @param n      child of the deleted node
+         */
+        void remove_normalize3(rb_node* parent, rb_node* n);
+        
+        /**
+         * Get predecessor of a given RB node.
+         *
+         * @param n RB node
+         * @returns predecessor or NULL
+         */
+        rb_node * pred(rb_node* n);
+        
+        /**
+         * Get maximum in a given RB tree.
+         *
+         * @param tree RB tree
+         * @returns max RB node
+         */
+        rb_node * max(rb_node* tree);
+        
+        /**
+         * Get grandparent of a given RB node.
+         *
+         * @param n RB node
+         * @returns node's grandparent or NULL
+         */
+        rb_node * grandparent(rb_node* n);
+        
+        /**
+         * Get uncle of a given RB node.
+         *
+         * @param n RB node
+         * @returns node's uncle or NULL
+         */
+        rb_node * uncle(rb_node* n);
+        
+        /**
+         * Rotate left around a given node.
+         *
+         * @param n RB node
+         */
+        void rotate_left(rb_node* n);
+        
+        /**
+         * Rotate right around a given node.
+         *
+         * @param n RB node
+         */
+        void rotate_right(rb_node* n);
+        
+        /**
+         * Is a given node black?
+         *
+         * @param n RB node or NULL
+         * @returns true if the node is black, false otherwise
+         */
+        bool is_black(rb_node* n);
+        
+    public:
+        /**
+         * Create a new RB node index.
+         */
+        rb_node_index();
+        
+        virtual ~rb_node_index();
+        
+        /**
+         * Insert a given node.
+         *
+         * @param n ALZW node
+         */
+        void add(node* n);
+        
+        /**
+         * Remove a given node.
+         *
+         * @param n ALZW node
+         */
+        void remove(node* n);
+        
+        /**
+         * Get node with a given ID or the nearest lower node.
+         *
+         * @param id node ID
+         * @returns node
+         */
+        node * get(uint64_t id);
+        
+        /**
+         * Get number of indexed nodes.
+         *
+         * @returns number of nodes
+         */
+        size_t size() const { return count; }
+        
+        /**
+         * Get number of bytes used by this index.
+         *
+         * @returns number of bytes used by this index
+         */
+        size_t used_memory() const { return count * sizeof(rb_node); }
+    };
+    
+    /**
+     * Node allocator indexing all nodes in an RB tree (the counterpart of 
+     * indexed_node_allocator).
+     */
+    class rb_node_allocator : public node_allocator {
+        rb_node_index index;
+        
+    protected:
+        
+        virtual void insert(node* n) { index.add(n); }
+        
+        virtual void remove(node* n) { index.remove(n); }
+        
+    public:
+        
+        virtual ~rb_node_allocator() { }
+        
+        virtual size_t used_memory() const { return mem + index.used_memory(); }
+        
+        virtual size_t real_nodes() const { return index.size(); }
+        
+        /**
+         * Get node with a given ID or a collapsed node containing the given 
+         * codeword.
+         *
+         * @param id node ID (codeword)
+         */
+        node * get(uint64_t id);
+    };
+}
+
+#endif /* _RB_NODE_INDEX_HPP */
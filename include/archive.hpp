@@ -0,0 +1,348 @@
+/*
+Copyright (c) 2015 Perutka, Ondrej
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _ARCHIVE_HPP
+#define _ARCHIVE_HPP
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "bit-io.hpp"
+#include "seek-index.hpp"
+#include "codeword-coder.hpp"
+
+/** @file */
+
+// extended header format version
+#define ARCHIVE_VERSION     2
+
+// extended header flags:
+#define ARCHIVE_FROZEN      0x01
+#define ARCHIVE_CHUNKED     0x02
+#define ARCHIVE_SEGMENT     0x04
+#define ARCHIVE_BUDGET      0x08
+#define ARCHIVE_CODER       0x10
+
+// dictionary budget policies:
+#define BUDGET_NONE         0
+#define BUDGET_FREEZE       1
+#define BUDGET_RESET        2
+
+namespace alzw {
+    /**
+     * ALZW archive header. The original header consists of the number of 
+     * sequences followed by their file names. The extended header (used only 
+     * if some extended feature is needed) starts with -1 followed by format 
+     * version, flags, the original header and feature parameters.
+     * 
+     * Sequences appended to an existing archive form a new segment starting 
+     * at a byte boundary with its own extended header (marked using the 
+     * ARCHIVE_SEGMENT flag) containing names of the appended sequences. 
+     * Segments continue with the dictionary of the previous segment. Offsets 
+     * of all segment headers are stored in the seek index.
+     * 
+     * Memory used by the dictionary can be limited using a budget. The 
+     * budget is checked at the beginning of every sequence and the 
+     * dictionary is either frozen or reset once its nodes use at least the 
+     * given number of bytes. Readers apply the same rule while decoding the 
+     * stream sequentially, sequences at which the budget was applied are 
+     * also stored in the seek index, so the stream can be accessed randomly. 
+     * A sequence starting with a reset dictionary starts a new chunk.
+     * 
+     * Codewords are stored as fixed-width integers unless the header 
+     * specifies another codeword coder (see codeword_writer). Appended 
+     * segments use the coder of the archive.
+     */
+    class archive_header {
+        std::vector<std::string> names;
+        std::vector<size_t> segment_starts;
+        std::vector<size_t> reset_points;
+        uint8_t version;
+        uint8_t flags;
+        uint32_t freeze;
+        uint32_t chunk;
+        uint8_t policy;
+        uint64_t budget;
+        uint8_t coder;
+        
+    public:
+        /**
+         * Create a new empty header.
+         */
+        archive_header();
+        
+        /**
+         * Read header from a given ALZW stream.
+         *
+         * @param in ALZW stream
+         */
+        void read(breader& in);
+        
+        /**
+         * Write header into a given ALZW stream.
+         *
+         * @param out ALZW stream
+         */
+        void write(bwriter& out) const;
+        
+        /**
+         * Read headers of all appended segments. The input position is 
+         * preserved.
+         *
+         * @param in    ALZW stream
+         * @param index seek index of the stream
+         */
+        void read_segments(breader& in, const seek_index& index);
+        
+        /**
+         * Read header of an appended segment from a given ALZW stream and 
+         * add names of the appended sequences.
+         *
+         * @param in ALZW stream (positioned right after the last sequence of 
+         * the previous segment)
+         * @returns false if there is no segment header, true otherwise
+         */
+        bool read_segment(breader& in);
+        
+        /**
+         * Skip header of an appended segment.
+         *
+         * @param in ALZW stream (positioned right after the last sequence of 
+         * the previous segment)
+         */
+        void skip_segment(breader& in) const;
+        
+        /**
+         * Write header of an appended segment containing all sequence names 
+         * of this header.
+         *
+         * @param out ALZW stream
+         */
+        void write_segment(bwriter& out) const;
+        
+        /**
+         * Check if a given sequence is the first sequence of an appended 
+         * segment. The segment header must be skipped before decoding such 
+         * sequence.
+         *
+         * @param seq zero-based sequence index
+         * @returns true if the sequence starts an appended segment
+         */
+        bool is_segment_start(size_t seq) const;
+        
+        /**
+         * Check if there are any appended segments.
+         *
+         * @returns true if there are appended segments
+         */
+        bool has_segments() const { return !segment_starts.empty(); }
+        
+        /**
+         * Add a sequence name.
+         *
+         * @param name sequence name
+         */
+        void add_name(const std::string& name) { names.push_back(name); }
+        
+        /**
+         * Get sequence names. Note that an ALZW stream may contain a single 
+         * sequence without name.
+         *
+         * @returns sequence names
+         */
+        const std::vector<std::string>& get_names() const { return names; }
+        
+        /**
+         * Get number of encoded sequences.
+         *
+         * @returns number of sequences
+         */
+        size_t sequences() const { return names.empty() ? 1 : names.size(); }
+        
+        /**
+         * Freeze the dictionary after a given number of sequences.
+         *
+         * @param seqc number of sequences encoded using the growing dictionary
+         */
+        void set_freeze_point(uint32_t seqc);
+        
+        /**
+         * Get number of sequences encoded before the dictionary was frozen.
+         *
+         * @returns freeze point (equal to the number of sequences if the 
+         * dictionary was never frozen)
+         */
+        size_t freeze_point() const;
+        
+        /**
+         * Check if a given sequence was encoded using the frozen dictionary.
+         * Every such sequence starts at a byte boundary.
+         *
+         * @param seq zero-based sequence index
+         * @returns true if the sequence was encoded using the frozen 
+         * dictionary
+         */
+        bool is_frozen(size_t seq) const 
+            { return (flags & ARCHIVE_FROZEN) && seq >= freeze; }
+        
+        /**
+         * Split the sequences into chunks of a given size. Every chunk is 
+         * encoded using its own dictionary and it starts at a byte boundary.
+         *
+         * @param seqc number of sequences in a chunk
+         */
+        void set_chunk_size(uint32_t seqc);
+        
+        /**
+         * Get number of sequences in a chunk.
+         *
+         * @returns chunk size (equal to the number of sequences if the 
+         * archive is not split into chunks of a fixed size)
+         */
+        size_t chunk_size() const;
+        
+        /**
+         * Get number of chunks.
+         *
+         * @returns number of chunks
+         */
+        size_t chunks() const;
+        
+        /**
+         * Get the first sequence of a given chunk.
+         *
+         * @param chunk chunk index
+         * @returns zero-based sequence index
+         */
+        size_t chunk_start(size_t chunk) const;
+        
+        /**
+         * Get the end of a given chunk.
+         *
+         * @param chunk chunk index
+         * @returns zero-based index of the first sequence after the chunk
+         */
+        size_t chunk_end(size_t chunk) const;
+        
+        /**
+         * Get chunk containing a given sequence.
+         *
+         * @param seq zero-based sequence index
+         * @returns chunk index
+         */
+        size_t chunk_of(size_t seq) const;
+        
+        /**
+         * Check if a given sequence is the first sequence of a chunk. The 
+         * dictionary must be reset before decoding such sequence.
+         *
+         * @param seq zero-based sequence index
+         * @returns true if the sequence starts a new chunk
+         */
+        bool is_chunk_start(size_t seq) const;
+        
+        /**
+         * Limit memory used by dictionary nodes.
+         *
+         * @param bytes  budget in bytes
+         * @param policy BUDGET_FREEZE or BUDGET_RESET
+         */
+        void set_budget(uint64_t bytes, uint8_t policy);
+        
+        /**
+         * Check if memory used by the dictionary is limited.
+         *
+         * @returns true if there is a dictionary budget
+         */
+        bool has_budget() const { return flags & ARCHIVE_BUDGET; }
+        
+        /**
+         * Get the dictionary budget.
+         *
+         * @returns budget in bytes (0 if there is no budget)
+         */
+        uint64_t get_budget() const { return budget; }
+        
+        /**
+         * Get the dictionary budget policy.
+         *
+         * @returns BUDGET_FREEZE, BUDGET_RESET or BUDGET_NONE if there is no
+         * budget
+         */
+        uint8_t get_budget_policy() const { return policy; }
+        
+        /**
+         * Restore freeze point or chunks created by the dictionary budget 
+         * from a given seek index.
+         *
+         * @param index seek index of the stream
+         */
+        void read_budget(const seek_index& index);
+        
+        /**
+         * Check what the dictionary budget requires at the beginning of a 
+         * given sequence. Nothing is recorded, so it is safe to call this 
+         * method concurrently once all budget points are known (see 
+         * read_budget()).
+         *
+         * @param seq    zero-based sequence index
+         * @param memory memory used by dictionary nodes (see 
+         * dictionary::node_memory())
+         * @returns BUDGET_RESET if the dictionary must be reset before the 
+         * sequence, BUDGET_FREEZE if it must be frozen from now on, 
+         * BUDGET_NONE otherwise
+         */
+        uint8_t budget_action(size_t seq, size_t memory) const;
+        
+        /**
+         * Apply the dictionary budget at the beginning of a given sequence. 
+         * The dictionary is frozen or a new chunk is started if the 
+         * dictionary exceeds the budget. Encoders and sequential readers 
+         * must call this method for every sequence.
+         *
+         * @param seq    zero-based sequence index
+         * @param memory memory used by dictionary nodes (see 
+         * dictionary::node_memory())
+         * @returns BUDGET_RESET if the dictionary must be reset before the 
+         * sequence, BUDGET_FREEZE if it must be frozen from now on, 
+         * BUDGET_NONE otherwise
+         */
+        uint8_t apply_budget(size_t seq, size_t memory);
+        
+        /**
+         * Set codeword coder.
+         *
+         * @param coder CODER_FIXED or CODER_RANGE
+         */
+        void set_coder(uint8_t coder);
+        
+        /**
+         * Get codeword coder.
+         *
+         * @returns CODER_FIXED or CODER_RANGE
+         */
+        uint8_t get_coder() const { return coder; }
+    };
+}
+
+#endif /* _ARCHIVE_HPP */
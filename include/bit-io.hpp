@@ -25,6 +25,10 @@ THE SOFTWARE.
 
 #include <stdint.h>
 #include <cstdio>
+#include <vector>
+#include <thread>
+
+#include "bounded-queue.hpp"
 
 /** @file */
 
@@ -76,6 +80,19 @@ namespace alzw {
          */
         virtual int write_delta(uint64_t n);
         
+        /**
+         * Get number of bits written so far (including the buffered ones).
+         *
+         * @returns current bit offset
+         */
+        virtual uint64_t tell() const = 0;
+        
+        /**
+         * Write zero bits until the current bit offset is aligned to whole 
+         * bytes.
+         */
+        virtual void align();
+        
         /**
          * Flush buffered data. All buffered bits will be written. Note that 
          * complete bytes must be written, this may cause to write more bits 
@@ -133,6 +150,26 @@ namespace alzw {
          * '\0' character was not read yet
          */
         virtual ssize_t read_str(char* buffer, size_t size);
+        
+        /**
+         * Get bit offset of the next bit to be read.
+         *
+         * @returns current bit offset
+         */
+        virtual uint64_t tell() const = 0;
+        
+        /**
+         * Move to a given bit offset. Note that the underlying stream must 
+         * be seekable.
+         *
+         * @param offset bit offset
+         */
+        virtual void seek(uint64_t offset) = 0;
+        
+        /**
+         * Skip bits until the current bit offset is aligned to whole bytes.
+         */
+        virtual void align();
     };
     
     /**
@@ -141,6 +178,7 @@ namespace alzw {
     class stream_bwriter : public bwriter {
         uint8_t buffer[4096];
         size_t bit_offset;
+        uint64_t written;
     
     protected:
         FILE* stream;
@@ -150,15 +188,107 @@ namespace alzw {
          * Create a new bit-writer for a given stream.
          *
          * @param stream stream
+         * @param offset current byte offset within the stream (used only for 
+         * reporting the position via tell())
          */
-        stream_bwriter(FILE* stream);
+        stream_bwriter(FILE* stream, uint64_t offset = 0);
         
         virtual ~stream_bwriter();
         
         virtual void write(uint64_t bits, int width);
+        virtual uint64_t tell() const;
         virtual void flush();
     };
     
+    /**
+     * Asynchronous stream bit-writer. Bits are packed into buffers by the 
+     * calling thread and full buffers are written into the stream by a 
+     * background writer thread. The number of pending buffers is limited.
+     */
+    class async_bwriter : public bwriter {
+        std::vector<uint8_t> buffer;
+        size_t bit_offset;
+        uint64_t written;
+        
+        FILE* stream;
+        bounded_queue<std::vector<uint8_t>> queue;
+        std::thread writer_thread;
+        bool failed;
+        
+        /**
+         * Writer thread loop.
+         */
+        void writer();
+        
+        /**
+         * Pass all complete bytes of the current buffer to the writer 
+         * thread.
+         *
+         * @param bytes number of bytes to pass
+         */
+        void submit(size_t bytes);
+        
+    public:
+        /**
+         * Create a new asynchronous bit-writer for a given stream.
+         *
+         * @param stream   stream
+         * @param capacity maximum number of pending buffers
+         */
+        async_bwriter(FILE* stream, size_t capacity = 16);
+        
+        /**
+         * Flush all data, stop the writer thread and wait for it (also if 
+         * the writer is destroyed because of an exception). Errors are 
+         * ignored, use close() to detect them.
+         */
+        virtual ~async_bwriter();
+        
+        virtual void write(uint64_t bits, int width);
+        virtual uint64_t tell() const;
+        virtual void flush();
+        
+        /**
+         * Flush all data, wait until everything is written and stop the 
+         * writer thread. No data can be written afterwards.
+         */
+        void close();
+    };
+    
+    /**
+     * Memory bit-writer.
+     */
+    class memory_bwriter : public bwriter {
+        std::vector<uint8_t> buffer;
+        size_t bit_offset;
+        
+    public:
+        /**
+         * Create a new empty memory bit-writer.
+         */
+        memory_bwriter();
+        
+        virtual ~memory_bwriter() { }
+        
+        virtual void write(uint64_t bits, int width);
+        virtual uint64_t tell() const { return bit_offset; }
+        virtual void flush() { }
+        
+        /**
+         * Get written data. The last byte is padded with zero bits.
+         *
+         * @returns buffer
+         */
+        const uint8_t * data() const { return buffer.data(); }
+        
+        /**
+         * Write all data from this writer into a given bit-writer.
+         *
+         * @param out output
+         */
+        void write_to(bwriter& out) const;
+    };
+    
     /**
      * Stream bit-reader.
      */
@@ -166,6 +296,7 @@ namespace alzw {
         uint8_t buffer[4096];
         size_t bit_offset;
         size_t available;
+        uint64_t consumed;
     
     protected:
         FILE* stream;
@@ -181,6 +312,8 @@ namespace alzw {
         virtual ~stream_breader();
         
         virtual int read(uint64_t& bits, int width);
+        virtual uint64_t tell() const;
+        virtual void seek(uint64_t offset);
     };
     
     /**
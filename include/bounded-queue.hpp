@@ -0,0 +1,123 @@
+/*
+Copyright (c) 2015 Perutka, Ondrej
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _BOUNDED_QUEUE_HPP
+#define _BOUNDED_QUEUE_HPP
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+/** @file */
+
+namespace alzw {
+    /**
+     * Blocking FIFO queue with limited capacity. It is used for passing data
+     * between stages of a pipeline, producers are blocked while the queue 
+     * is full and consumers are blocked while the queue is empty. Closing 
+     * the queue wakes up all waiting threads.
+     */
+    template <class T>
+    class bounded_queue {
+        std::deque<T> items;
+        size_t capacity;
+        bool closed;
+        
+        std::mutex mutex;
+        std::condition_variable not_empty;
+        std::condition_variable not_full;
+        
+    public:
+        /**
+         * Create a new empty queue.
+         *
+         * @param capacity maximum number of queued items
+         */
+        bounded_queue(size_t capacity) 
+            : capacity(capacity > 0 ? capacity : 1)
+            , closed(false) { }
+        
+        /**
+         * Append a given item at the end of the queue. The call blocks while
+         * the queue is full.
+         *
+         * @param item item
+         * @returns false if the queue was closed (the item is dropped), true
+         * otherwise
+         */
+        bool push(T&& item) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                not_full.wait(lock, [this] { 
+                    return closed || items.size() < capacity; });
+                if (closed)
+                    return false;
+                
+                items.push_back(std::move(item));
+            }
+            
+            not_empty.notify_one();
+            
+            return true;
+        }
+        
+        /**
+         * Remove the first item from the queue. The call blocks while the 
+         * queue is empty and not closed.
+         *
+         * @param item output
+         * @returns false if the queue is closed and empty, true otherwise
+         */
+        bool pop(T& item) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                not_empty.wait(lock, [this] { 
+                    return closed || !items.empty(); });
+                if (items.empty())
+                    return false;
+                
+                item = std::move(items.front());
+                items.pop_front();
+            }
+            
+            not_full.notify_one();
+            
+            return true;
+        }
+        
+        /**
+         * Close the queue. No more items can be pushed, the remaining items 
+         * can still be removed.
+         */
+        void close() {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                closed = true;
+            }
+            
+            not_empty.notify_all();
+            not_full.notify_all();
+        }
+    };
+}
+
+#endif /* _BOUNDED_QUEUE_HPP */
@@ -0,0 +1,411 @@
+/*
+Copyright (c) 2015 Perutka, Ondrej
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _CODEWORD_CODER_HPP
+#define _CODEWORD_CODER_HPP
+
+#include <stdint.h>
+
+#include "bit-io.hpp"
+
+/** @file */
+
+// codeword coders:
+#define CODER_FIXED         0
+#define CODER_RANGE         1
+
+// range coder parameters
+#define RC_MODEL_BITS       11
+#define RC_MODEL_TOTAL      (1 << RC_MODEL_BITS)
+#define RC_MOVE_BITS        5
+#define RC_TOP              ((uint32_t)1 << 24)
+
+// number of adaptively coded bits following the leading one of a number
+#define RC_MANTISSA_BITS    4
+
+namespace alzw {
+    /**
+     * Adaptive model of numbers up to 64 bits. A number is coded as the 
+     * position of its leading one (slot) followed by a few most significant
+     * bits (modelled separately for every slot) and the remaining bits 
+     * which are stored directly.
+     */
+    struct number_model {
+        uint16_t slots[128];
+        uint16_t mantissa[65][1 << RC_MANTISSA_BITS];
+        
+        /**
+         * Reset all probabilities to 1/2.
+         */
+        void reset();
+    };
+    
+    /**
+     * Binary adaptive range encoder. The output is written byte by byte 
+     * into a given bit-writer (it does not need to be aligned).
+     */
+    class range_encoder {
+        uint64_t low;
+        uint32_t range;
+        uint64_t cache_size;
+        uint8_t cache;
+        bool first;
+        
+        // price of the encoded bits in 1/16 bits
+        uint64_t cost;
+        
+        /**
+         * Output the top byte of the low value.
+         *
+         * @param out output
+         */
+        void shift_low(bwriter& out);
+        
+    public:
+        /**
+         * Create a new range encoder.
+         */
+        range_encoder() { reset(); }
+        
+        /**
+         * Start a new range-coded block.
+         */
+        void reset();
+        
+        /**
+         * Encode a given bit.
+         *
+         * @param prob probability of 0 (updated)
+         * @param bit  bit
+         * @param out  output
+         */
+        void encode(uint16_t& prob, int bit, bwriter& out);
+        
+        /**
+         * Encode given number of least significant bits of a given number 
+         * with probability 1/2.
+         *
+         * @param bits  bits
+         * @param width number of bits
+         * @param out   output
+         */
+        void encode_direct(uint64_t bits, int width, bwriter& out);
+        
+        /**
+         * Encode a given number of at most 64 bits.
+         *
+         * @param model number model
+         * @param n     number
+         * @param base  value used to compute the slot (the slot is base 
+         * minus the number width)
+         * @param out   output
+         */
+        void encode(number_model& model, uint64_t n, int base, bwriter& out);
+        
+        /**
+         * Flush the encoder. All encoded bits are written into the output 
+         * and the encoder is reset.
+         *
+         * @param out output
+         */
+        void flush(bwriter& out);
+        
+        /**
+         * Get number of bits (estimated from the probabilities) of all 
+         * symbols encoded since the previous call and reset the counter.
+         *
+         * @returns number of bits
+         */
+        size_t take_cost();
+    };
+    
+    /**
+     * Binary adaptive range decoder. It reads exactly the bytes written by 
+     * the range encoder.
+     */
+    class range_decoder {
+        uint32_t range;
+        uint32_t code;
+        
+        /**
+         * Read next byte of the input.
+         *
+         * @param in input
+         * @returns byte
+         */
+        static uint32_t next_byte(breader& in);
+        
+    public:
+        /**
+         * Create a new range decoder.
+         */
+        range_decoder() : range(0), code(0) { }
+        
+        /**
+         * Start decoding of a range-coded block.
+         *
+         * @param in input
+         */
+        void init(breader& in);
+        
+        /**
+         * Decode a bit.
+         *
+         * @param prob probability of 0 (updated)
+         * @param in   input
+         * @returns bit
+         */
+        int decode(uint16_t& prob, breader& in);
+        
+        /**
+         * Decode given number of bits encoded with probability 1/2.
+         *
+         * @param width number of bits
+         * @param in    input
+         * @returns bits
+         */
+        uint64_t decode_direct(int width, breader& in);
+        
+        /**
+         * Decode a number.
+         *
+         * @param model number model
+         * @param base  value used to compute the slot (see 
+         * range_encoder::encode())
+         * @param in    input
+         * @returns number
+         */
+        uint64_t decode(number_model& model, int base, breader& in);
+    };
+    
+    /**
+     * Abstract codeword writer. It sits between an encoder and the output bit
+     * stream and it decides how match/replace codewords, insertion codewords,
+     * insertion counts and deletion lengths are represented. Every sequence 
+     * is coded independently.
+     */
+    class codeword_writer {
+    public:
+        virtual ~codeword_writer() { }
+        
+        /**
+         * Start a new sequence.
+         *
+         * @param out output
+         */
+        virtual void begin_sequence(bwriter& out) { }
+        
+        /**
+         * Write a match/replace codeword (or a special codeword of the 
+         * insertion, deletion or width-increment node).
+         *
+         * @param cw    codeword
+         * @param width codeword width
+         * @param out   output
+         * @returns number of written bits
+         */
+        virtual size_t write_cw(uint64_t cw, int width, bwriter& out) = 0;
+        
+        /**
+         * Write an insertion codeword.
+         *
+         * @param cw    codeword
+         * @param width codeword width
+         * @param out   output
+         * @returns number of written bits
+         */
+        virtual size_t write_ins_cw(uint64_t cw, int width, bwriter& out) = 0;
+        
+        /**
+         * Write number of insertion codewords.
+         *
+         * @param n   number of codewords (at least 1)
+         * @param out output
+         * @returns number of written bits
+         */
+        virtual size_t write_ins_count(uint64_t n, bwriter& out) = 0;
+        
+        /**
+         * Write length of a deletion.
+         *
+         * @param n   number of deleted symbols (at least 1)
+         * @param out output
+         * @returns number of written bits
+         */
+        virtual size_t write_del_length(uint64_t n, bwriter& out) = 0;
+        
+        /**
+         * Finish the current sequence.
+         *
+         * @param out output
+         */
+        virtual void end_sequence(bwriter& out) { }
+        
+        /**
+         * Create a new codeword writer.
+         *
+         * @param coder CODER_FIXED or CODER_RANGE
+         * @returns codeword writer
+         */
+        static codeword_writer * create(uint8_t coder);
+    };
+    
+    /**
+     * Abstract codeword reader (see codeword_writer). All read methods throw
+     * an exception in case of an unexpected end of the input.
+     */
+    class codeword_reader {
+    public:
+        virtual ~codeword_reader() { }
+        
+        /**
+         * Start reading of a new sequence.
+         *
+         * @param in input
+         */
+        virtual void begin_sequence(breader& in) { }
+        
+        /**
+         * Read a match/replace codeword (or a special codeword).
+         *
+         * @param width codeword width
+         * @param in    input
+         * @returns codeword
+         */
+        virtual uint64_t read_cw(int width, breader& in) = 0;
+        
+        /**
+         * Read an insertion codeword.
+         *
+         * @param width codeword width
+         * @param in    input
+         * @returns codeword
+         */
+        virtual uint64_t read_ins_cw(int width, breader& in) = 0;
+        
+        /**
+         * Read number of insertion codewords.
+         *
+         * @param in input
+         * @returns number of codewords
+         */
+        virtual uint64_t read_ins_count(breader& in) = 0;
+        
+        /**
+         * Read length of a deletion.
+         *
+         * @param in input
+         * @returns number of deleted symbols
+         */
+        virtual uint64_t read_del_length(breader& in) = 0;
+        
+        /**
+         * Create a new codeword reader.
+         *
+         * @param coder CODER_FIXED or CODER_RANGE
+         * @returns codeword reader
+         */
+        static codeword_reader * create(uint8_t coder);
+    };
+    
+    /**
+     * Codeword writer storing codewords as fixed-width integers and counts 
+     * using the Elias delta code (the original ALZW format).
+     */
+    class fixed_codeword_writer : public codeword_writer {
+    public:
+        virtual size_t write_cw(uint64_t cw, int width, bwriter& out);
+        
+        virtual size_t write_ins_cw(uint64_t cw, int width, bwriter& out);
+        
+        virtual size_t write_ins_count(uint64_t n, bwriter& out);
+        
+        virtual size_t write_del_length(uint64_t n, bwriter& out);
+    };
+    
+    /**
+     * Codeword reader for the fixed_codeword_writer output.
+     */
+    class fixed_codeword_reader : public codeword_reader {
+    public:
+        virtual uint64_t read_cw(int width, breader& in);
+        
+        virtual uint64_t read_ins_cw(int width, breader& in);
+        
+        virtual uint64_t read_ins_count(breader& in);
+        
+        virtual uint64_t read_del_length(breader& in);
+    };
+    
+    /**
+     * Codeword writer using an adaptive binary range coder. Match/replace 
+     * codewords, insertion codewords, insertion counts and deletion lengths 
+     * have separate models. The models are reset and the range coder is 
+     * flushed at the end of every sequence, so every sequence can be decoded
+     * on its own. Positions within a sequence are not addressable, so there 
+     * are no seek points at synchronization points.
+     */
+    class range_codeword_writer : public codeword_writer {
+        range_encoder rc;
+        number_model mm_model;
+        number_model icw_model;
+        number_model icount_model;
+        number_model dlength_model;
+        
+    public:
+        virtual void begin_sequence(bwriter& out);
+        
+        virtual size_t write_cw(uint64_t cw, int width, bwriter& out);
+        
+        virtual size_t write_ins_cw(uint64_t cw, int width, bwriter& out);
+        
+        virtual size_t write_ins_count(uint64_t n, bwriter& out);
+        
+        virtual size_t write_del_length(uint64_t n, bwriter& out);
+        
+        virtual void end_sequence(bwriter& out);
+    };
+    
+    /**
+     * Codeword reader for the range_codeword_writer output.
+     */
+    class range_codeword_reader : public codeword_reader {
+        range_decoder rc;
+        number_model mm_model;
+        number_model icw_model;
+        number_model icount_model;
+        number_model dlength_model;
+        
+    public:
+        virtual void begin_sequence(breader& in);
+        
+        virtual uint64_t read_cw(int width, breader& in);
+        
+        virtual uint64_t read_ins_cw(int width, breader& in);
+        
+        virtual uint64_t read_ins_count(breader& in);
+        
+        virtual uint64_t read_del_length(breader& in);
+    };
+}
+
+#endif /* _CODEWORD_CODER_HPP */
@@ -25,67 +25,183 @@ THE SOFTWARE.
 
 #include <ostream>
 #include <string>
-#include <unordered_map>
+#include <vector>
 
 #include "dictionary.hpp"
 #include "bit-io.hpp"
+#include "seek-index.hpp"
+#include "codeword-coder.hpp"
+#include "symbol-sink.hpp"
 
 /** @file */
 
+// size of the window of recently output phrases (must be a power of two)
+#define DECODER_WINDOW_SIZE     (1 << 20)
+
+// number of entries of the phrase position cache (must be a power of two)
+#define DECODER_CACHE_SIZE      (1 << 16)
+
+// minimum length of a phrase that is kept in the window
+#define DECODER_MIN_COPY        32
+
 namespace alzw {
     /**
      * ALZW decoder.
+     *
+     * Long phrases are reconstructed by walking from a dictionary node up 
+     * to the root. In order to avoid repeated walks, every long phrase 
+     * written into the output is also appended into a sliding window and 
+     * its position is remembered in a small direct-mapped cache indexed by 
+     * codewords. A repeated phrase is then copied from the window unless it 
+     * has been overwritten in the meantime.
      */
     class decoder {
-        std::unordered_map<uint64_t, const node*> phrases;
-        bool hash_index;
+        std::vector<bool> phrases;
+        bool phrase_index;
         
         const std::string& rseq;
-        dictionary dict;
+        dictionary* own_dict;
+        dictionary& dict;
+        bool frozen;
         
         size_t offset;
+        size_t line_length;
         int width;
         
+        // codeword coder
+        uint8_t coder;
+        codeword_reader* cw_reader;
+        
+        // reference window
+        size_t wstart;
+        size_t wend;
+        bool wtruncate;
+        
+        // reference offset to continue from (set by seek())
+        size_t sroffset;
+        
+        // state of the sequence being decoded (see start_sequence())
+        size_t seq_roffset;
+        size_t seq_rend;
+        
         // output buffer
         char obuffer[4096];
         size_t ob_offset;
         
-        // buffer for reversed phrases
+        // buffer for phrases
         char* rbuffer;
         size_t rbufferSize;
         
         /**
-         * Output a given character. Use the internal buffer first. In case 
-         * the buffer is full, flush it.
+         * Position of a phrase within the window.
+         */
+        struct phrase_ref {
+            uint64_t cw;
+            uint64_t pos;
+        };
+        
+        // window of recently output phrases (allocated on first use)
+        char* window;
+        uint64_t wpos;
+        phrase_ref* refs;
+        
+        /**
+         * Mark a given codeword in the phrase index.
          *
-         * @param c   character
-         * @param out output stream pointer (may be NULL)
+         * @param cw codeword
          */
-        void output_char(char c, std::ostream* out);
+        void mark_phrase(uint64_t cw) {
+            if (cw >= phrases.size())
+                phrases.resize(cw + 1);
+            phrases[cw] = true;
+        }
         
         /**
          * Flush the internal output buffer.
          *
-         * @param out output stream pointer (may be NULL)
+         * @param out output pointer (may be NULL)
          */
-        void flush_output_buffer(std::ostream* out);
+        void flush_output_buffer(symbol_sink* out);
         
         /**
-         * Decode a single sequence from a given input.
+         * Output given symbols and break lines (see set_line_length()).
          *
-         * @param in  input
-         * @param out output stream pointer (may be NULL)
+         * @param s   symbols
+         * @param len number of symbols
+         * @param out output pointer
+         */
+        void output_symbols(const char* s, size_t len, symbol_sink* out);
+        
+        /**
+         * Make sure the phrase buffer can hold a given number of symbols.
+         *
+         * @param size number of symbols
+         */
+        void reserve_phrase(size_t size);
+        
+        /**
+         * Reconstruct the phrase represented by a given node by walking the 
+         * dictionary up to the root.
+         *
+         * @param n       node
+         * @param noffset offset within a collapsed node
+         * @param plen    phrase length
+         * @returns phrase (stored in the phrase buffer)
+         */
+        const char * build_phrase(const node* n, uint32_t noffset, 
+            size_t plen);
+        
+        /**
+         * Copy the phrase represented by a given codeword from the window. 
+         * The phrase is appended into the window again if it is about to 
+         * be overwritten.
+         *
+         * @param cw   codeword
+         * @param plen phrase length
+         * @returns phrase (stored in the phrase buffer) or NULL if the 
+         * phrase is not in the window
+         */
+        const char * copy_phrase(uint64_t cw, size_t plen);
+        
+        /**
+         * Append a given phrase into the window and remember its position.
+         *
+         * @param cw     codeword
+         * @param phrase phrase
+         * @param plen   phrase length
+         */
+        void remember_phrase(uint64_t cw, const char* phrase, size_t plen);
+        
+        /**
+         * Forget positions of all phrases in the window.
+         */
+        void clear_window();
+        
+        /**
+         * Check if a symbol aligned to a given reference offset is within the
+         * reference window. An insertion at a given reference offset is 
+         * placed right before the corresponding reference symbol.
+         *
+         * @param roffset reference sequence offset
+         * @param ins     true in case of an inserted symbol
+         * @returns true if the symbol is within the window
          */
-        void decode(breader& in, std::ostream* out);
+        bool in_window(size_t roffset, bool ins) const {
+            if (ins)
+                return (roffset > wstart || wstart == 0) 
+                    && (roffset < wend || wend >= rseq.length());
+            
+            return roffset >= wstart && roffset < wend;
+        }
         
         /**
          * Decode insertion.
          *
          * @param roffset reference sequence offset
          * @param in      input
-         * @param out     output stream pointer (may be NULL)
+         * @param out     output pointer (may be NULL)
          */
-        void decode_ins(size_t roffset, breader& in, std::ostream* out);
+        void decode_ins(size_t roffset, breader& in, symbol_sink* out);
         
         /**
          * Decode a single math/replace subsequence.
@@ -93,11 +209,11 @@ namespace alzw {
          * @param cw      codeword
          * @param roffset reference sequence offset
          * @param in      input
-         * @param out     output stream pointer (may be NULL)
+         * @param out     output pointer (may be NULL)
          * @returns phrase width
          */
         size_t decode_mr(uint64_t cw, 
-            size_t roffset, breader& in, std::ostream* out);
+            size_t roffset, breader& in, symbol_sink* out);
         
         /**
          * Output the phrase represented by a given node.
@@ -105,11 +221,12 @@ namespace alzw {
          * @param n       node
          * @param noffset offset within a collapsed node
          * @param roffset reference sequence offset
-         * @param out     output stream pointer (may be NULL)
+         * @param ins     true in case of an inserted phrase
+         * @param out     output pointer (may be NULL)
          * @returns phrase width
          */
         size_t output_node(const node* n, uint32_t noffset, 
-            size_t roffset, std::ostream* out);
+            size_t roffset, bool ins, symbol_sink* out);
         
         /**
          * Copy symbols from the reference sequence until there is a given 
@@ -117,21 +234,41 @@ namespace alzw {
          *
          * @param cw      codeword
          * @param roffset reference sequence offset
-         * @param out     output stream pointer (may be NULL)
+         * @param out     output pointer (may be NULL)
          * @returns phrase width
          */
-        size_t output_match(uint64_t cw, size_t roffset, std::ostream* out);
+        size_t output_match(uint64_t cw, size_t roffset, symbol_sink* out);
         
     public:
         /**
          * Create a new decoder using a given reference sequence.
          *
-         * @param rseq       reference sequence
-         * @param hash_index whether or not to create a hash-index for decoded 
-         * codewords (note: freeze() method must be called after decoding all 
-         * sequences in order to use the index)
+         * @param rseq         reference sequence
+         * @param phrase_index whether or not to mark decoded codewords in the 
+         * phrase index (see get_phrases())
          */
-        decoder(const std::string& rseq, bool hash_index = true);
+        decoder(const std::string& rseq, bool phrase_index = true);
+        
+        /**
+         * Create a new decoder updating a given dictionary. The dictionary 
+         * must be empty and indexed. It can be used by an encoder afterwards 
+         * in order to continue encoding of the decoded stream.
+         *
+         * @param rseq reference sequence
+         * @param dict dictionary (it must outlive the decoder)
+         */
+        decoder(const std::string& rseq, dictionary& dict);
+        
+        /**
+         * Create a new decoder sharing the frozen dictionary of a given 
+         * decoder (see freeze_dictionary()). The new decoder can decode only 
+         * sequences encoded using the frozen dictionary, however, any number 
+         * of such decoders can run concurrently. The given decoder must not 
+         * decode anything while there is any decoder sharing its dictionary.
+         *
+         * @param master decoder with frozen dictionary
+         */
+        decoder(const decoder* master);
         
         virtual ~decoder();
         
@@ -152,10 +289,107 @@ namespace alzw {
         void decode(breader& in, std::ostream& out);
         
         /**
-         * Freeze the dictionary and build the hash-index. No sequences should
-         * be decoded after invoking this method!
+         * Decode a next sequence.
+         *
+         * @param in  input
+         * @param out output
          */
-        void freeze();
+        void decode(breader& in, symbol_sink& out);
+        
+        /**
+         * Start decoding of a next sequence. The sequence can be then 
+         * decoded codeword by codeword using decode_codeword(), so the caller
+         * can interrupt the decoding at any point.
+         *
+         * @param in input
+         */
+        void start_sequence(breader& in);
+        
+        /**
+         * Decode a next codeword of the sequence started by start_sequence().
+         * A single codeword may produce any number of symbols (including 
+         * none).
+         *
+         * @param in  input
+         * @param out output pointer (may be NULL)
+         * @returns false if the whole sequence has been already decoded, 
+         * true otherwise
+         */
+        bool decode_codeword(breader& in, symbol_sink* out);
+        
+        /**
+         * Output only symbols aligned to a given reference window when 
+         * decoding subsequent sequences. Insertions are output only if they 
+         * are strictly inside the window or if the window touches the 
+         * beginning/end of the reference sequence.
+         *
+         * @param start    window start (zero-based, inclusive)
+         * @param end      window end (zero-based, exclusive)
+         * @param truncate stop decoding a sequence as soon as the window end 
+         * is reached (note: no other sequence can be decoded after that)
+         */
+        void set_window(size_t start, size_t end, bool truncate = false);
+        
+        /**
+         * Set length of output lines of subsequently decoded sequences.
+         *
+         * @param len line length (0 means no line breaks)
+         */
+        void set_line_length(size_t len) { line_length = len; }
+        
+        /**
+         * Move to a given seek point. The next decoded sequence will continue 
+         * from the seek point. The dictionary must be in the same state as 
+         * it was in the seek point, i.e. its next ID must match.
+         *
+         * @param in input
+         * @param p  seek point
+         */
+        void seek(breader& in, const seek_point& p);
+        
+        /**
+         * Get ID of the next node that would be added into the dictionary.
+         *
+         * @returns next node ID
+         */
+        uint64_t next_id() const { return dict.next_id(); }
+        
+        /**
+         * Get current codeword width.
+         *
+         * @returns codeword width
+         */
+        int get_width() const { return width; }
+        
+        /**
+         * Stop updating the dictionary. All subsequent sequences must be 
+         * encoded using the frozen dictionary (see frozen_encoder) and every 
+         * such sequence must start at a byte boundary.
+         */
+        void freeze_dictionary() { frozen = true; }
+        
+        /**
+         * Set codeword coder used by the decoded stream (see 
+         * archive_header::get_coder()).
+         *
+         * @param coder CODER_FIXED or CODER_RANGE
+         */
+        void set_coder(uint8_t coder);
+        
+        /**
+         * Get codeword coder.
+         *
+         * @returns codeword coder
+         */
+        uint8_t get_coder() const { return coder; }
+        
+        /**
+         * Remove all phrases from the dictionary (see dictionary::clear()) 
+         * and unfreeze it, so the next sequence is decoded as if it was the 
+         * first one. It can be called only between sequences and only if no 
+         * other decoder shares the dictionary.
+         */
+        void reset_dictionary();
         
         /**
          * Get dictionary.
@@ -165,12 +399,12 @@ namespace alzw {
         const dictionary & get_dictionary() const { return dict; }
         
         /**
-         * Get hash-index.
+         * Get phrase index. It is a bitmap indexed by codewords, a bit is set
+         * if the corresponding codeword has been decoded.
          *
-         * @returns codeword -> phrase map
+         * @returns phrase index
          */
-        const std::unordered_map<uint64_t, const node*>& get_phrases() const 
-            { return phrases; }
+        const std::vector<bool>& get_phrases() const { return phrases; }
         
         /**
          * Get number of bytes used by dictionary nodes.
@@ -179,6 +413,14 @@ namespace alzw {
          */
         size_t used_memory() const { return dict.used_memory(); }
         
+        /**
+         * Get number of bytes used by dictionary nodes excluding the codeword
+         * index (if any).
+         * 
+         * @returns memory used by nodes
+         */
+        size_t node_memory() const { return dict.node_memory(); }
+        
         /**
          * Get number of used virtual nodes (codewords).
          *
@@ -27,12 +27,59 @@ THE SOFTWARE.
 #include <cstdio>
 #include <stdint.h>
 
+#include "slab-arena.hpp"
+#include "nibble-pool.hpp"
+
 /** @file */
 
 #define NODE_COLLAPSING
 
+// Define COMPACT_NODES (e.g. using CFLAGS) in order to use the compact node 
+// layout. Nodes reference each other using 32-bit handles within regions of 
+// reserved address space shared by all dictionaries, node IDs are limited 
+// to 48 bits and short collapsed sequences are stored inline.
+//#define COMPACT_NODES
+
+#if defined(COMPACT_NODES) && !defined(NODE_COLLAPSING)
+#error "compact nodes require node collapsing"
+#endif
+
+#ifdef COMPACT_NODES
+// maximum length of a collapsed sequence stored inline
+#define NODE_INLINE_BASES       32
+
+// sizes of the compact node regions (nodes, child arrays and collapsed 
+// sequences), 32-bit handles address 32B nodes, 4B links and single bytes
+#define COMPACT_NODE_REGION     ((size_t)1 << 37)
+#define COMPACT_LINK_REGION     ((size_t)1 << 34)
+#define COMPACT_SEQUENCE_REGION ((size_t)1 << 32)
+#endif
+
+// nominal node size and nominal size of a child link used for memory 
+// accounting (see node::size()); they do not depend on the actual node 
+// layout, so memory budgets are evaluated the same way by all builds
+#define NODE_NOMINAL_SIZE       48
+#define NODE_NOMINAL_LINK_SIZE  8
+
+// collapsed sequences are packed using two bits per symbol, N symbols are 
+// stored as runs after the packed symbols and nodes containing them are 
+// marked by a flag stored along with the transition symbol
+#define NODE_N_SYMBOL           4
+#define NODE_N_RUNS             0x80
+
+// nodes with at least NODE_TABLE_DEGREE children keep their children in 
+// a table indexed by transition symbols (the table has a slot for every 
+// symbol of the alphabet), nodes with fewer children use plain arrays
+#define NODE_TABLE_DEGREE       3
+#define NODE_TABLE_SIZE         5
+
+// number of low node ID bits addressing a node within a node index page 
+// (at most 8, offsets within a page are stored as bytes)
+#define NODE_INDEX_PAGE_BITS    8
+
 namespace alzw {
     // pre-declarations:
+    class node;
     class node_allocator;
     class indexed_node_allocator;
     class simple_node_allocator;
@@ -40,21 +87,50 @@ namespace alzw {
     class encoder;
     class decoder;
     
+#ifdef COMPACT_NODES
+    // reference to a dictionary node (node handle)
+    typedef uint32_t node_ref;
+#else
+    // reference to a dictionary node
+    typedef node* node_ref;
+#endif
+    
     /**
      * ALZW dictionary node. (Do NOT use any virtual methods in order to save 
      * some space that would be used by vtable.)
      */
     class node {
+#if defined(COMPACT_NODES)
+        uint32_t nid_lo;    // node ID (lower 32 bits)
+        uint16_t nid_hi;    // node ID (upper 16 bits)
+        uint8_t deg;        // number of children
+        uint8_t sym;        // symbol for transition from a parent node to this node (and flags)
+        node_ref par;       // parent node
+        uint32_t children;  // child node handle or child array/table handle
+        uint32_t plen;      // phrase length
+        uint32_t len;       // collapsed sequence length
+        union {
+            uint8_t bases[NODE_INLINE_BASES >> 2];
+            uint32_t block;
+        } seq;              // inline collapsed sequence or pool block handle
+        
+        static slab_region node_region;
+        static slab_region link_region;
+        static slab_region sequence_region;
+        
+        friend class node_allocator;
+#elif defined(NODE_COLLAPSING)
         uint64_t nid;       // node ID
         node* par;          // parent node
-#ifdef NODE_COLLAPSING
-        uint8_t* seq;       // collapsed sequence
+        uint8_t* seq;       // collapsed sequence (within a nibble pool)
         void*  children;    // children
         uint32_t plen;      // phrase length
         uint32_t len;       // collapsed sequence length
         uint8_t deg;        // number of children
-        uint8_t sym;        // symbol for transition from a parent node to this node
+        uint8_t sym;        // symbol for transition from a parent node to this node (and flags)
 #else
+        uint64_t nid;       // node ID
+        node* par;          // parent node
         void*  children;    // children
         uint32_t plen;      // phrase length
         uint8_t deg;        // number of children
@@ -62,13 +138,219 @@ namespace alzw {
 #endif
         
         /**
-         * Set symbol in the collapsed sequence.
+         * Set symbol in the packed collapsed sequence (N runs are not 
+         * updated).
          *
          * @param index zero-based offset
          * @param base  symbol
          */
         void set_base(uint32_t index, int base);
+
+#ifdef NODE_COLLAPSING
+        /**
+         * Pack given symbols four per byte (N symbols are packed as A).
+         *
+         * @param dst   output buffer
+         * @param bases symbols
+         * @param count number of symbols
+         */
+        static void pack(uint8_t* dst, const uint8_t* bases, uint32_t count);
+        
+        /**
+         * Check if the collapsed sequence contains any N runs.
+         *
+         * @returns true if there are N runs, false otherwise
+         */
+        bool has_runs() const { return sym & NODE_N_RUNS; }
+        
+        /**
+         * Get the list of N runs stored after the packed symbols (number of 
+         * runs followed by start and end offset of each run).
+         *
+         * @returns list of N runs
+         */
+        uint8_t * runs() { return sequence() + ((len + 3) >> 2); }
+        
+        /**
+         * Get the list of N runs stored after the packed symbols.
+         *
+         * @returns list of N runs
+         */
+        const uint8_t * runs() const { return sequence() + ((len + 3) >> 2); }
+        
+        /**
+         * Get number of N runs.
+         *
+         * @returns number of N runs
+         */
+        uint32_t run_count() const;
+        
+        /**
+         * Get N run with a given index.
+         *
+         * @param index run index
+         * @param start zero-based offset of the first N
+         * @param end   zero-based offset following the last N
+         */
+        void get_run(uint32_t index, uint32_t& start, uint32_t& end) const;
+        
+        /**
+         * Add a given N run after the last run (adjacent runs are merged). 
+         * There must be enough space for the run (see resize_sequence()).
+         *
+         * @param start zero-based offset of the first N
+         * @param end   zero-based offset following the last N
+         */
+        void add_run(uint32_t start, uint32_t end);
+        
+        /**
+         * Get number of N runs that would be added by appending given 
+         * symbols to the collapsed sequence.
+         *
+         * @param bases symbols
+         * @param count number of symbols
+         * @returns number of new N runs
+         */
+        uint32_t new_runs(const uint8_t* bases, uint32_t count) const;
+        
+        /**
+         * Resize the collapsed sequence to a given length and make space for 
+         * a given number of N runs. Packed symbols and N runs are preserved, 
+         * the number of N runs must not be greater than the given capacity. 
+         * The storage never moves when it shrinks unless it fits into the 
+         * node.
+         *
+         * @param len  new sequence length
+         * @param runs capacity of the list of N runs
+         * @param pool pool containing the collapsed sequence
+         */
+        void resize_sequence(uint32_t len, uint32_t runs, nibble_pool& pool);
+        
+        /**
+         * Move the list of N runs within a given block behind the packed 
+         * symbols of a given sequence length and set the sequence length.
+         *
+         * @param block storage of the collapsed sequence
+         * @param len   new sequence length
+         * @param runs  capacity of the list of N runs
+         */
+        void move_runs(uint8_t* block, uint32_t len, uint32_t runs);
+        
+        /**
+         * Use a part of the collapsed sequence of a given node as the 
+         * collapsed sequence of this node.
+         *
+         * @param n      node
+         * @param offset offset within the sequence of the given node in bytes
+         * @param len    sequence length
+         * @returns true if the sequence is shared, false if it has to be 
+         * copied
+         */
+        bool share_sequence(const node* n, uint32_t offset, uint32_t len);
+#endif
+        
+        /**
+         * Get the only child of this node (if the node degree is one).
+         *
+         * @returns child node or NULL
+         */
+#ifdef COMPACT_NODES
+        node * only_child() const { return deref(children); }
+#else
+        node * only_child() const { return (node*)children; }
+#endif
+        
+        /**
+         * Set the only child of this node.
+         *
+         * @param n child node or NULL
+         */
+#ifdef COMPACT_NODES
+        void set_only_child(node* n) { children = ref(n); }
+#else
+        void set_only_child(node* n) { children = n; }
+#endif
+        
+        /**
+         * Get array of children (if the node degree is at least two). The 
+         * array is a table indexed by transition symbols if the node degree 
+         * is at least NODE_TABLE_DEGREE (empty slots contain NULL 
+         * references).
+         *
+         * @returns array of child node references
+         */
+#ifdef COMPACT_NODES
+        node_ref * child_array() const {
+            return (node_ref*)link_region.address((uint64_t)children << 2);
+        }
+#else
+        node_ref * child_array() const { return (node_ref*)children; }
+#endif
+        
+        /**
+         * Set array of children.
+         *
+         * @param c array of child node references
+         */
+#ifdef COMPACT_NODES
+        void set_child_array(node_ref* c) {
+            children = link_region.offset(c) >> 2;
+        }
+#else
+        void set_child_array(node_ref* c) { children = c; }
+#endif
+
+#ifdef NODE_COLLAPSING
+        /**
+         * Get the packed collapsed sequence.
+         *
+         * @returns collapsed sequence
+         */
+#ifdef COMPACT_NODES
+        uint8_t * sequence() {
+            return inline_sequence() ? seq.bases 
+                : sequence_region.address(seq.block);
+        }
+#else
+        uint8_t * sequence() { return seq; }
+#endif
+        
+        /**
+         * Get the packed collapsed sequence.
+         *
+         * @returns collapsed sequence
+         */
+#ifdef COMPACT_NODES
+        const uint8_t * sequence() const {
+            return inline_sequence() ? seq.bases 
+                : sequence_region.address(seq.block);
+        }
+#else
+        const uint8_t * sequence() const { return seq; }
+#endif
+        
+#ifdef COMPACT_NODES
+        /**
+         * Check if the collapsed sequence is stored inline (short sequences 
+         * without N runs).
+         *
+         * @returns true if the sequence is stored inline, false otherwise
+         */
+        bool inline_sequence() const {
+            return len <= NODE_INLINE_BASES && !has_runs();
+        }
+#endif
         
+        /**
+         * Set an empty collapsed sequence (without changing its length).
+         */
+#ifdef COMPACT_NODES
+        void clear_sequence() { seq.block = 0; }
+#else
+        void clear_sequence() { seq = NULL; }
+#endif
+#endif
+    
     public:
         /**
          * Create a new node.
@@ -94,7 +376,7 @@ namespace alzw {
          * @param parent parent node
          */
         node(uint64_t id, uint8_t sym, uint32_t plen, node* parent);
-        
+
 #ifdef NODE_COLLAPSING
         /**
          * Create a new collapsed node with a given ID (phrase length will be 
@@ -105,20 +387,26 @@ namespace alzw {
          * the parent --> this transition
          * @param len    collapsed phrase length
          * @param parent parent node
+         * @param pool   pool for the collapsed sequence
          */
-        node(uint64_t id, uint8_t* phrase, uint32_t len, node* parent);
+        node(uint64_t id, uint8_t* phrase, uint32_t len, node* parent, 
+            nibble_pool& pool);
         
         /**
          * Create a new collapsed node based on a given node (usefull for 
-         * splitting of collapsed nodes).
+         * splitting of collapsed nodes). The new node shares the collapsed 
+         * sequence of the template if the offset is aligned to a whole byte 
+         * and the template does not contain any N runs.
          * 
          * @param n      template
          * @param offset zero-based offset within the template
          * @param len    collapsed sequence length
          * @param plen   forced phrase length
          * @param parent parent node
+         * @param pool   pool for the collapsed sequence
          */
-        node(node* n, uint32_t offset, uint32_t len, uint32_t plen, node* parent);
+        node(node* n, uint32_t offset, uint32_t len, uint32_t plen, node* parent, 
+            nibble_pool& pool);
 #endif
         
         /**
@@ -127,6 +415,35 @@ namespace alzw {
          */
         ~node();
         
+        /**
+         * Get node referenced by a given node reference.
+         *
+         * @param r node reference
+         * @returns node or NULL
+         */
+#ifdef COMPACT_NODES
+        static node * deref(node_ref r) {
+            return r ? (node*)node_region.address((uint64_t)r * sizeof(node)) 
+                : NULL;
+        }
+#else
+        static node * deref(node_ref r) { return r; }
+#endif
+        
+        /**
+         * Get reference to a given node.
+         *
+         * @param n node or NULL
+         * @returns node reference
+         */
+#ifdef COMPACT_NODES
+        static node_ref ref(const node* n) {
+            return n ? node_region.offset(n) / sizeof(node) : 0;
+        }
+#else
+        static node_ref ref(const node* n) { return const_cast<node*>(n); }
+#endif
+        
         /**
          * Release allocated links for children nodes.
          *
@@ -139,35 +456,43 @@ namespace alzw {
          *
          * @returns node ID
          */
+#ifdef COMPACT_NODES
+        uint64_t id() const { return ((uint64_t)nid_hi << 32) | nid_lo; }
+#else
         uint64_t id() const { return nid; }
+#endif
         
         /**
          * Set node ID.
          *
          * @param id new ID
          */
+#ifdef COMPACT_NODES
+        void set_id(uint64_t id) { nid_lo = id; nid_hi = id >> 32; }
+#else
         void set_id(uint64_t id) { nid = id; }
+#endif
         
         /**
          * Get transition symbol for the parent --> this transition
          *
          * @returns transition symbol
          */
-        uint8_t symbol() const { return sym; }
+        uint8_t symbol() const { return sym & ~NODE_N_RUNS; }
         
         /**
          * Get parent node.
          *
          * @returns parent node or NULL
          */
-        node * parent() { return par; }
+        node * parent() { return deref(par); }
         
         /**
          * Get parent node.
          *
          * @returns parent node or NULL
          */
-        const node * parent() const { return par; }
+        const node * parent() const { return deref(par); }
         
         /**
          * Get node out degree (number of children).
@@ -211,7 +536,7 @@ namespace alzw {
         void get_children(node** c);
         
         /**
-         * Set children.
+         * Set children. Transition symbols of the children must be unique.
          *
          * @param c         children
          * @param count     number of children
@@ -254,23 +579,27 @@ namespace alzw {
          * Append a given symbol to the collapsed sequence.
          *
          * @param base symbol
+         * @param pool pool containing the collapsed sequence
          */
-        void append(int base);
+        void append(int base, nibble_pool& pool);
         
         /**
          * Append a given phrase to the collapsed sequence.
          *
          * @param phrase phrase to be appended
          * @param len    phrase length
+         * @param pool   pool containing the collapsed sequence
          */
-        void append(uint8_t* phrase, uint32_t len);
+        void append(uint8_t* phrase, uint32_t len, nibble_pool& pool);
         
         /**
-         * Shrink the collapsed sequence to a given length.
+         * Shrink the collapsed sequence to a given length. The sequence 
+         * stays in place.
          *
-         * @param len target length
+         * @param len  target length
+         * @param pool pool containing the collapsed sequence
          */
-        void shrink(uint32_t len);
+        void shrink(uint32_t len, nibble_pool& pool);
 #else
         /**
          * Is this a collapsed node?
@@ -286,7 +615,7 @@ namespace alzw {
          */
         uint32_t length() const { return 0; }
 #endif
-
+        
         /**
          * Get size (in bytes) of this node.
          *
@@ -335,6 +664,27 @@ namespace alzw {
          * @returns symbol
          */
         uint8_t get_base(uint32_t index) const;
+        
+        /**
+         * Compare a given sequence of symbols with the collapsed sequence 
+         * starting at a given offset. Blocks of 32 symbols are compared at 
+         * once whenever possible.
+         *
+         * @param offset zero-based offset within the collapsed sequence
+         * @param bases  symbols
+         * @param count  number of symbols
+         * @returns number of matching symbols
+         */
+        uint32_t match(uint32_t offset, const uint8_t* bases, 
+            uint32_t count) const;
+        
+        /**
+         * Write first symbols of the collapsed sequence as characters.
+         *
+         * @param dst   output buffer
+         * @param count number of symbols
+         */
+        void expand(char* dst, uint32_t count) const;
     };
     
     /**
@@ -358,6 +708,18 @@ namespace alzw {
         size_t addBufferSize;
         uint32_t addLen;
         
+        /**
+         * Create the initial nodes.
+         *
+         * @param indexed if true, codewords will be indexed by a node index
+         */
+        void init(bool indexed);
+        
+        /**
+         * Release all nodes.
+         */
+        void release();
+        
         /**
          * Split current node.
          */
@@ -370,17 +732,22 @@ namespace alzw {
          * @param prefix prefix spacing
          */
         void print(const node* n, const std::string& prefix) const;
-        
+    
     public:
         /**
          * Create a new dictionary.
          *
-         * @param indexed if true, the codewords will be indexed using RB tree
+         * @param indexed if true, codewords will be indexed by a node index
          */
         dictionary(bool indexed = true);
         
         virtual ~dictionary();
         
+        /**
+         * Remove all phrases and restore the initial state of the dictionary.
+         */
+        void clear();
+        
         /**
          * Follow transition from the current node for a given transition 
          * symbol. Add a new node if there is no such transition. All added 
@@ -457,6 +824,32 @@ namespace alzw {
          */
         bool follow(char c);
         
+        /**
+         * Follow transitions for a given sequence of symbols as long as 
+         * possible. It is equivalent to calling follow() for every symbol 
+         * until it fails, but runs within collapsed nodes are followed in 
+         * bulk.
+         *
+         * @param s     transition symbols
+         * @param count number of symbols
+         * @returns number of followed symbols
+         */
+        size_t follow_run(const char* s, size_t count);
+        
+        /**
+         * Add symbols from a given sequence until the current ID reaches a 
+         * given ID. It is equivalent to calling add() for every symbol, but 
+         * existing transitions are followed in bulk (see follow_run()) and 
+         * the rest of the sequence is appended to the pending collapsed 
+         * node at once. The given ID must not be in the dictionary yet.
+         *
+         * @param s     symbols
+         * @param count number of symbols
+         * @param id    ID of the new phrase
+         * @returns number of added symbols
+         */
+        size_t add_run(const char* s, size_t count, uint64_t id);
+        
         /**
          * Check if there is transition for a given symbol from the current 
          * node.
@@ -490,6 +883,14 @@ namespace alzw {
          */
         size_t used_memory() const;
         
+        /**
+         * Get number of bytes used by dictionary nodes excluding the codeword
+         * index (if any).
+         * 
+         * @returns memory used by nodes
+         */
+        size_t node_memory() const;
+        
         /**
          * Get number of used virtual nodes (codewords).
          *
@@ -638,186 +1039,64 @@ namespace alzw {
     };
     
     /**
-     * Node index (based on RB tree).
+     * Node index. The codeword space is split into pages of 
+     * 2^NODE_INDEX_PAGE_BITS codewords and every page keeps a small sorted 
+     * array of nodes starting within the page. Lookups go directly to 
+     * the page containing a given codeword, so there is no pointer chasing 
+     * and the index costs roughly nine bytes per node. Node IDs are 
+     * assigned almost monotonically (only splits insert interior IDs), so 
+     * new nodes are usually appended at the end of the last page.
      */
     class node_index {
-    private:
-        /**
-         * RB node.
-         */
-        struct rb_node {
-            node* n;
-            rb_node* parent;
-            rb_node* left;
-            rb_node* right;
-            bool black;
-            
-            rb_node(node* n);
-        };
-        
-    public:
         /**
-         * RB tree iterator.
+         * Index page.
          */
-        class iterator {
-            int state;
-            rb_node* n;
-        
-        public:
-            iterator(rb_node* root);
-            node * next();
+        struct page {
+            node* floor;        // last node starting before this page or NULL
+            node_ref* nodes;    // nodes starting within this page
+            uint8_t* offsets;   // node ID offsets within this page (sorted)
+            uint32_t count;
+            uint32_t capacity;
         };
-    
-    private:
-        rb_node* root;
-        size_t count;
-        
-        /**
-         * Allocate a new RB node for a given dictionary node.
-         *
-         * @param n dictionary node
-         * @returns RB node
-         */
-        rb_node * alloc_node(node* n);
-        
-        /**
-         * Free a given RB node.
-         *
-         * @param n RB node
-         */
-        void free_node(rb_node* n);
-        
-        /**
-         * Free a given RB (sub)tree.
-         *
-         * @param n RB (sub)tree
-         */
-        void free_tree(rb_node* n);
-        
-        /**
-         * Insert a given RB node.
-         *
-         * @param n RB node
-         */
-        void insert(rb_node* n);
-        
-        /**
-         * Insert a given RB node into a given RB tree.
-         *
-         * @param tree RB tree
-         * @param n    RB node
-         */
-        void insert(rb_node* tree, rb_node* n);
-        
-        /**
-         * Normalize RB tree after insertion.
-         *
-         * @param n inserted node
-         */
-        void insert_normalize(rb_node* n);
-        
-        /**
-         * Remove a given node from RB tree.
-         *
-         * @param n RB node to be removed
-         */
-        void remove(rb_node* n);
-        
-        /**
-         * Normalize RB tree after deletion.
-         *
-         * @param parent parent of the deleted node
-         * @param n      child of the deleted node
-         */
-        void remove_normalize(rb_node* parent, rb_node* n);
-        
-        /**
-         * Normalize RB tree after deletion (part 2).
-         *
-         * @param parent parent of the deleted node
-         * @param n      child of the deleted node
-         */
-        void remove_normalize2(rb_node* parent, rb_node* n);
-        
-        /**
-         * Normalize RB tree after deletion (part 3).
-         *
-         * @param parent parent of the deleted node
-         * @param n      child of the deleted node
-         */
-        void remove_normalize3(rb_node* parent, rb_node* n);
         
-        /**
-         * Get predecessor of a given RB node.
-         *
-         * @param n RB node
-         * @returns predecessor or NULL
-         */
-        rb_node * pred(rb_node* n);
-        
-        /**
-         * Get maximum in a given RB tree.
-         *
-         * @param tree RB tree
-         * @returns max RB node
-         */
-        rb_node * max(rb_node* tree);
-        
-        /**
-         * Get grandparent of a given RB node.
-         *
-         * @param n RB node
-         * @returns node's grandparent or NULL
-         */
-        rb_node * grandparent(rb_node* n);
-        
-        /**
-         * Get uncle of a given RB node.
-         *
-         * @param n RB node
-         * @returns node's uncle or NULL
-         */
-        rb_node * uncle(rb_node* n);
-        
-        /**
-         * Rotate left around a given node.
-         *
-         * @param n RB node
-         */
-        void rotate_left(rb_node* n);
+        page* pages;
+        size_t page_count;
+        size_t page_capacity;
+        size_t count;
+        size_t mem;
         
         /**
-         * Rotate right around a given node.
+         * Make sure that there is a page for a given node ID. New pages 
+         * start after the last indexed node.
          *
-         * @param n RB node
+         * @param id node ID
          */
-        void rotate_right(rb_node* n);
+        void ensure_page(uint64_t id);
         
         /**
-         * Is a given node black?
+         * Grow node arrays of a given page.
          *
-         * @param n RB node or NULL
-         * @returns true if the node is black, false otherwise
+         * @param pg page
          */
-        bool is_black(rb_node* n);
+        void grow(page& pg);
         
         /**
-         * Print a given RB (sub)tree (used for debugging).
+         * Get the last node starting within a given page or before it.
          *
-         * @param n RB (sub)tree
+         * @param p page index
+         * @returns node or NULL
          */
-        void print(rb_node* n);
+        node * last(size_t p) const;
         
         /**
-         * Validate a given RB (sub)tree.
+         * Propagate the last node of a given page into the following pages 
+         * (up to the next non-empty page). It must be called whenever the 
+         * last node of a page changes.
          *
-         * @param n RB (sub)tree
-         * @param bdepth left-subtree black depth
-         * @param cdepth right-subtree black depth
-         * @returns black depth
+         * @param p page index
          */
-        int validate(rb_node* n, int bdepth, int cdepth);
-        
+        void update_floors(size_t p);
+    
     public:
         /**
          * Create a new ALZW node index.
@@ -851,7 +1130,7 @@ namespace alzw {
          * @param id node ID
          * @returns node
          */
-        node * get(uint64_t id);
+        node * get(uint64_t id) const;
         
         /**
          * Get number of indexed nodes.
@@ -865,30 +1144,17 @@ namespace alzw {
          *
          * @returns number of bytes used by this index
          */
-        size_t used_memory() const { return count * sizeof(rb_node); }
-        
-        /**
-         * Get index iterator.
-         *
-         * @returns index iterator
-         */
-        iterator begin();
-        
-        /**
-         * Print the index (used for debugging).
-         */
-        void print();
-        
-        /**
-         * Validate the RB tree.
-         */
-        void validate();
+        size_t used_memory() const { return mem; }
     };
     
     /**
      * Abstract node allocator.
      */
     class node_allocator {
+        slab_arena node_arena;
+        slab_arena* child_arenas[256];
+        nibble_pool pool;
+    
     protected:
         size_t nodes;
         size_t mem;
@@ -906,14 +1172,18 @@ namespace alzw {
          * @param n node
          */
         virtual void remove(node* n) = 0;
-        
+    
     public:
         /**
          * Create a new node allocator.
          */
         node_allocator();
         
-        virtual ~node_allocator() { }
+        /**
+         * Destroy all nodes allocated using this allocator and release 
+         * their memory.
+         */
+        virtual ~node_allocator();
         
         /**
          * Get number of bytes used by nodes allocated using this allocator 
@@ -923,6 +1193,16 @@ namespace alzw {
          */
         virtual size_t used_memory() const { return mem; }
         
+        /**
+         * Get number of bytes used by nodes allocated using this allocator 
+         * excluding size of any index. The value depends only on the 
+         * dictionary content, so it is the same for an encoder and a decoder 
+         * of the same stream.
+         * 
+         * @returns memory used by nodes
+         */
+        size_t node_memory() const { return mem; }
+        
         /**
          * Get number of used virtual nodes.
          *
@@ -944,6 +1224,13 @@ namespace alzw {
          */
         virtual size_t real_nodes() const = 0;
         
+        /**
+         * Allocate a new root node. The root node does not consume any ID.
+         *
+         * @returns new node
+         */
+        node * alloc_root();
+        
         /**
          * Allocate a new node for a given transition parent -- sym --> node.
          * 
@@ -991,20 +1278,38 @@ namespace alzw {
         virtual void append(node* n, uint8_t* phrase, uint32_t len);
         
         /**
-         * Allocate array for storing children node pointers.
+         * Allocate array for storing children node references. An empty 
+         * child table is allocated if the number of children is at least 
+         * NODE_TABLE_DEGREE.
          *
-         * @param count array width
+         * @param count number of children
          * @returns array
          */
-        virtual node ** alloc_children(uint8_t count);
+        virtual node_ref * alloc_children(uint8_t count);
         
         /**
-         * Free a given array for storing children node pointers.
+         * Free a given array for storing children node references.
          *
          * @param children array
-         * @param count    array width
+         * @param count    number of children
+         */
+        virtual void free_children(node_ref* children, uint8_t count);
+        
+        /**
+         * Resize storage for children node references. A child table is 
+         * kept (including its content) if the new number of children still 
+         * uses a table, otherwise the storage is freed and a new one is 
+         * allocated (with undefined content).
+         *
+         * @param children array or NULL if the current number of children is 
+         * less than two
+         * @param count    current number of children
+         * @param ncount   new number of children
+         * @returns array or NULL if the new number of children is less than 
+         * two
          */
-        virtual void free_children(node** children, uint8_t count);
+        virtual node_ref * resize_children(node_ref* children, uint8_t count, 
+            uint8_t ncount);
     };
     
     /** 
@@ -1012,13 +1317,13 @@ namespace alzw {
      */
     class simple_node_allocator : public node_allocator {
         size_t rnodes;
-        
+    
     protected:
         
         virtual void insert(node* n) { rnodes++; }
         
         virtual void remove(node* n) { rnodes--; }
-        
+    
     public:
         /**
          * Create a new simple node allocator.
@@ -1031,17 +1336,17 @@ namespace alzw {
     };
     
     /**
-     * RB tree indexed node allocator.
+     * Indexed node allocator.
      */
     class indexed_node_allocator : public node_allocator {
         node_index index;
-        
+    
     protected:
         
         virtual void insert(node* n);
         
         virtual void remove(node* n);
-        
+    
     public:
         
         virtual ~indexed_node_allocator() { }
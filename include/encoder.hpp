@@ -29,23 +29,16 @@ THE SOFTWARE.
 
 #include "dictionary.hpp"
 #include "bit-io.hpp"
+#include "seek-index.hpp"
+#include "codeword-coder.hpp"
 
 /** @file */
 
 namespace alzw {
     /**
-     * ALZW encoder.
+     * Encoding stats.
      */
-    class encoder {
-        dictionary dict;
-        std::deque<uint64_t> ins_queue;
-        int sync_period;
-        
-        // encoding stats:
-        size_t ndel;
-        size_t nins;
-        size_t nmm;
-        
+    struct encoder_stats {
         size_t nmatches;
         size_t nmismatches;
         size_t ninserts;
@@ -64,7 +57,50 @@ namespace alzw {
         size_t nibits;
         size_t ndbits;
         
+        /**
+         * Create new zeroed stats.
+         */
+        encoder_stats();
+        
+        /**
+         * Add given stats to these stats.
+         *
+         * @param s stats
+         * @returns this object
+         */
+        encoder_stats& operator+=(const encoder_stats& s);
+    };
+    
+    /**
+     * ALZW encoder.
+     */
+    class encoder {
+        dictionary* own_dict;
+        dictionary& dict;
+        std::deque<uint64_t> ins_queue;
+        int sync_period;
+        
+        seek_index* index;
+        uint32_t seq;
+        
+        // state of the currently encoded sequence
+        std::vector<uint32_t>* sync_map;
+        size_t roffset;
+        size_t aoffset;
+        size_t next_sp;
+        size_t smi;
+        
+        encoder_stats stats;
+        
+        size_t ndel;
+        size_t nins;
+        size_t nmm;
+        
         size_t width;
+        
+        // codeword coder
+        uint8_t coder;
+        codeword_writer* cw_writer;
 
 #define OP_MATCH    0
 #define OP_MISMATCH 1
@@ -86,6 +122,17 @@ namespace alzw {
          */
         void match(char c, bwriter& out);
         
+        /**
+         * Encode a run of match characters following the previous match as 
+         * long as the run can be followed in the dictionary without adding 
+         * any nodes or emitting any codewords.
+         *
+         * @param s   characters
+         * @param len run length
+         * @returns number of encoded characters
+         */
+        size_t follow_matches(const char* s, size_t len);
+        
         /**
          * Encode mismatch character.
          *
@@ -168,6 +215,15 @@ namespace alzw {
          */
         void sync(bwriter& out);
         
+        /**
+         * Record the current encoder state into the seek index (if any).
+         *
+         * @param roffset reference sequence offset
+         * @param aoffset offset within the encoded sequence
+         * @param out     output
+         */
+        void add_seek_point(size_t roffset, size_t aoffset, bwriter& out);
+        
     public:
         /**
          * Create a new ALZW encoder.
@@ -177,6 +233,19 @@ namespace alzw {
          */
         encoder(int sync_period);
         
+        /**
+         * Create a new ALZW encoder continuing with a given dictionary (e.g. 
+         * a dictionary restored by decoding an existing ALZW stream).
+         *
+         * @param sync_period synchronization period (or minimum phrase length
+         * in case of adaptive synchronization)
+         * @param dict        dictionary (it must outlive the encoder)
+         * @param width       current codeword width
+         */
+        encoder(int sync_period, dictionary& dict, int width);
+        
+        virtual ~encoder();
+        
         /**
          * Encode a given pairwise alignment.
          *
@@ -188,6 +257,65 @@ namespace alzw {
         void encode(const std::string& rseq, const std::string& aseq, 
             bwriter& out, std::vector<uint32_t>* sync_map = NULL);
         
+        /**
+         * Start encoding of a new pairwise alignment. The alignment is then 
+         * passed to the encoder in blocks of columns using encode_block() 
+         * and the encoding must be finished using end_sequence().
+         *
+         * @param out      output
+         * @param sync_map synchronization map for adaptive synchronization
+         */
+        void begin_sequence(bwriter& out, 
+            std::vector<uint32_t>* sync_map = NULL);
+        
+        /**
+         * Encode a given block of columns of the current pairwise alignment.
+         *
+         * @param rblock reference sequence symbols
+         * @param ablock aligned sequence symbols
+         * @param len    number of columns
+         * @param out    output
+         */
+        void encode_block(const char* rblock, const char* ablock, size_t len,
+            bwriter& out);
+        
+        /**
+         * Finish encoding of the current pairwise alignment.
+         *
+         * @param out output
+         */
+        void end_sequence(bwriter& out);
+        
+        /**
+         * Remove all phrases from the dictionary and restore the initial 
+         * encoder state, so the next sequence is encoded as if it was the 
+         * first one. It can be called only between sequences.
+         */
+        void reset_dictionary();
+        
+        /**
+         * Set seek index. Beginning of every encoded sequence and every 
+         * synchronization point will be recorded into the index.
+         *
+         * @param index seek index (may be NULL)
+         */
+        void set_seek_index(seek_index* index) { this->index = index; }
+        
+        /**
+         * Set codeword coder. It can be changed only before the first 
+         * sequence.
+         *
+         * @param coder CODER_FIXED or CODER_RANGE
+         */
+        void set_coder(uint8_t coder);
+        
+        /**
+         * Get codeword coder.
+         *
+         * @returns codeword coder
+         */
+        uint8_t get_coder() const { return coder; }
+        
         /**
          * Get dictionary.
          *
@@ -195,110 +323,139 @@ namespace alzw {
          */
         const dictionary & get_dictionary() const { return dict; }
         
+        /**
+         * Get current codeword width.
+         *
+         * @returns codeword width
+         */
+        int get_width() const { return width; }
+        
+        /**
+         * Get synchronization period.
+         *
+         * @returns synchronization period
+         */
+        int get_sync_period() const { return sync_period; }
+        
+        /**
+         * Get encoding stats.
+         *
+         * @returns stats
+         */
+        const encoder_stats & get_stats() const { return stats; }
+        
+        /**
+         * Add stats of some other encoder (e.g. a frozen encoder sharing 
+         * dictionary of this encoder).
+         *
+         * @param s stats
+         */
+        void add_stats(const encoder_stats& s) { stats += s; }
+        
         /**
          * Get size of encoded data.
          * 
          * @returns size of encoded data
          */
-        size_t size() const { return (nmmbits + nibits + ndbits) >> 3; }
+        size_t size() const { return (stats.nmmbits + stats.nibits + stats.ndbits) >> 3; }
         
         /**
          * Get total number of encoded bits in match/mismatch subsequences.
          * 
          * @returns number of encoded match/mismatch bits
          */
-        size_t mmbits() const { return nmmbits; }
+        size_t mmbits() const { return stats.nmmbits; }
         
         /**
          * Get total number of encoded bits in insertion subsequences.
          * 
          * @returns number of encoded insertion bits
          */
-        size_t ibits() const { return nibits; }
+        size_t ibits() const { return stats.nibits; }
         
         /**
          * Get total number of encoded bits in deletion subsequences.
          * 
          * @returns number of encoded deletion bits
          */
-        size_t dbits() const { return ndbits; }
+        size_t dbits() const { return stats.ndbits; }
         
         /**
          * Get total number of matched symbols.
          *
          * @returns total number of matched symbols
          */
-        size_t matches() const { return nmatches; }
+        size_t matches() const { return stats.nmatches; }
         
         /**
          * Get total number of mismatched symbols.
          *
          * @returns total number of mismatched symbols
          */
-        size_t mismatches() const { return nmismatches; }
+        size_t mismatches() const { return stats.nmismatches; }
         
         /**
          * Get total number of inserted symbols.
          *
          * @returns total number of inserted symbols
          */
-        size_t inserts() const { return ninserts; }
+        size_t inserts() const { return stats.ninserts; }
         
         /**
          * Get total number of deleted symbols.
          *
          * @returns total number of deleted symbols
          */
-        size_t deletes() const { return ndeletes; }
+        size_t deletes() const { return stats.ndeletes; }
         
         /**
          * Get total number of match/mismatch subsequences read.
          *
          * @returns number of match/mismatch subsequences
          */
-        size_t mmseqs() const { return nmmseqs; }
+        size_t mmseqs() const { return stats.nmmseqs; }
         
         /**
          * Get total number of match subsequences read.
          *
          * @returns number of match subsequences
          */
-        size_t mseqs() const { return nmseqs; }
+        size_t mseqs() const { return stats.nmseqs; }
         
         /**
          * Get total number of insertion subsequences read.
          *
          * @returns number of insertion subsequences
          */
-        size_t iseqs() const { return niseqs; }
+        size_t iseqs() const { return stats.niseqs; }
         
         /**
          * Get total number of deletion subsequences read.
          *
          * @returns number of deletion subsequences
          */
-        size_t dseqs() const { return ndseqs; }
+        size_t dseqs() const { return stats.ndseqs; }
         
         /**
          * Get total number of written match/mismatch subsequences.
          *
          * @returns number of written match/mismatch subsequences
          */
-        size_t mmouts() const { return nmmouts; }
+        size_t mmouts() const { return stats.nmmouts; }
         
         /**
          * Get total number of written insertion subsequences.
          *
          * @returns number of written insertion subsequences
          */
-        size_t iouts() const { return niouts; }
+        size_t iouts() const { return stats.niouts; }
         
         /**
          * Get total number of written deletion subsequences.
          *
          * @returns number of written deletion subsequences
          */
-        size_t douts() const { return ndouts; }
+        size_t douts() const { return stats.ndouts; }
         
         /**
          * Get number of bytes used by dictionary nodes.
@@ -307,6 +464,14 @@ namespace alzw {
          */
         size_t used_memory() const { return dict.used_memory(); }
         
+        /**
+         * Get number of bytes used by dictionary nodes excluding the codeword
+         * index (if any).
+         * 
+         * @returns memory used by nodes
+         */
+        size_t node_memory() const { return dict.node_memory(); }
+        
         /**
          * Get number of used virtual nodes (codewords).
          *
@@ -321,6 +486,158 @@ namespace alzw {
          */
         size_t real_nodes() const { return dict.real_nodes(); }
     };
+    
+    /**
+     * ALZW encoder using a frozen dictionary of some other encoder. The 
+     * dictionary is not updated at all, so any number of frozen encoders 
+     * can share the same dictionary and run concurrently. Every symbol is 
+     * encoded using the longest phrase already present in the dictionary.
+     */
+    class frozen_encoder {
+        dictionary_view dict;
+        std::deque<uint64_t> ins_queue;
+        int sync_period;
+        
+        uint64_t next_id;
+        int width;
+        
+        codeword_writer* cw_writer;
+        
+        // state of the currently encoded sequence
+        std::vector<uint32_t>* sync_map;
+        std::vector<seek_point>* points;
+        seek_point point;
+        size_t roffset;
+        size_t aoffset;
+        size_t next_sp;
+        size_t smi;
+        
+        encoder_stats stats;
+        
+        size_t ndel;
+        size_t nins;
+        size_t nmm;
+        
+        int8_t last_op;
+        
+        /**
+         * Encode match/mismatch character.
+         *
+         * @param c     character
+         * @param match true in case of match
+         * @param out   output
+         */
+        void mm(char c, bool match, bwriter& out);
+        
+        /**
+         * Encode insertion character.
+         *
+         * @param c   character
+         * @param out output
+         */
+        void ins(char c, bwriter& out);
+        
+        /**
+         * Encode deletion.
+         *
+         * @param out output
+         */
+        void del(bwriter& out);
+        
+        /**
+         * Flush match/mismatch subsequence.
+         *
+         * @param out output
+         */
+        void flush_mm(bwriter& out);
+        
+        /**
+         * Flush insertion subsequence.
+         * 
+         * @param out output
+         */
+        void flush_ins(bwriter& out);
+        
+        /**
+         * Flush deletion subsequence.
+         * 
+         * @param out output
+         */
+        void flush_del(bwriter& out);
+        
+        /**
+         * Flush all.
+         * 
+         * @param out output
+         */
+        void flush(bwriter& out);
+        
+    public:
+        /**
+         * Create a new frozen encoder sharing dictionary of a given encoder. 
+         * The given encoder must not encode anything while there is any 
+         * frozen encoder using its dictionary.
+         *
+         * @param enc encoder
+         */
+        frozen_encoder(const encoder& enc);
+        
+        virtual ~frozen_encoder();
+        
+        /**
+         * Encode a given pairwise alignment.
+         *
+         * @param rseq     reference sequence
+         * @param aseq     aligned sequence
+         * @param out      output
+         * @param sync_map synchronization map for adaptive synchronization
+         * @param seq      zero-based sequence index (used for seek points)
+         * @param points   output for seek points (may be NULL), bit offsets 
+         * are relative to the output
+         */
+        void encode(const std::string& rseq, const std::string& aseq, 
+            bwriter& out, std::vector<uint32_t>* sync_map = NULL, 
+            uint32_t seq = 0, std::vector<seek_point>* points = NULL);
+        
+        /**
+         * Start encoding of a new pairwise alignment (see 
+         * encoder::begin_sequence()).
+         *
+         * @param out      output
+         * @param sync_map synchronization map for adaptive synchronization
+         * @param seq      zero-based sequence index (used for seek points)
+         * @param points   output for seek points (may be NULL), bit offsets 
+         * are relative to the output
+         */
+        void begin_sequence(bwriter& out, 
+            std::vector<uint32_t>* sync_map = NULL, uint32_t seq = 0, 
+            std::vector<seek_point>* points = NULL);
+        
+        /**
+         * Encode a given block of columns of the current pairwise alignment.
+         *
+         * @param rblock reference sequence symbols
+         * @param ablock aligned sequence symbols
+         * @param len    number of columns
+         * @param out    output
+         */
+        void encode_block(const char* rblock, const char* ablock, size_t len,
+            bwriter& out);
+        
+        /**
+         * Finish encoding of the current pairwise alignment.
+         *
+         * @param out output
+         */
+        void end_sequence(bwriter& out);
+        
+        /**
+         * Get encoding stats.
+         *
+         * @returns stats
+         */
+        const encoder_stats & get_stats() const { return stats; }
+    };
 }
 
 #endif /* _ENCODER_HPP */
@@ -72,6 +72,146 @@ namespace alzw {
          */
         static fasta_alignment load(const char* file);
     };
+    
+    /**
+     * Streaming reader of FASTA encoded pairwise DNA alignments. Both 
+     * sequences of the alignment are read simultaneously in blocks of 
+     * columns using two independent file streams, so the memory usage does 
+     * not depend on the sequence length. The aligned sequence stream starts 
+     * at the second header line which is searched for around the middle of 
+     * the file (both sequences have the same number of symbols). The file is 
+     * validated (using the same rules as in case of fasta_alignment::load())
+     * while it is being read, an exception is thrown as soon as an invalid 
+     * symbol is found or the sequences turn out to have different lengths.
+     * 
+     * Input which is not seekable (e.g. a pipe) is read in a single pass, 
+     * the reference sequence is buffered in memory in such case.
+     */
+    class fasta_alignment_reader {
+        /**
+         * Input stream of a single aligned sequence.
+         */
+        struct sequence_stream {
+            FILE* file;
+            char buffer[4096];
+            size_t offset;
+            size_t size;
+            long base;          // file offset of the buffer
+            bool bol;           // beginning of a line
+            bool end;           // end of the sequence
+            bool started;       // at least one symbol has been read
+            
+            /**
+             * Position the stream at a given file offset (the beginning of 
+             * a sequence or its header line).
+             *
+             * @param pos file offset
+             */
+            void seek(long pos);
+            
+            /**
+             * Start reading at the current position of the file.
+             *
+             * @param pos current file offset
+             */
+            void reset(long pos);
+            
+            /**
+             * Continue with the next sequence after the current one ended at 
+             * a header line.
+             */
+            void next_sequence() { end = false; started = false; }
+            
+            /**
+             * Skip the rest of the current line.
+             */
+            void skip_line();
+            
+            /**
+             * Skip header lines of empty sequences and blank lines.
+             *
+             * @param pos file offset where to stop (-1 means the end of the 
+             * file)
+             * @returns true if the given offset has been reached, false if 
+             * there is a sequence symbol before it
+             */
+            bool skip_empty(long pos);
+            
+            /**
+             * Read next block of the file into the buffer.
+             *
+             * @returns false at the end of the file
+             */
+            bool fill();
+            
+            /**
+             * Read next symbols of the sequence. The sequence ends at the end
+             * of the file or at the next header line. Header lines before 
+             * the first symbol are skipped.
+             *
+             * @param symbols output
+             * @param count   maximum number of symbols
+             * @returns number of symbols read (less than count only at the 
+             * end of the sequence)
+             */
+            size_t read(char* symbols, size_t count);
+            
+            /**
+             * Check if the sequence ended at a header line of another 
+             * sequence.
+             *
+             * @returns true if the stream is positioned at a header line
+             */
+            bool at_header() const { return end && offset < size; }
+            
+            /**
+             * Get file offset of the next character.
+             *
+             * @returns file offset
+             */
+            long tell() const { return base + offset; }
+        };
+        
+        sequence_stream rstream;
+        sequence_stream astream;
+        long astart;
+        size_t columns;
+        
+        // the reference sequence in case of input which is not seekable 
+        // (rstream is not used then)
+        std::vector<char> reference;
+        size_t r_offset;
+        
+        /**
+         * Read the whole reference sequence into memory and continue with 
+         * the aligned sequence using the same stream.
+         */
+        void buffer_reference();
+        
+        // disable copying
+        fasta_alignment_reader(const fasta_alignment_reader&);
+        fasta_alignment_reader& operator=(const fasta_alignment_reader&);
+        
+    public:
+        /**
+         * Open a given FASTA alignment file.
+         *
+         * @param file path to a file
+         */
+        fasta_alignment_reader(const char* file);
+        
+        virtual ~fasta_alignment_reader();
+        
+        /**
+         * Read next block of alignment columns.
+         *
+         * @param rblock output for the reference sequence symbols
+         * @param ablock output for the aligned sequence symbols
+         * @param size   maximum number of columns
+         * @returns number of columns read (0 at the end of the alignment)
+         */
+        size_t read(char* rblock, char* ablock, size_t size);
+    };
 }
 
 #endif /* _FASTA_ALIGNMENT_HPP */
@@ -0,0 +1,107 @@
+/*
+Copyright (c) 2015 Perutka, Ondrej
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _FASTA_WRITER_HPP
+#define _FASTA_WRITER_HPP
+
+#include <cstdio>
+#include <vector>
+#include <thread>
+#include <streambuf>
+
+#include "bounded-queue.hpp"
+
+/** @file */
+
+// length of sequence lines in FASTA files
+#define FASTA_LINE_LENGTH   60
+
+// size of symbol blocks passed between the writer stages
+#define FASTA_BLOCK_SIZE    (1 << 18)
+
+namespace alzw {
+    /**
+     * Asynchronous writer of FASTA sequence data. It is a stream buffer 
+     * accepting raw sequence symbols (without line breaks). The symbols are
+     * collected into large blocks by the calling thread, a formatter thread
+     * breaks them into lines and a writer thread writes the formatted 
+     * blocks into the output stream. The number of pending blocks between 
+     * the stages is limited.
+     * 
+     * A write failure is reported as a failure of the output stream using 
+     * this buffer and it is also reported by close().
+     */
+    class async_fasta_writer : public std::streambuf {
+        std::vector<char> buffer;
+        
+        FILE* stream;
+        bounded_queue<std::vector<char>> symbols;
+        bounded_queue<std::vector<char>> lines;
+        std::thread formatter_thread;
+        std::thread writer_thread;
+        bool failed;
+        
+        /**
+         * Formatter thread loop.
+         */
+        void formatter();
+        
+        /**
+         * Writer thread loop.
+         */
+        void writer();
+        
+        /**
+         * Pass the collected symbols to the formatter thread.
+         *
+         * @returns false if the symbols cannot be written
+         */
+        bool submit();
+        
+    protected:
+        virtual int_type overflow(int_type c);
+        
+    public:
+        /**
+         * Create a new asynchronous FASTA writer for a given stream. The 
+         * stream is not closed by the writer.
+         *
+         * @param stream   stream (positioned right after the sequence 
+         * header)
+         * @param capacity maximum number of pending blocks between stages
+         */
+        async_fasta_writer(FILE* stream, size_t capacity = 8);
+        
+        /**
+         * Flush all data and stop the threads.
+         */
+        virtual ~async_fasta_writer();
+        
+        /**
+         * Flush all data, wait until everything is written and stop the 
+         * threads. No data can be written afterwards.
+         */
+        void close();
+    };
+}
+
+#endif /* _FASTA_WRITER_HPP */
@@ -0,0 +1,114 @@
+/*
+Copyright (c) 2015 Perutka, Ondrej
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _NIBBLE_POOL_HPP
+#define _NIBBLE_POOL_HPP
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+#include "slab-arena.hpp"
+
+/** @file */
+
+// minimum size of a nibble pool segment in bytes
+#define NIBBLE_POOL_SEGMENT (1 << 20)
+
+namespace alzw {
+    /**
+     * Append-only pool of packed symbol sequences. Blocks are carved from 
+     * large segments which are never moved, so pointers into the pool stay 
+     * valid until the pool is destroyed. Blocks are never freed one by one, 
+     * the whole pool is released at once. The most recently allocated block 
+     * can grow in place. Segments are either allocated on the heap or carved 
+     * from a given slab region.
+     */
+    class nibble_pool {
+        std::vector<uint8_t*> segments;
+        std::vector<size_t> sizes;
+        slab_region* region;
+        uint8_t* next;
+        uint8_t* end;
+        size_t allocated;
+        size_t abandoned;
+        
+        /**
+         * Allocate a new segment.
+         *
+         * @param size minimum segment size in bytes
+         */
+        void add_segment(size_t size);
+        
+    public:
+        /**
+         * Create a new empty pool.
+         *
+         * @param region region to carve segments from or NULL
+         */
+        nibble_pool(slab_region* region = NULL);
+        
+        virtual ~nibble_pool();
+        
+        /**
+         * Allocate a new block. The content of the block is undefined.
+         *
+         * @param size block size in bytes
+         * @returns block or NULL if the size is zero
+         */
+        uint8_t * alloc(size_t size);
+        
+        /**
+         * Grow a given block. The block grows in place if it is the last 
+         * block of the pool and the current segment has enough space, 
+         * otherwise the block content is copied into a new block at the end 
+         * of the pool (and the old block is abandoned). A relocated block 
+         * gets a segment large enough to keep growing in place for a while.
+         *
+         * @param block block allocated from this pool or NULL
+         * @param size  current block size in bytes
+         * @param nsize new block size in bytes
+         * @returns grown block
+         */
+        uint8_t * grow(uint8_t* block, size_t size, size_t nsize);
+        
+        /**
+         * Get number of bytes allocated by this pool. All segments are 
+         * counted as a whole, i.e. including abandoned blocks and unused 
+         * tails of outgrown segments.
+         *
+         * @returns allocated memory
+         */
+        size_t allocated_memory() const { return allocated; }
+        
+        /**
+         * Get number of bytes wasted by this pool, i.e. bytes of blocks 
+         * abandoned when they were copied by grow() and unused tails of 
+         * outgrown segments. The memory is a part of the allocated memory.
+         *
+         * @returns abandoned memory
+         */
+        size_t abandoned_memory() const { return abandoned; }
+    };
+}
+
+#endif /* _NIBBLE_POOL_HPP */
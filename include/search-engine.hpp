@@ -27,10 +27,13 @@ THE SOFTWARE.
 #include <functional>
 #include <unordered_map>
 #include <deque>
+#include <vector>
 #include <stdint.h>
 
 #include "dictionary.hpp"
-#include "decoder.hpp"
+#include "snapshot.hpp"
+#include "seek-index.hpp"
+#include "archive.hpp"
 #include "fautomaton.hpp"
 
 /** @file */
@@ -291,29 +294,89 @@ namespace alzw {
         
         std::string alzw_file;
         std::string rseq;
-        decoder dec;
+        archive_header hdr;
+        std::vector<dictionary_snapshot*> dicts;
+        seek_index* index;
+        size_t threads;
+        
+        std::vector<size_t> selection;
+        
+        /**
+         * Load or create dictionary snapshot of a given chunk.
+         *
+         * @param chunk  chunk index
+         * @param origin origin of the ALZW archive
+         * @returns dictionary snapshot
+         */
+        dictionary_snapshot * load_dictionary(size_t chunk, 
+            const dictionary_snapshot::origin& origin);
         
         /**
          * Invoke a given search task.
          *
          * @param stask search task
+         * @param chunk chunk index
          * @param h     match handler
          * @param misc  user data to be passed back to the handler
          */
-        void search(search_task& stask, match_handler* h, void* misc);
+        void search(search_task& stask, size_t chunk, 
+            match_handler* h, void* misc);
+        
+        /**
+         * Search for a given pattern in a given chunk.
+         *
+         * @param alg   algorithm
+         * @param query pattern
+         * @param chunk chunk index
+         * @param h     match handler
+         * @param misc  user data to be passed back to the handler
+         */
+        void search(int alg, const std::string& query, size_t chunk, 
+            match_handler* h, void* misc);
+        
+        /**
+         * Match handler collecting matches from a single chunk.
+         *
+         * @param seq    sequence no.
+         * @param offset match offset
+         * @param misc   pointer to a vector of (sequence, offset) pairs
+         */
+        static void collect_match(size_t seq, size_t offset, void* misc);
     
     public:
         /**
          * Create a new search engine for given reference sequence and ALZW 
-         * compressed file.
+         * compressed file. A dictionary snapshot is used if there is an 
+         * up-to-date one next to the ALZW file, otherwise the dictionary is 
+         * built by decoding the whole archive. Every chunk of an ALZW file 
+         * split into chunks has its own dictionary and chunks are searched 
+         * concurrently.
          *
          * @param rseq_file path to a file containing FASTA encoded reference
          * sequence
          * @param alzw_file path to an ALZW file archive
+         * @param threads   number of threads used for chunks
          */
-        search_engine(const char* rseq_file, const char* alzw_file);
+        search_engine(const char* rseq_file, const char* alzw_file, 
+            size_t threads = 1);
+        
+        virtual ~search_engine();
         
-        virtual ~search_engine() { }
+        /**
+         * Restrict all subsequent searches to given sequences. Sequences are 
+         * accessed directly if the ALZW file contains a seek index.
+         *
+         * @param seqs sorted list of one-based sequence numbers (empty list 
+         * means all sequences)
+         */
+        void select(const std::vector<size_t>& seqs) { selection = seqs; }
+        
+        /**
+         * Check if the ALZW file contains a seek index.
+         *
+         * @returns true if there is a seek index, false otherwise
+         */
+        bool has_index() const { return index != NULL; }
         
         /**
          * Search for a given pattern using a given pattern-matching algorithm.
@@ -331,13 +394,11 @@ namespace alzw {
      * Abstract stream search provider.
      */
     class stream_searcher {
-        typedef std::unordered_map<uint64_t, const node*> node_map;
-        
-        std::deque<uint8_t> phrase;
-        const decoder& dec;
+        std::vector<uint8_t> phrase;
+        const dictionary_snapshot& dict;
         
         /**
-         * Decode a given codeword and load the phrase into the internal stack.
+         * Decode a given codeword and load the phrase into the internal buffer.
          *
          * @param cw codeword
          */
@@ -368,10 +429,11 @@ namespace alzw {
         /**
          * Create a new stream search provider.
          *
-         * @param dec   decoder
+         * @param dict  dictionary snapshot
          * @param query pattern
          */
-        stream_searcher(const decoder& dec, const std::string& query);
+        stream_searcher(const dictionary_snapshot& dict, 
+            const std::string& query);
         
         virtual ~stream_searcher();
         
@@ -406,10 +468,11 @@ namespace alzw {
         /**
          * Create a new simple stream searcher for a given pattern.
          *
-         * @param dec   decoder
+         * @param dict  dictionary snapshot
          * @param query pattern
          */
-        simple_stream_searcher(const decoder& dec, const std::string& query);
+        simple_stream_searcher(const dictionary_snapshot& dict, 
+            const std::string& query);
         
         virtual ~simple_stream_searcher() { }
     };
@@ -427,10 +490,11 @@ namespace alzw {
         /**
          * Create a new BMH stream searcher for a given pattern.
          *
-         * @param dec   decoder
+         * @param dict  dictionary snapshot
          * @param query pattern
          */
-        bmh_stream_searcher(const decoder& dec, const std::string& query);
+        bmh_stream_searcher(const dictionary_snapshot& dict, 
+            const std::string& query);
         
         virtual ~bmh_stream_searcher() { }
     };
@@ -450,12 +514,12 @@ namespace alzw {
          * Create a new BMH stream searcher for a given pattern. (note: query 
          * and dfa must equal)
          *
-         * @param dec   decoder
+         * @param dict  dictionary snapshot
          * @param query pattern
          * @param dfa   DFA
          */
-        dfa_stream_searcher(const decoder& dec, const std::string& query, 
-            const df_automaton& dfa);
+        dfa_stream_searcher(const dictionary_snapshot& dict, 
+            const std::string& query, const df_automaton& dfa);
         
         virtual ~dfa_stream_searcher() { }
         
@@ -469,18 +533,64 @@ namespace alzw {
         const std::string& alzw_file;
         const std::string& rseq;
         
-        const dictionary& dict;
+        const dictionary_snapshot& dict;
+        archive_header hdr;
+        
+        const std::vector<size_t>* selection;
+        const seek_index* index;
+        
+        size_t first;
+        size_t last;
         
         int initial_pwidth;
         int pwidth;
         
+        // codeword reader for the coder of the searched stream
+        codeword_reader* cw_reader;
+        
+        /**
+         * Match handler for sequences that were not selected. It drops all 
+         * matches.
+         *
+         * @param seq    sequence no.
+         * @param offset match offset
+         * @param misc   nothing
+         */
+        static void drop_match(size_t seq, size_t offset, void* misc) { }
+        
         /**
-         * Skip file table in a given ALZW stream.
+         * Process a given number of sequences from a given ALZW stream.
          *
-         * @param in ALZW stream
-         * @returns number of encoded sequences
+         * @param in   ALZW stream
+         * @param seqc number of sequences
+         * @param h    match handler
+         * @param misc user data to be passed back to the handler
          */
-        size_t skip_file_table(breader& in);
+        void scan(breader& in, size_t seqc, 
+            search_engine::match_handler* h, void* misc);
+        
+        /**
+         * Process selected sequences by seeking directly to their beginning.
+         *
+         * @param in   ALZW stream
+         * @param seqc number of sequences in the stream
+         * @param h    match handler
+         * @param misc user data to be passed back to the handler
+         */
+        void search_indexed(breader& in, size_t seqc, 
+            search_engine::match_handler* h, void* misc);
+        
+        /**
+         * Process all sequences up to the last selected one and report only 
+         * matches from the selected sequences.
+         *
+         * @param in   ALZW stream
+         * @param seqc number of sequences in the stream
+         * @param h    match handler
+         * @param misc user data to be passed back to the handler
+         */
+        void search_filtered(breader& in, size_t seqc, 
+            search_engine::match_handler* h, void* misc);
         
         /**
          * Read insertion from a given ALZW stream.
@@ -522,13 +632,31 @@ namespace alzw {
          * Create a new search task.
          * 
          * @param alzw_file ALZW encoded file
-         * @param dec       decoder (must be already initialized and frozen)
+         * @param dict      dictionary snapshot
          * @param rseq      reference sequence
          */
-        search_task(const std::string& alzw_file, const decoder& dec, 
-            const std::string& rseq);
+        search_task(const std::string& alzw_file, 
+            const dictionary_snapshot& dict, const std::string& rseq);
         
-        virtual ~search_task() { }
+        virtual ~search_task();
+        
+        /**
+         * Restrict the search to given sequences.
+         *
+         * @param seqs  sorted list of one-based sequence numbers (may be NULL)
+         * @param index seek index (may be NULL)
+         */
+        void select(const std::vector<size_t>* seqs, const seek_index* index);
+        
+        /**
+         * Restrict the search to a given range of sequences (e.g. a single 
+         * chunk). A seek index is required unless the range starts with the 
+         * first sequence.
+         *
+         * @param first first sequence (zero-based, inclusive)
+         * @param last  last sequence (zero-based, exclusive)
+         */
+        void set_range(size_t first, size_t last);
         
         /**
          * Invoke task.
@@ -559,11 +687,11 @@ namespace alzw {
          * Create a new search task for given search provider and ALZW stream.
          *
          * @param alzw_file ALZW encoded file
-         * @param dec       decoder (must be already initialized and frozen)
+         * @param dict      dictionary snapshot
          * @param rseq      reference sequence
          * @param ss        search provider
          */
-        ss_task(const std::string& alzw_file, const decoder& dec, 
+        ss_task(const std::string& alzw_file, const dictionary_snapshot& dict, 
             const std::string& rseq, stream_searcher& ss);
         
         virtual ~ss_task() { }
@@ -574,7 +702,6 @@ namespace alzw {
      */
     class lm_task : public search_task {
         typedef std::unordered_map<uint64_t, const representative*> representative_map;
-        typedef std::unordered_map<uint64_t, const node*> node_map;
         
         /**
          * Match filter. Used to avoid multiple match handler invocations for 
@@ -589,13 +716,20 @@ namespace alzw {
                 ssize_t last_match);
         };
         
-        const decoder& dec;
+        const dictionary_snapshot& dict;
         
         df_automaton dfa;
         int state;
         
         representative_table* rtable;
-        representative_map rmap;
+        
+        // representatives of phrases indexed by their position in the 
+        // phrase table of the dictionary snapshot
+        const representative** rmap;
+        
+        // representatives of other codewords (used only by sequences encoded
+        // using a frozen dictionary)
+        representative_map omap;
         
         std::deque<uint8_t> suffix_stack;
         
@@ -622,13 +756,24 @@ namespace alzw {
          */
         const representative * get_representative(uint64_t cw);
         
+        /**
+         * Get cached representative of a given codeword.
+         *
+         * @param cw   codeword
+         * @param slot position of the codeword in the phrase table (see 
+         * dictionary_snapshot::phrase_slot())
+         * @returns representative or NULL if it is not cached
+         */
+        const representative * cached_representative(uint64_t cw, 
+            size_t slot) const;
+        
         /**
          * Get ALZW dictionary node with a given ID.
          *
          * @param id node ID
          * @returns node
          */
-        const node * get_node(uint64_t id);
+        const snapshot_node * get_node(uint64_t id);
         
         /**
          * Get length of the phrase represented by a given node.
@@ -661,11 +806,11 @@ namespace alzw {
          * Create a new search task for given query and ALZW stream.
          *
          * @param alzw_file ALZW encoded file
-         * @param dec       decoder (must be already initialized and frozen)
+         * @param dict      dictionary snapshot
          * @param rseq      reference sequence
          * @param query     pattern
          */
-        lm_task(const std::string& alzw_file, const decoder& dec, 
+        lm_task(const std::string& alzw_file, const dictionary_snapshot& dict, 
             const std::string& rseq, const std::string& query);
         
         virtual ~lm_task();
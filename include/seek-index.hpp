@@ -0,0 +1,197 @@
+/*
+Copyright (c) 2015 Perutka, Ondrej
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _SEEK_INDEX_HPP
+#define _SEEK_INDEX_HPP
+
+#include <vector>
+#include <stdint.h>
+
+#include "bit-io.hpp"
+
+/** @file */
+
+// seek index format version
+#define SEEK_INDEX_VERSION  3
+
+namespace alzw {
+    /**
+     * Seek point. It describes the decoder state at the beginning of a 
+     * sequence or right after a synchronization point.
+     */
+    struct seek_point {
+        uint64_t offset;    // bit offset within the ALZW stream
+        uint64_t next_id;   // next dictionary node ID
+        uint64_t roffset;   // reference sequence offset
+        uint64_t aoffset;   // offset within the decoded sequence
+        uint32_t seq;       // zero-based sequence index
+        uint8_t width;      // codeword width
+    };
+    
+    /**
+     * Seek index of an ALZW stream. The index is stored in an optional 
+     * footer placed after the ALZW bit stream. The footer is terminated by 
+     * a fixed-size trailer (footer offset and a magic string), so it can be 
+     * found without parsing the stream. Readers unaware of the index simply 
+     * stop reading after the last sequence.
+     */
+    class seek_index {
+        std::vector<seek_point> points;
+        std::vector<size_t> seq_starts;
+        std::vector<uint64_t> segments;
+        std::vector<uint32_t> budget_points;
+        bool sync_points;
+        
+    public:
+        /**
+         * Create a new empty seek index.
+         *
+         * @param sync_points if false, only seek points at the beginning of 
+         * sequences will be stored
+         */
+        seek_index(bool sync_points = true) : sync_points(sync_points) { }
+        
+        /**
+         * Add a new seek point. Seek points must be added in the stream 
+         * order.
+         *
+         * @param p seek point
+         */
+        void add(const seek_point& p);
+        
+        /**
+         * Check if synchronization points are stored.
+         *
+         * @returns false if only seek points at the beginning of sequences 
+         * are stored
+         */
+        bool has_sync_points() const { return sync_points; }
+        
+        /**
+         * Get number of seek points.
+         *
+         * @returns number of seek points
+         */
+        size_t size() const { return points.size(); }
+        
+        /**
+         * Get number of indexed sequences.
+         *
+         * @returns number of sequences
+         */
+        size_t sequences() const { return seq_starts.size(); }
+        
+        /**
+         * Get seek point with a given index.
+         *
+         * @param index seek point index
+         * @returns seek point
+         */
+        const seek_point& operator[](size_t index) const 
+            { return points[index]; }
+        
+        /**
+         * Add a segment appended to the ALZW stream. Segments must be added 
+         * in the stream order.
+         *
+         * @param offset bit offset of the segment header
+         */
+        void add_segment(uint64_t offset) { segments.push_back(offset); }
+        
+        /**
+         * Get bit offsets of headers of all appended segments.
+         *
+         * @returns segment offsets
+         */
+        const std::vector<uint64_t>& get_segments() const 
+            { return segments; }
+        
+        /**
+         * Add a sequence at which the dictionary budget was applied (i.e. the
+         * dictionary was frozen or reset). Sequences must be added in the 
+         * stream order.
+         *
+         * @param seq zero-based sequence index
+         */
+        void add_budget_point(uint32_t seq) { budget_points.push_back(seq); }
+        
+        /**
+         * Get sequences at which the dictionary budget was applied.
+         *
+         * @returns zero-based sequence indices
+         */
+        const std::vector<uint32_t>& get_budget_points() const 
+            { return budget_points; }
+        
+        /**
+         * Get seek point at the beginning of a given sequence.
+         *
+         * @param seq zero-based sequence index
+         * @returns seek point or NULL if there is no such sequence
+         */
+        const seek_point * sequence_start(size_t seq) const;
+        
+        /**
+         * Find the last seek point of a given sequence with reference offset 
+         * lower than or equal to a given reference offset.
+         *
+         * @param seq     zero-based sequence index
+         * @param roffset reference sequence offset
+         * @returns seek point or NULL if there is no such sequence
+         */
+        const seek_point * find(size_t seq, uint64_t roffset) const;
+        
+        /**
+         * Find the last seek point between two given seek points (inclusive) 
+         * with a given next node ID. A decoder with a dictionary containing 
+         * exactly next_id nodes at the first seek point can jump directly to 
+         * the returned seek point because no dictionary node was created in 
+         * between.
+         *
+         * @param from    the first seek point
+         * @param to      the last seek point
+         * @param next_id next dictionary node ID
+         * @returns seek point or NULL if even the first point does not match
+         */
+        const seek_point * find_reachable(const seek_point* from, 
+            const seek_point* to, uint64_t next_id) const;
+        
+        /**
+         * Write the index footer into a given output. The output will be 
+         * flushed (aligned to whole bytes) before writing the footer and 
+         * after writing it.
+         *
+         * @param out output
+         */
+        void write(bwriter& out) const;
+        
+        /**
+         * Load seek index from a given ALZW file.
+         *
+         * @param alzw_file path to an ALZW file
+         * @returns seek index or NULL if the file does not contain any
+         */
+        static seek_index * load(const char* alzw_file);
+    };
+}
+
+#endif /* _SEEK_INDEX_HPP */
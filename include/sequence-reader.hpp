@@ -0,0 +1,222 @@
+/*
+Copyright (c) 2015 Perutka, Ondrej
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _SEQUENCE_READER_HPP
+#define _SEQUENCE_READER_HPP
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "archive.hpp"
+#include "bit-io.hpp"
+#include "decoder.hpp"
+#include "seek-index.hpp"
+#include "symbol-sink.hpp"
+
+/** @file */
+
+// symbol encodings of decoded sequences
+#define SYMBOLS_ASCII   0   // a single ASCII character per symbol
+#define SYMBOLS_4BIT    1   // two base codes per byte (see utils::char2base())
+#define SYMBOLS_2BIT    2   // four base codes per byte (N as A, see n_runs())
+
+namespace alzw {
+    /**
+     * Run of N symbols within a decoded sequence.
+     */
+    struct n_run {
+        uint64_t start;     // zero-based offset of the first N
+        uint64_t end;       // offset following the last N
+    };
+    
+    /**
+     * Library API for reading sequences from an ALZW archive. Sequences are 
+     * decoded directly into buffers provided by the caller, either as ASCII 
+     * symbols without line breaks or as packed base codes. Packed codes 
+     * are stored from the most significant bits of every byte. N symbols 
+     * have no 2-bit code, so they are packed as A and reported separately 
+     * as N runs.
+     * 
+     * A sequence can be decoded at once (see decode()) or it can be pulled 
+     * chunk by chunk (see open() and read()). In the latter case the 
+     * decoder runs only until the caller's buffer is full.
+     * 
+     * The dictionary used for a given sequence depends on all preceding 
+     * sequences of the same chunk, so it is best to read sequences in 
+     * ascending order. A seek index allows skipping the parts of the 
+     * archive which do not change the dictionary and jumping directly to 
+     * other chunks.
+     */
+    class sequence_reader : private symbol_sink {
+        const std::string& rseq;
+        
+        file_breader br;
+        archive_header hdr;
+        seek_index* index;
+        uint64_t data_start;
+        
+        decoder* dec;
+        size_t dec_chunk;
+        size_t next;
+        bool reading;
+        int format;
+        
+        // buffer passed to the current read() call
+        uint8_t* obuffer;
+        size_t ob_capacity;
+        size_t ob_size;
+        
+        // symbols which did not fit into the caller's buffer
+        std::vector<char> pending;
+        size_t p_offset;
+        
+        // N runs of the sequence being read and number of its symbols 
+        // returned by previous read() calls
+        std::vector<n_run> runs;
+        uint64_t delivered;
+        
+        /**
+         * Create a new decoder and move to the beginning of a given chunk.
+         *
+         * @param chunk chunk index
+         */
+        void restart(size_t chunk);
+        
+        /**
+         * Use the seek index to skip as much of the archive as possible on 
+         * the way to a given sequence.
+         *
+         * @param seq target sequence (zero-based)
+         */
+        void skip(size_t seq);
+        
+        /**
+         * Prepare the decoder for decoding of the next sequence (apply the 
+         * dictionary budget, start a new chunk, freeze the dictionary or 
+         * skip a segment header).
+         */
+        void enter_sequence();
+        
+        /**
+         * Decode a next codeword of the sequence being read.
+         *
+         * @param out output pointer (may be NULL)
+         */
+        void decode_codeword(symbol_sink* out);
+        
+        /**
+         * Store given symbols into the caller's buffer using the selected 
+         * encoding. The buffer must be large enough.
+         *
+         * @param s   symbols
+         * @param len number of symbols
+         */
+        void put(const char* s, size_t len);
+        
+        /**
+         * Add a given N symbol to the N runs of the current sequence.
+         *
+         * @param offset zero-based offset of the symbol within the sequence
+         */
+        void add_run(uint64_t offset);
+        
+        virtual void write(const char* s, size_t len);
+        
+    public:
+        /**
+         * Open a given ALZW archive.
+         *
+         * @param rseq      reference sequence (it must outlive the reader)
+         * @param alzw_file path to an ALZW archive
+         */
+        sequence_reader(const std::string& rseq, const char* alzw_file);
+        
+        virtual ~sequence_reader();
+        
+        /**
+         * Get header of the archive.
+         *
+         * @returns archive header
+         */
+        const archive_header & header() const { return hdr; }
+        
+        /**
+         * Get number of sequences. Appended segments are discovered while 
+         * reading if the archive has no seek index, so the number may grow.
+         *
+         * @returns number of sequences
+         */
+        size_t sequences() const { return hdr.sequences(); }
+        
+        /**
+         * Start reading of a given sequence. The rest of the sequence being 
+         * read (if any) is dropped.
+         *
+         * @param seq    zero-based sequence index
+         * @param format SYMBOLS_ASCII, SYMBOLS_4BIT or SYMBOLS_2BIT
+         */
+        void open(size_t seq, int format = SYMBOLS_ASCII);
+        
+        /**
+         * Read next symbols of the sequence started by open(). Every call 
+         * starts at a byte boundary of the buffer.
+         *
+         * @param buffer   output buffer
+         * @param capacity maximum number of symbols (see buffer_size())
+         * @returns number of symbols, 0 at the end of the sequence
+         */
+        size_t read(void* buffer, size_t capacity);
+        
+        /**
+         * Decode a given sequence into a given buffer.
+         *
+         * @param seq      zero-based sequence index
+         * @param buffer   output buffer
+         * @param capacity maximum number of symbols (see buffer_size())
+         * @param format   SYMBOLS_ASCII, SYMBOLS_4BIT or SYMBOLS_2BIT
+         * @returns number of symbols
+         */
+        size_t decode(size_t seq, void* buffer, size_t capacity, 
+            int format = SYMBOLS_ASCII);
+        
+        /**
+         * Get N runs among the symbols of the current sequence returned so 
+         * far (only in case of SYMBOLS_2BIT, the symbols are packed as A). 
+         * Adjacent runs are merged. The list is cleared by open().
+         *
+         * @returns N runs ordered by their offsets
+         */
+        const std::vector<n_run> & n_runs() const { return runs; }
+        
+        /**
+         * Get number of bytes needed for a given number of symbols.
+         *
+         * @param symbols number of symbols
+         * @param format  SYMBOLS_ASCII, SYMBOLS_4BIT or SYMBOLS_2BIT
+         * @returns number of bytes
+         */
+        static size_t buffer_size(size_t symbols, int format);
+    };
+}
+
+#endif /* _SEQUENCE_READER_HPP */
@@ -0,0 +1,206 @@
+/*
+Copyright (c) 2015 Perutka, Ondrej
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _SLAB_ARENA_HPP
+#define _SLAB_ARENA_HPP
+
+#include <vector>
+#include <map>
+#include <mutex>
+#include <cstddef>
+#include <stdint.h>
+
+/** @file */
+
+// size of a single slab (it matches the size of a transparent huge page 
+// on x86-64)
+#define SLAB_SIZE           (1 << 21)
+
+// Define SLAB_HUGE_PAGES (e.g. using CFLAGS) in order to ask the kernel to 
+// back slabs with transparent huge pages.
+//#define SLAB_HUGE_PAGES
+
+namespace alzw {
+    /**
+     * Reserved range of virtual address space slabs can be carved from. 
+     * Objects within a region can be referenced by their offsets from the 
+     * region base, which allows compact (32-bit) object handles. The address 
+     * space is reserved at once and memory is committed only when slabs are 
+     * acquired. Released blocks are returned to the kernel and kept whole 
+     * (adjacent free blocks are merged), the smallest free block large 
+     * enough is reused by subsequent acquisitions. The first slab of a region is never used, so 
+     * offset zero can be used as a NULL handle. Regions are thread-safe.
+     */
+    class slab_region {
+        uint8_t* base;
+        size_t size;
+        size_t used;
+        std::map<uint8_t*, size_t> free_blocks;         // by address
+        std::multimap<size_t, uint8_t*> free_sizes;     // by size
+        std::mutex mutex;
+        
+        /**
+         * Remove a given free block from the free lists.
+         *
+         * @param it free block
+         */
+        void remove_free(std::map<uint8_t*, size_t>::iterator it);
+        
+    public:
+        /**
+         * Reserve a new region of a given size.
+         *
+         * @param size region size in bytes (multiple of SLAB_SIZE)
+         */
+        slab_region(size_t size);
+        
+        virtual ~slab_region();
+        
+        /**
+         * Acquire a block of slabs.
+         *
+         * @param size block size in bytes (multiple of SLAB_SIZE)
+         * @returns block
+         */
+        uint8_t * acquire(size_t size);
+        
+        /**
+         * Release a given block of slabs.
+         *
+         * @param block block acquired from this region
+         * @param size  block size in bytes
+         */
+        void release(uint8_t* block, size_t size);
+        
+        /**
+         * Get address of a given offset within this region.
+         *
+         * @param offset offset in bytes
+         * @returns address
+         */
+        uint8_t * address(uint64_t offset) const { return base + offset; }
+        
+        /**
+         * Get offset of a given address within this region.
+         *
+         * @param p address within this region
+         * @returns offset in bytes
+         */
+        uint64_t offset(const void* p) const { return (const uint8_t*)p - base; }
+    };
+    
+    /**
+     * Arena of fixed-size objects. Objects are carved from large anonymous 
+     * memory mappings (slabs), so there is no per-object allocator overhead 
+     * and all objects are released at once when the arena is destroyed. 
+     * Freed objects are kept in a free list and reused by subsequent 
+     * allocations. The arena does not call any constructors or destructors.
+     * Slabs are mapped directly or carved from a given slab region.
+     */
+    class slab_arena {
+        std::vector<uint8_t*> slabs;
+        slab_region* region;
+        size_t obj_size;
+        size_t per_slab;
+        size_t count;
+        uint8_t* next;
+        uint8_t* end;
+        void* free_list;
+        
+        /**
+         * Map a new slab.
+         */
+        void grow();
+        
+    public:
+        /**
+         * Create a new arena of objects of a given size. No memory is mapped 
+         * until the first allocation.
+         *
+         * @param obj_size object size in bytes
+         * @param region   region to carve slabs from or NULL
+         */
+        slab_arena(size_t obj_size, slab_region* region = NULL);
+        
+        virtual ~slab_arena();
+        
+        /**
+         * Allocate a single object.
+         *
+         * @returns pointer to uninitialized memory
+         */
+        void * alloc() {
+            void* result;
+            if (free_list) {
+                result = free_list;
+                free_list = *(void**)free_list;
+            } else {
+                if (next == end)
+                    grow();
+                result = next;
+                next += obj_size;
+                count++;
+            }
+            
+            return result;
+        }
+        
+        /**
+         * Return a given object into the arena.
+         *
+         * @param p object allocated using this arena
+         */
+        void free(void* p) {
+            *(void**)p = free_list;
+            free_list = p;
+        }
+        
+        /**
+         * Get number of objects carved from slabs so far (including objects 
+         * returned into the free list).
+         *
+         * @returns number of objects
+         */
+        size_t size() const { return count; }
+        
+        /**
+         * Get object with a given index. Objects are indexed in allocation 
+         * order, so it is meaningful only for arenas whose objects are never 
+         * freed.
+         *
+         * @param index zero-based object index (less than size())
+         * @returns object
+         */
+        void * get(size_t index) const {
+            return slabs[index / per_slab] + (index % per_slab) * obj_size;
+        }
+        
+        /**
+         * Get number of bytes mapped by this arena.
+         *
+         * @returns mapped memory
+         */
+        size_t mapped_memory() const { return slabs.size() * SLAB_SIZE; }
+    };
+}
+
+#endif /* _SLAB_ARENA_HPP */
@@ -0,0 +1,427 @@
+/*
+Copyright (c) 2015 Perutka, Ondrej
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _SNAPSHOT_HPP
+#define _SNAPSHOT_HPP
+
+#include <string>
+#include <stdint.h>
+
+#include "decoder.hpp"
+
+/** @file */
+
+// snapshot file format version
+#define SNAPSHOT_VERSION    3
+
+// parent index of nodes attached directly to the root node
+#define SNAPSHOT_ROOT       0xffffffff
+
+// flag stored along with the length of a collapsed sequence marking nodes 
+// which contain N symbols
+#define SNAPSHOT_N_RUNS     0x80000000
+
+// number of low codeword bits addressing a codeword within a page of the 
+// node and phrase indices (at most 8, offsets within a page are stored as 
+// bytes)
+#define SNAPSHOT_PAGE_BITS  8
+#define SNAPSHOT_PAGE_MASK  (((uint64_t)1 << SNAPSHOT_PAGE_BITS) - 1)
+
+// number of low node index bits addressing a node within a block of nodes 
+// sharing the same base ID
+#define SNAPSHOT_BLOCK_BITS 8
+
+namespace alzw {
+    // pre-declaration
+    class dictionary_snapshot;
+    
+    /**
+     * Node of a dictionary snapshot. Nodes are stored in a flat array sorted
+     * by their IDs and they reference each other using array indices, so the
+     * whole snapshot is position-independent. Node IDs are stored as offsets 
+     * from base IDs of node blocks and transition symbols are stored along 
+     * with the collapsed sequences, use dictionary_snapshot::id() and 
+     * dictionary_snapshot::symbol() to get them.
+     */
+    class snapshot_node {
+        uint32_t ido;       // node ID offset within a block of nodes
+        uint32_t par;       // parent node index or SNAPSHOT_ROOT
+        uint32_t plen;      // phrase length
+        uint32_t len;       // collapsed sequence length and SNAPSHOT_N_RUNS
+        
+        friend class dictionary_snapshot;
+        
+    public:
+        /**
+         * Get phrase length (number of symbols between the root and the end of
+         * this node).
+         *
+         * @returns phrase length
+         */
+        uint32_t phrase_length() const { return plen; }
+        
+        /**
+         * Get length of the collapse sequence.
+         *
+         * @returns length of the collapse sequence
+         */
+        uint32_t length() const { return len & ~SNAPSHOT_N_RUNS; }
+    };
+    
+    /**
+     * Read-only snapshot of a frozen ALZW dictionary. The snapshot can be
+     * either built in memory from a frozen decoder or mapped from a file
+     * created using the save() method. The file is mapped read-only, so it
+     * can be shared by several processes.
+     *
+     * Symbols of all nodes are stored in a single array indexed by codewords
+     * using two bits per symbol (the symbol of codeword X is the symbol of 
+     * the transition leading to X), N symbols are stored as runs of 
+     * codewords. Nodes and phrases (codewords emitted while the dictionary 
+     * was growing) are indexed by pages of codewords, each page stores index
+     * of the first node/phrase within the page and phrases store only their 
+     * offsets within a page.
+     */
+    class dictionary_snapshot {
+    public:
+        /**
+         * Identification of an ALZW archive and a reference sequence a 
+         * snapshot belongs to.
+         */
+        struct origin {
+            uint64_t archive_size;
+            uint64_t archive_hash;
+            uint64_t rseq_length;
+            uint64_t rseq_hash;
+            
+            /**
+             * Identify a given ALZW archive and reference sequence. The whole
+             * archive and the whole reference sequence are hashed, so the 
+             * origin should be computed only once for all chunks.
+             *
+             * @param alzw_file path to an ALZW archive
+             * @param rseq      reference sequence
+             */
+            origin(const char* alzw_file, const std::string& rseq);
+        };
+        
+    private:
+        /**
+         * Snapshot file header.
+         */
+        struct header {
+            char magic[8];
+            uint32_t version;
+            uint32_t byte_order;
+            uint64_t archive_size;
+            uint64_t archive_hash;
+            uint64_t rseq_length;
+            uint64_t rseq_hash;
+            uint64_t used_nodes;
+            uint64_t inode;
+            uint64_t dnode;
+            uint64_t wnode;
+            uint64_t node_count;
+            uint64_t phrase_count;
+            uint64_t run_count;
+            uint64_t page_count;
+            uint64_t nodes_offset;
+            uint64_t blocks_offset;
+            uint64_t node_pages_offset;
+            uint64_t phrase_pages_offset;
+            uint64_t phrases_offset;
+            uint64_t runs_offset;
+            uint64_t symbols_offset;
+            uint64_t size;
+        };
+        
+        /**
+         * Run of N symbols (codewords from start to end - 1).
+         */
+        struct run {
+            uint64_t start;
+            uint64_t end;
+        };
+        
+        uint8_t* image;
+        size_t image_size;
+        bool mapped;
+        
+        const header* hdr;
+        const snapshot_node* nodes;
+        const uint64_t* blocks;         // base IDs of node blocks
+        const uint32_t* node_pages;     // index of the first node of a page
+        const uint32_t* phrase_pages;   // index of the first phrase of a page
+        const uint8_t* phrases;         // phrase offsets within their pages
+        const run* runs;
+        const uint8_t* symbols;         // packed symbols of all codewords
+        
+        /**
+         * Set section pointers according to the image header and validate
+         * the header.
+         */
+        void init();
+        
+        /**
+         * Build snapshot image from a given frozen decoder.
+         *
+         * @param dec decoder
+         * @param o   origin of the decoded ALZW archive
+         */
+        void build(const decoder& dec, const origin& o);
+        
+        /**
+         * Find the first run of N symbols ending after a given codeword.
+         *
+         * @param cw codeword
+         * @returns run index or the number of runs if there is no such run
+         */
+        size_t find_run(uint64_t cw) const;
+        
+        /**
+         * Check if a given codeword belongs to a run of N symbols.
+         *
+         * @param cw codeword
+         * @returns true if the symbol of the codeword is N
+         */
+        bool in_run(uint64_t cw) const;
+        
+    public:
+        /**
+         * Create a new in-memory snapshot of a given frozen decoder.
+         *
+         * @param dec decoder (must be frozen)
+         * @param o   origin of the decoded ALZW archive
+         */
+        dictionary_snapshot(const decoder& dec, const origin& o);
+        
+        /**
+         * Map a given snapshot file into memory (read-only).
+         *
+         * @param file path to a snapshot file
+         */
+        dictionary_snapshot(const char* file);
+        
+        virtual ~dictionary_snapshot();
+        
+        /**
+         * Decode a given ALZW archive and create a snapshot of its dictionary.
+         * Every chunk of an archive split into chunks has its own dictionary.
+         *
+         * @param rseq      reference sequence
+         * @param alzw_file path to an ALZW archive
+         * @param chunk     chunk index
+         * @returns snapshot
+         */
+        static dictionary_snapshot * create(const std::string& rseq,
+            const char* alzw_file, size_t chunk = 0);
+        
+        /**
+         * Decode a given ALZW archive and create a snapshot of its dictionary.
+         * Every chunk of an archive split into chunks has its own dictionary.
+         *
+         * @param rseq      reference sequence
+         * @param alzw_file path to an ALZW archive
+         * @param chunk     chunk index
+         * @param o         origin of the ALZW archive
+         * @returns snapshot
+         */
+        static dictionary_snapshot * create(const std::string& rseq,
+            const char* alzw_file, size_t chunk, const origin& o);
+        
+        /**
+         * Get path of the snapshot file for a given ALZW archive.
+         *
+         * @param alzw_file path to an ALZW archive
+         * @param chunk     chunk index
+         * @returns path to the snapshot file
+         */
+        static std::string snapshot_file(const char* alzw_file, 
+            size_t chunk = 0);
+        
+        /**
+         * Save the snapshot into a given file. The snapshot is written into
+         * FILE.tmp which is renamed to the given file only once it is 
+         * complete, so processes which have the old snapshot mapped are not
+         * affected and the old snapshot is left intact if anything fails.
+         *
+         * @param file path to a file
+         */
+        void save(const char* file) const;
+        
+        /**
+         * Check if this snapshot belongs to a given archive and reference
+         * sequence.
+         *
+         * @param o origin of an ALZW archive
+         * @returns true if the snapshot matches, false otherwise
+         */
+        bool matches(const origin& o) const;
+        
+        /**
+         * Get position of a given codeword in the phrase table. The phrase 
+         * table contains codewords emitted while the dictionary was growing 
+         * and it is sorted by codewords.
+         *
+         * @param cw codeword
+         * @returns index of the first phrase table entry with codeword 
+         * greater than or equal to the given codeword
+         */
+        size_t phrase_slot(uint64_t cw) const;
+        
+        /**
+         * Check if a given phrase table entry contains a given codeword.
+         *
+         * @param slot phrase table index
+         * @param cw   codeword
+         * @returns true if the entry contains the codeword, false otherwise
+         */
+        bool is_phrase(size_t slot, uint64_t cw) const {
+            uint64_t page = cw >> SNAPSHOT_PAGE_BITS;
+            return page < hdr->page_count
+                && slot >= phrase_pages[page] && slot < phrase_pages[page + 1]
+                && phrases[slot] == (cw & SNAPSHOT_PAGE_MASK);
+        }
+        
+        /**
+         * Get number of phrase table entries.
+         *
+         * @returns number of phrases
+         */
+        size_t phrase_count() const { return hdr->phrase_count; }
+        
+        /**
+         * Get node containing a given codeword.
+         *
+         * @param cw codeword
+         * @returns node containing the codeword or NULL if there is no such 
+         * node
+         */
+        const snapshot_node * get_node(uint64_t cw) const;
+        
+        /**
+         * Get ID (codeword) of a given node.
+         *
+         * @param n node
+         * @returns node ID
+         */
+        uint64_t id(const snapshot_node* n) const
+            { return blocks[(n - nodes) >> SNAPSHOT_BLOCK_BITS] + n->ido; }
+        
+        /**
+         * Get transition symbol for the parent --> node transition.
+         *
+         * @param n node
+         * @returns transition symbol
+         */
+        uint8_t symbol(const snapshot_node* n) const
+            { return get_symbol(n, id(n)); }
+        
+        /**
+         * Get parent of a given node.
+         *
+         * @param n node
+         * @returns parent node or NULL if the parent is the root node
+         */
+        const snapshot_node * parent(const snapshot_node* n) const
+            { return n->par == SNAPSHOT_ROOT ? NULL : nodes + n->par; }
+        
+        /**
+         * Get symbol of a given codeword, i.e. the transition symbol of 
+         * a given node if the codeword is the node ID or a symbol from its 
+         * collapsed sequence otherwise.
+         *
+         * @param n  node containing the codeword
+         * @param cw codeword
+         * @returns symbol
+         */
+        uint8_t get_symbol(const snapshot_node* n, uint64_t cw) const {
+            if ((n->len & SNAPSHOT_N_RUNS) && in_run(cw))
+                return NODE_N_SYMBOL;
+            
+            return (symbols[cw >> 2] >> ((cw & 3) << 1)) & 3;
+        }
+        
+        /**
+         * Get symbols of consecutive codewords of a given node (see 
+         * get_symbol()).
+         *
+         * @param n     node containing the codewords
+         * @param cw    the first codeword
+         * @param count number of codewords
+         * @param dst   output buffer
+         */
+        void get_symbols(const snapshot_node* n, uint64_t cw, uint32_t count, 
+            uint8_t* dst) const;
+        
+        /**
+         * Get ID of the insertion node.
+         *
+         * @returns insertion node ID
+         */
+        uint64_t inode_id() const { return hdr->inode; }
+        
+        /**
+         * Get ID of the deletion node.
+         *
+         * @returns deletion node ID
+         */
+        uint64_t dnode_id() const { return hdr->dnode; }
+        
+        /**
+         * Get ID of the width-increment node.
+         *
+         * @returns width-increment node ID
+         */
+        uint64_t wnode_id() const { return hdr->wnode; }
+        
+        /**
+         * Get number of used virtual nodes (codewords).
+         *
+         * @returns number of codewords
+         */
+        size_t used_nodes() const { return hdr->used_nodes; }
+        
+        /**
+         * Get number of real nodes.
+         *
+         * @returns number of real nodes.
+         */
+        size_t real_nodes() const { return hdr->node_count; }
+        
+        /**
+         * Get size of the snapshot image in bytes.
+         *
+         * @returns image size
+         */
+        size_t size() const { return image_size; }
+        
+        /**
+         * Check if the snapshot is mapped from a file.
+         *
+         * @returns true if the snapshot is mapped from a file
+         */
+        bool is_mapped() const { return mapped; }
+    };
+}
+
+#endif /* _SNAPSHOT_HPP */
@@ -0,0 +1,72 @@
+/*
+Copyright (c) 2015 Perutka, Ondrej
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _SYMBOL_SINK_HPP
+#define _SYMBOL_SINK_HPP
+
+#include <ostream>
+
+#include "exception.hpp"
+
+/** @file */
+
+namespace alzw {
+    /**
+     * Consumer of decoded sequence symbols.
+     */
+    class symbol_sink {
+    public:
+        virtual ~symbol_sink() { }
+        
+        /**
+         * Consume given symbols. The symbols are valid only during the call.
+         *
+         * @param s   symbols
+         * @param len number of symbols
+         */
+        virtual void write(const char* s, size_t len) = 0;
+    };
+    
+    /**
+     * Symbol sink writing symbols into an output stream.
+     */
+    class ostream_sink : public symbol_sink {
+        std::ostream& out;
+        
+    public:
+        /**
+         * Create a new sink for a given output stream.
+         *
+         * @param out output stream
+         */
+        ostream_sink(std::ostream& out) : out(out) { }
+        
+        virtual ~ostream_sink() { }
+        
+        virtual void write(const char* s, size_t len) {
+            if (out.write(s, len).fail())
+                throw io_exception("error while writing into a file");
+        }
+    };
+}
+
+#endif /* _SYMBOL_SINK_HPP */
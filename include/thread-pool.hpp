@@ -0,0 +1,93 @@
+/*
+Copyright (c) 2015 Perutka, Ondrej
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _THREAD_POOL_HPP
+#define _THREAD_POOL_HPP
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+/** @file */
+
+namespace alzw {
+    /**
+     * Simple fixed-size thread pool.
+     */
+    class thread_pool {
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()>> tasks;
+        
+        std::mutex mutex;
+        std::condition_variable task_cv;
+        std::condition_variable done_cv;
+        
+        size_t running;
+        bool stop;
+        
+        std::exception_ptr error;
+        
+        /**
+         * Worker thread loop.
+         */
+        void worker();
+        
+    public:
+        /**
+         * Create a new thread pool.
+         *
+         * @param threads number of worker threads
+         */
+        thread_pool(size_t threads);
+        
+        /**
+         * Wait for all submitted tasks and stop all worker threads.
+         */
+        virtual ~thread_pool();
+        
+        /**
+         * Submit a new task.
+         *
+         * @param task task
+         */
+        void submit(const std::function<void()>& task);
+        
+        /**
+         * Wait until all submitted tasks are finished. If any of the tasks 
+         * threw an exception, the first one will be rethrown.
+         */
+        void wait();
+        
+        /**
+         * Get number of worker threads.
+         *
+         * @returns number of worker threads
+         */
+        size_t size() const { return workers.size(); }
+    };
+}
+
+#endif /* _THREAD_POOL_HPP */
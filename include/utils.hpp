@@ -24,6 +24,7 @@ THE SOFTWARE.
 #define _UTILS_HPP
 
 #include <string>
+#include <vector>
 #include <cstdio>
 
 /** @file */
@@ -93,6 +94,19 @@ namespace alzw {
          */
         char base2char(uint8_t base);
         
+        /**
+         * Get length of the run of matching columns at the beginning of a 
+         * given pairwise alignment block, i.e. the number of leading 
+         * positions where both sequences contain the same symbol which is 
+         * not a gap. SIMD instructions are used if available.
+         *
+         * @param s1  first sequence
+         * @param s2  second sequence
+         * @param len block length
+         * @returns run length
+         */
+        size_t match_run(const char* s1, const char* s2, size_t len);
+        
         /**
          * Get bit-width of a given number.
          *
@@ -102,11 +116,60 @@ namespace alzw {
         int number_width(uint64_t n);
         
         /**
-         * Get current timestamp.
+         * Get size of a given file.
          *
-         * @returns timestamp in seconds
+         * @param file path to a file
+         * @returns file size in bytes
+         */
+        size_t file_size(const char* file);
+        
+        /**
+         * Compute FNV-1a checksum of the whole content of a given file.
+         *
+         * @param file path to a file
+         * @returns checksum
+         */
+        uint64_t file_checksum(const char* file);
+        
+        /**
+         * Compute FNV-1a checksum of given data.
+         *
+         * @param data data
+         * @param len  data length in bytes
+         * @returns checksum
+         */
+        uint64_t checksum(const void* data, size_t len);
+        
+        /**
+         * Parse a given list of one-based sequence numbers. The list is a 
+         * comma-separated list of numbers and ranges (e.g. "1,4,7-9").
+         *
+         * @param list list
+         * @returns sorted list of unique sequence numbers
+         */
+        std::vector<size_t> parse_seq_list(const char* list);
+        
+        /**
+         * Get CPU time consumed by the process.
+         *
+         * @returns CPU time in seconds
          */
         double time();
+        
+        /**
+         * Get CPU time consumed by the calling thread.
+         *
+         * @returns CPU time in seconds (process CPU time if the thread CPU 
+         * time is not available)
+         */
+        double thread_time();
+        
+        /**
+         * Get current wall-clock timestamp (from a monotonic clock).
+         *
+         * @returns timestamp in seconds
+         */
+        double wall_time();
     }
 }
 
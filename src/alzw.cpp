@@ -22,21 +22,42 @@ THE SOFTWARE.
 
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <cstring>
 #include <cstdio>
 #include <cmath>
 #include <stdint.h>
 #include <fstream>
 #include <iostream>
+#include <thread>
+#include <mutex>
+#include <exception>
+#include <memory>
+#include <unistd.h>
 
 #include "fasta-alignment.hpp"
+#include "fasta-writer.hpp"
 #include "encoder.hpp"
 #include "decoder.hpp"
+#include "seek-index.hpp"
+#include "archive.hpp"
+#include "snapshot.hpp"
+#include "thread-pool.hpp"
+#include "bounded-queue.hpp"
 #include "utils.hpp"
 #include "exception.hpp"
 
 using namespace alzw;
 
+// number of alignment columns read at once
+#define BLOCK_SIZE      65536
+
+// maximum number of column blocks parsed ahead of the encoder
+#define PIPELINE_DEPTH  16
+
+// magic string of synchronization map cache files
+#define SYNC_MAP_MAGIC  "ALZWSMAP"
+
 /**
  * Print encoding stats.
  *
@@ -92,39 +113,214 @@ static void print_stats(const encoder& enc, size_t totalASeqLen) {
 }
 
 /**
- * Get length of a given sequence.
+ * Compression metrics of a single alignment.
+ */
+struct sequence_metrics {
+    double wall_time;
+    double cpu_time;
+    uint64_t bytes_in;
+    uint64_t bits_out;
+    size_t length;
+    size_t mmbits;
+    size_t ibits;
+    size_t dbits;
+    
+    // dictionary state after the alignment
+    size_t used_nodes;
+    size_t real_nodes;
+    size_t used_memory;
+    int width;
+    
+    /**
+     * Start measuring encoding of a given alignment.
+     *
+     * @param seq_file pairwise alignment in FASTA format
+     * @param stats    current stats of the encoder
+     * @param offset   current output offset in bits
+     */
+    void start(const char* seq_file, const encoder_stats& stats, 
+        uint64_t offset) {
+        wall_time = utils::wall_time();
+        cpu_time  = utils::thread_time();
+        bytes_in  = utils::file_size(seq_file);
+        bits_out  = offset;
+        mmbits    = stats.nmmbits;
+        ibits     = stats.nibits;
+        dbits     = stats.ndbits;
+        length    = 0;
+    }
+    
+    /**
+     * Finish measuring encoding of the current alignment. CPU time is 
+     * measured only for the calling thread.
+     *
+     * @param stats  current stats of the encoder
+     * @param offset current output offset in bits
+     */
+    void finish(const encoder_stats& stats, uint64_t offset) {
+        wall_time = utils::wall_time() - wall_time;
+        cpu_time  = utils::thread_time() - cpu_time;
+        bits_out  = offset - bits_out;
+        mmbits    = stats.nmmbits - mmbits;
+        ibits     = stats.nibits - ibits;
+        dbits     = stats.ndbits - dbits;
+    }
+    
+    /**
+     * Record the dictionary state of a given encoder.
+     *
+     * @param enc encoder
+     */
+    void set_dictionary(const encoder& enc) {
+        used_nodes  = enc.used_nodes();
+        real_nodes  = enc.real_nodes();
+        used_memory = enc.used_memory();
+        width       = enc.get_width();
+    }
+};
+
+/**
+ * Open a given file for per-alignment metrics.
+ *
+ * @param file path to the file (may be NULL)
+ * @returns file stream or NULL if no file was given
+ */
+static FILE* open_metrics(const char* file) {
+    if (!file)
+        return NULL;
+    
+    FILE* f = fopen(file, "w");
+    if (!f)
+        throw io_exception("unable to open metrics file: %s", file);
+    
+    return f;
+}
+
+/**
+ * Close a given file with per-alignment metrics.
  *
- * @param seq sequence
- * @returns sequence length
+ * @param f file stream (may be NULL)
  */
-static size_t get_seq_len(const std::string& seq) {
-    size_t len = 0;
+static void close_metrics(FILE* f) {
+    if (f && fclose(f))
+        throw io_exception("error while writing metrics");
+}
+
+/**
+ * Write metrics of a given alignment as a single line JSON object.
+ *
+ * @param out      output stream (nothing is written if it is NULL)
+ * @param seq      zero-based alignment index
+ * @param seq_file pairwise alignment in FASTA format
+ * @param m        metrics
+ */
+static void write_metrics(FILE* out, size_t seq, const char* seq_file, 
+    const sequence_metrics& m) {
+    if (!out)
+        return;
     
-    for (size_t i = 0; i < seq.length(); i++) {
-        if (seq[i] != '-')
-            len++;
+    std::string name;
+    char buffer[8];
+    
+    for (const char* c = seq_file; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            name += '\\';
+            name += *c;
+        } else if ((unsigned char)*c < 0x20) {
+            snprintf(buffer, sizeof(buffer), "\\u%04x", (unsigned)*c);
+            name += buffer;
+        } else
+            name += *c;
     }
     
-    return len;
+    fprintf(out, "{\"seq\": %lu, \"file\": \"%s\", "
+        "\"wall_time\": %.6f, \"cpu_time\": %.6f, "
+        "\"bytes_in\": %lu, \"bytes_out\": %lu, \"length\": %lu, "
+        "\"mr_bits\": %lu, \"ins_bits\": %lu, \"del_bits\": %lu, "
+        "\"used_nodes\": %lu, \"real_nodes\": %lu, \"used_memory\": %lu, "
+        "\"width\": %d}\n", 
+        (unsigned long)seq + 1, name.c_str(), 
+        m.wall_time, m.cpu_time, 
+        (unsigned long)m.bytes_in, (unsigned long)(m.bits_out + 7) >> 3, 
+        (unsigned long)m.length, 
+        (unsigned long)m.mmbits, (unsigned long)m.ibits, 
+        (unsigned long)m.dbits, 
+        (unsigned long)m.used_nodes, (unsigned long)m.real_nodes, 
+        (unsigned long)m.used_memory, m.width);
+    
+    if (ferror(out))
+        throw io_exception("error while writing metrics");
 }
 
 /**
- * Encode a given pairwise alignment.
+ * Encode a given pairwise alignment. The alignment is streamed into the 
+ * encoder in blocks of columns.
  *
  * @param enc      encoder
  * @param bw       output
- * @param a        alignment
+ * @param seq_file pairwise alignment in FASTA format
  * @param sync_map synchronization map for adaptive synchronization (may be 
  * NULL)
+ * @param metrics  output for metrics of the alignment (may be NULL)
+ * @returns length of the encoded sequence
  */
-static size_t compress(encoder& enc, bwriter& bw, const alignment& a,
-    std::vector<uint32_t>* sync_map) {
-    const std::string& seq1 = a[0];
-    const std::string& seq2 = a[1];
+static size_t compress(encoder& enc, bwriter& bw, const char* seq_file,
+    std::vector<uint32_t>* sync_map, sequence_metrics* metrics = NULL) {
+    if (metrics)
+        metrics->start(seq_file, enc.get_stats(), bw.tell());
     
-    enc.encode(seq1, seq2, bw, sync_map);
+    fasta_alignment_reader reader(seq_file);
+    std::vector<char> rblock(BLOCK_SIZE);
+    std::vector<char> ablock(BLOCK_SIZE);
+    size_t aseq_len = 0;
+    size_t len;
     
-    return get_seq_len(seq2);
+    enc.begin_sequence(bw, sync_map);
+    
+    while ((len = reader.read(rblock.data(), ablock.data(), BLOCK_SIZE)) > 0) {
+        enc.encode_block(rblock.data(), ablock.data(), len, bw);
+        aseq_len += len - std::count(ablock.begin(), ablock.begin() + len, '-');
+    }
+    
+    enc.end_sequence(bw);
+    
+    if (metrics) {
+        metrics->finish(enc.get_stats(), bw.tell());
+        metrics->set_dictionary(enc);
+        metrics->length = aseq_len;
+    }
+    
+    return aseq_len;
+}
+
+/**
+ * Apply the dictionary budget before encoding a given alignment. The 
+ * dictionary is reset (and a new chunk starting at a byte boundary is 
+ * started) or frozen if it exceeds the budget.
+ *
+ * @param enc    encoder
+ * @param bw     output
+ * @param hdr    archive header
+ * @param sindex seek index
+ * @param seq    zero-based index of the alignment
+ * @returns true if the alignment must be encoded using the frozen 
+ * dictionary
+ */
+static bool apply_budget(encoder& enc, bwriter& bw, archive_header& hdr, 
+    seek_index& sindex, size_t seq) {
+    uint8_t action = hdr.apply_budget(seq, enc.node_memory());
+    
+    if (action == BUDGET_RESET) {
+        fprintf(stderr, "dictionary budget exceeded, resetting the dictionary\n");
+        enc.reset_dictionary();
+        bw.align();
+    } else if (action == BUDGET_FREEZE)
+        fprintf(stderr, "dictionary budget exceeded, freezing the dictionary\n");
+    
+    if (action != BUDGET_NONE)
+        sindex.add_budget_point(seq);
+    
+    return hdr.is_frozen(seq);
 }
 
 /**
@@ -171,56 +367,345 @@ static size_t compress(encoder& enc, bwriter& bw, const alignment& a,
 }*/
 
 /**
- * Create cumulative change vector for given pairwise alignments.
+ * Block of alignment columns passed from the parser to the encoder.
+ */
+struct column_block {
+    std::vector<char> rblock;
+    std::vector<char> ablock;
+    size_t len;
+};
+
+/**
+ * Encode given pairwise alignments using a pipeline. The alignments are 
+ * parsed by a separate thread (which may run ahead of the encoder by a 
+ * limited number of column blocks) and the encoder output should be written 
+ * by an asynchronous bit-writer, so the encoder thread does nothing but 
+ * encoding.
  *
+ * The encoding stops before the first alignment which must be encoded using 
+ * a frozen dictionary because of the dictionary budget.
+ *
+ * @param enc       encoder
+ * @param bw        output
+ * @param hdr       archive header
+ * @param sindex    seek index
  * @param seq_files pairwise alignments in FASTA format
- * @param count     number of pairwise alignments
- * @returns change vector
- */
-static std::vector<bool> create_change_vector(
-    const char** seq_files, int count) {
-    std::vector<bool> changes;
-    
-    for (int i = 0; i < count; i++) {
-        fasta_alignment a = fasta_alignment::load(seq_files[i]);
-        if (!changes.size())
-            changes = std::vector<bool>(get_seq_len(a[0]) + 1, false);
-        const std::string& seq1 = a[0];
-        const std::string& seq2 = a[1];
-        size_t roffset = 0;
-        char c1, c2;
-        
-        // find all changes
-        for (size_t j = 0; j < seq1.length(); j++) {
-            c1 = seq1[j];
-            c2 = seq2[j];
+ * @param seq_count number of pairwise alignments
+ * @param sync_map  synchronization map for adaptive synchronization (may be 
+ * NULL)
+ * @param metrics   output for per-alignment metrics (may be NULL)
+ * @param encoded   number of encoded alignments (output)
+ * @returns sum of lengths of all encoded sequences
+ */
+static size_t compress_pipelined(encoder& enc, bwriter& bw, 
+    archive_header& hdr, seek_index& sindex, const char** seq_files, 
+    size_t seq_count, std::vector<uint32_t>* sync_map, FILE* metrics, 
+    size_t& encoded) {
+    bounded_queue<column_block> blocks(PIPELINE_DEPTH);
+    std::exception_ptr error;
+    
+    // every alignment is terminated by an empty block
+    std::thread parser([&] {
+        try {
+            for (size_t i = 0; i < seq_count; i++) {
+                fasta_alignment_reader reader(seq_files[i]);
+                size_t len;
+                
+                do {
+                    column_block b;
+                    b.rblock.resize(BLOCK_SIZE);
+                    b.ablock.resize(BLOCK_SIZE);
+                    b.len = len = reader.read(b.rblock.data(), 
+                        b.ablock.data(), BLOCK_SIZE);
+                    if (!blocks.push(std::move(b)))
+                        return;
+                } while (len > 0);
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        
+        blocks.close();
+    });
+    
+    size_t total_aseq_len = 0;
+    size_t seq = 0;
+    bool started = false;
+    sequence_metrics m = sequence_metrics();
+    column_block b;
+    
+    try {
+        while (blocks.pop(b)) {
+            if (!started) {
+                if (apply_budget(enc, bw, hdr, sindex, seq))
+                    break;
+                
+                fprintf(stderr, "%s\n", seq_files[seq]);
+                if (metrics)
+                    m.start(seq_files[seq], enc.get_stats(), bw.tell());
+                
+                enc.begin_sequence(bw, sync_map);
+                started = true;
+                seq++;
+            }
+            
+            if (b.len == 0) {
+                enc.end_sequence(bw);
+                started = false;
+                
+                if (metrics) {
+                    m.finish(enc.get_stats(), bw.tell());
+                    m.set_dictionary(enc);
+                    write_metrics(metrics, seq - 1, seq_files[seq - 1], m);
+                }
+                
+                continue;
+            }
+            
+            size_t len = b.len - std::count(b.ablock.begin(), 
+                b.ablock.begin() + b.len, '-');
+            
+            enc.encode_block(b.rblock.data(), b.ablock.data(), b.len, bw);
+            total_aseq_len += len;
+            m.length += len;
+        }
+    } catch (...) {
+        blocks.close();
+        parser.join();
+        throw;
+    }
+    
+    // the parser may be still running if the dictionary was frozen
+    blocks.close();
+    parser.join();
+    
+    if (error)
+        std::rethrow_exception(error);
+    
+    encoded = seq;
+    
+    return total_aseq_len;
+}
+
+/**
+ * Mark all reference positions changed by a given pairwise alignment in a 
+ * given change vector. The change vector is extended if necessary.
+ *
+ * @param seq_file pairwise alignment in FASTA format
+ * @param changes  change vector (bit set)
+ * @returns length of the reference sequence
+ */
+static size_t add_changes(const char* seq_file, std::vector<uint64_t>& changes) {
+    fasta_alignment_reader reader(seq_file);
+    std::vector<char> rblock(BLOCK_SIZE);
+    std::vector<char> ablock(BLOCK_SIZE);
+    size_t roffset = 0;
+    size_t len;
+    char c1, c2;
+    
+    // find all changes
+    while ((len = reader.read(rblock.data(), ablock.data(), BLOCK_SIZE)) > 0) {
+        if (changes.size() <= ((roffset + len) >> 6))
+            changes.resize(((roffset + len) >> 6) + 1, 0);
+        
+        for (size_t j = 0; j < len; j++) {
+            c1 = rblock[j];
+            c2 = ablock[j];
             if (c1 == '-' && roffset > 0)
-                changes[roffset - 1] = true;
+                changes[(roffset - 1) >> 6] |= (uint64_t)1 << ((roffset - 1) & 0x3f);
             else if (c1 != c2)
-                changes[roffset] = true;
+                changes[roffset >> 6] |= (uint64_t)1 << (roffset & 0x3f);
             if (c1 != '-')
                 roffset++;
         }
     }
     
+    return roffset;
+}
+
+/**
+ * Create cumulative change vector for given pairwise alignments. The 
+ * alignments are processed concurrently, every thread creates its own 
+ * change vector and the partial change vectors are merged using bitwise OR.
+ *
+ * @param seq_files pairwise alignments in FASTA format
+ * @param count     number of pairwise alignments
+ * @param threads   number of threads
+ * @param length    output for the number of positions in the change vector 
+ * (reference length + 1)
+ * @returns change vector (bit set)
+ */
+static std::vector<uint64_t> create_change_vector(
+    const char** seq_files, size_t count, size_t threads, size_t& length) {
+    std::vector<uint64_t> changes;
+    std::mutex mutex;
+    
+    threads = std::max((size_t)1, std::min(threads, count));
+    length  = 1;
+    
+    thread_pool pool(threads);
+    
+    for (size_t t = 0; t < threads; t++) {
+        pool.submit([&, t] {
+            std::vector<uint64_t> partial;
+            size_t rlen = 0;
+            
+            for (size_t i = t; i < count; i += threads)
+                rlen = std::max(rlen, add_changes(seq_files[i], partial));
+            
+            std::unique_lock<std::mutex> lock(mutex);
+            if (changes.size() < partial.size())
+                changes.resize(partial.size(), 0);
+            for (size_t i = 0; i < partial.size(); i++)
+                changes[i] |= partial[i];
+            
+            length = std::max(length, rlen + 1);
+        });
+    }
+    
+    pool.wait();
+    
     return changes;
 }
 
 /**
- * Create synchronization map for given pairwise alignments.
+ * Compute a key identifying a given set of pairwise alignments. The key is 
+ * used to validate cached synchronization maps.
  *
  * @param seq_files pairwise alignments in FASTA format
  * @param count     number of pairwise alignments
- * @param sync_map  output
+ * @param threads   number of threads
+ * @returns key
  */
-static void create_sync_map(const char** seq_files, int count, 
+static uint64_t sync_map_key(const char** seq_files, size_t count, 
+    size_t threads) {
+    std::vector<uint64_t> checksums(count);
+    thread_pool pool(threads);
+    uint64_t key = 0xcbf29ce484222325ULL;
+    
+    for (size_t i = 0; i < count; i++) {
+        pool.submit([&, i] {
+            checksums[i] = utils::file_checksum(seq_files[i]);
+        });
+    }
+    
+    pool.wait();
+    
+    for (size_t i = 0; i < count; i++)
+        key = (key ^ checksums[i]) * 0x100000001b3ULL;
+    
+    return key;
+}
+
+/**
+ * Load a cached synchronization map. The cache is only a hint, so a cache 
+ * file which cannot be read or which does not contain a plausible map is 
+ * treated as a missing one.
+ *
+ * @param cache_file path to a cache file
+ * @param key        expected key of the pairwise alignments
+ * @param columns    upper bound of the number of alignment columns
+ * @param sync_map   output
+ * @returns true if the cache file exists, matches the key and contains a 
+ * valid map, false otherwise
+ */
+static bool load_sync_map(const char* cache_file, uint64_t key, 
+    uint64_t columns, std::vector<uint32_t>& sync_map) {
+    char magic[sizeof(SYNC_MAP_MAGIC)];
+    uint64_t tmp, count, total = 0;
+    bool valid = false;
+    
+    FILE* fin = fopen(cache_file, "rb");
+    if (!fin)
+        return false;
+    
+    try {
+        stream_breader br(fin);
+        
+        for (size_t i = 0; i < sizeof(magic); i++) {
+            br.read(tmp, 8);
+            magic[i] = tmp;
+        }
+        
+        valid = !memcmp(magic, SYNC_MAP_MAGIC, sizeof(magic))
+            && br.read(tmp, 64) == 64 && tmp == key;
+        
+        // every period is at least one column long (a truncated file reads 
+        // as zeros)
+        if (valid && (valid = (count = br.read_delta() - 1) <= columns)) {
+            sync_map.resize(count);
+            for (size_t i = 0; valid && i < count; i++) {
+                tmp = br.read_delta() - 1;
+                total += tmp;
+                valid = tmp > 0 && tmp <= 0xffffffff && total <= columns;
+                sync_map[i] = tmp;
+            }
+        }
+    } catch (std::exception& ex) {
+        valid = false;
+    }
+    
+    fclose(fin);
+    
+    if (!valid)
+        sync_map.clear();
+    
+    return valid;
+}
+
+/**
+ * Save a given synchronization map into a cache file.
+ *
+ * @param cache_file path to a cache file
+ * @param key        key of the pairwise alignments
+ * @param sync_map   synchronization map
+ */
+static void save_sync_map(const char* cache_file, uint64_t key, 
+    const std::vector<uint32_t>& sync_map) {
+    file_bwriter bw(cache_file);
+    
+    bw.write_str(SYNC_MAP_MAGIC);
+    bw.write(key, 64);
+    
+    bw.write_delta(sync_map.size() + 1);
+    for (size_t i = 0; i < sync_map.size(); i++)
+        bw.write_delta(sync_map[i] + 1);
+}
+
+/**
+ * Create synchronization map for given pairwise alignments. The map does 
+ * not depend on the synchronization period, so it can be cached and reused 
+ * for the same set of alignments.
+ *
+ * @param seq_files  pairwise alignments in FASTA format
+ * @param count      number of pairwise alignments
+ * @param threads    number of threads
+ * @param cache_file path to a cache file (may be NULL)
+ * @param sync_map   output
+ */
+static void create_sync_map(const char** seq_files, size_t count, 
+    size_t threads, const char* cache_file, 
     std::vector<uint32_t>& sync_map) {
-    std::vector<bool> changes = create_change_vector(seq_files, count);
+    uint64_t key = 0;
+    
+    if (cache_file) {
+        // every alignment file contains at least all alignment columns
+        key = sync_map_key(seq_files, count, threads);
+        if (load_sync_map(cache_file, key, utils::file_size(seq_files[0]), 
+            sync_map)) {
+            fprintf(stderr, "using cached synchronization map: %s\n", cache_file);
+            return;
+        }
+    }
+    
+    size_t length;
+    std::vector<uint64_t> changes = create_change_vector(
+        seq_files, count, threads, length);
     bool sync_needed = false;
     uint32_t period = 0;
     
-    for (size_t i = 0; i < changes.size(); i++) {
-        if (changes[i])
+    for (size_t i = 0; i < length; i++) {
+        if ((changes[i >> 6] >> (i & 0x3f)) & 1)
             sync_needed = true;
         else if (sync_needed) {
             sync_map.push_back(period);
@@ -230,6 +715,186 @@ static void create_sync_map(const char** seq_files, int count,
         
         period++;
     }
+    
+    if (cache_file)
+        save_sync_map(cache_file, key, sync_map);
+}
+
+/**
+ * Encode given pairwise alignments using the frozen dictionary of a given 
+ * encoder. The alignments are encoded concurrently, every encoded sequence 
+ * starts at a byte boundary.
+ *
+ * @param enc       encoder (its dictionary will be shared)
+ * @param bw        output
+ * @param sindex    seek index
+ * @param seq_files pairwise alignments in FASTA format
+ * @param first     index of the first alignment to be encoded
+ * @param seq_count number of pairwise alignments
+ * @param threads   number of threads
+ * @param sync_map  synchronization map for adaptive synchronization (may be 
+ * NULL)
+ * @param metrics   output for per-alignment metrics (may be NULL)
+ * @returns sum of lengths of all encoded sequences
+ */
+static size_t compress_frozen(encoder& enc, bwriter& bw, seek_index& sindex, 
+    const char** seq_files, size_t first, size_t seq_count, size_t threads, 
+    std::vector<uint32_t>* sync_map, FILE* metrics) {
+    thread_pool pool(threads);
+    size_t batch = threads << 1;
+    size_t total_aseq_len = 0;
+    
+    // encode the alignments in batches in order to limit memory usage
+    for (size_t b = first; b < seq_count; b += batch) {
+        size_t n = std::min(batch, seq_count - b);
+        std::vector<memory_bwriter> outs(n);
+        std::vector<std::vector<seek_point>> points(n);
+        std::vector<encoder_stats> stats(n);
+        std::vector<sequence_metrics> seq_metrics(n);
+        std::vector<size_t> lengths(n);
+        
+        for (size_t i = 0; i < n; i++) {
+            pool.submit([&, i] {
+                if (metrics) {
+                    seq_metrics[i].start(seq_files[b + i], encoder_stats(), 
+                        0);
+                }
+                
+                fasta_alignment_reader reader(seq_files[b + i]);
+                std::vector<char> rblock(BLOCK_SIZE);
+                std::vector<char> ablock(BLOCK_SIZE);
+                frozen_encoder fenc(enc);
+                size_t len;
+                
+                lengths[i] = 0;
+                fenc.begin_sequence(outs[i], sync_map, b + i, &points[i]);
+                
+                while ((len = reader.read(rblock.data(), ablock.data(), BLOCK_SIZE)) > 0) {
+                    fenc.encode_block(rblock.data(), ablock.data(), len, outs[i]);
+                    lengths[i] += len - std::count(ablock.begin(), 
+                        ablock.begin() + len, '-');
+                }
+                
+                fenc.end_sequence(outs[i]);
+                stats[i] = fenc.get_stats();
+                
+                if (metrics) {
+                    seq_metrics[i].finish(stats[i], outs[i].tell());
+                    seq_metrics[i].length = lengths[i];
+                }
+            });
+        }
+        
+        pool.wait();
+        
+        for (size_t i = 0; i < n; i++) {
+            fprintf(stderr, "%s\n", seq_files[b + i]);
+            
+            bw.align();
+            uint64_t base = bw.tell();
+            outs[i].write_to(bw);
+            
+            for (size_t j = 0; j < points[i].size(); j++) {
+                points[i][j].offset += base;
+                sindex.add(points[i][j]);
+            }
+            
+            enc.add_stats(stats[i]);
+            total_aseq_len += lengths[i];
+            
+            if (metrics) {
+                seq_metrics[i].set_dictionary(enc);
+                write_metrics(metrics, b + i, seq_files[b + i], 
+                    seq_metrics[i]);
+            }
+        }
+    }
+    
+    return total_aseq_len;
+}
+
+/**
+ * Encode given pairwise alignments split into chunks. Every chunk is encoded 
+ * using its own encoder and chunks are encoded concurrently. Every chunk 
+ * starts at a byte boundary.
+ *
+ * @param enc       encoder (used only for collecting stats)
+ * @param bw        output
+ * @param sindex    seek index
+ * @param seq_files pairwise alignments in FASTA format
+ * @param seq_count number of pairwise alignments
+ * @param chunk     number of pairwise alignments in a chunk
+ * @param threads   number of threads
+ * @param sync_map  synchronization map for adaptive synchronization (may be 
+ * NULL)
+ * @param metrics   output for per-alignment metrics (may be NULL)
+ * @returns sum of lengths of all encoded sequences
+ */
+static size_t compress_chunks(encoder& enc, bwriter& bw, seek_index& sindex, 
+    const char** seq_files, size_t seq_count, size_t chunk, size_t threads, 
+    std::vector<uint32_t>* sync_map, FILE* metrics) {
+    thread_pool pool(threads);
+    size_t chunks = (seq_count + chunk - 1) / chunk;
+    size_t total_aseq_len = 0;
+    
+    // encode the chunks in batches in order to limit memory usage
+    for (size_t b = 0; b < chunks; b += threads) {
+        size_t n = std::min(threads, chunks - b);
+        std::vector<memory_bwriter> outs(n);
+        std::vector<seek_index> indices(n, seek_index(sindex.has_sync_points()));
+        std::vector<encoder_stats> stats(n);
+        std::vector<std::vector<sequence_metrics>> seq_metrics(n);
+        std::vector<size_t> lengths(n, 0);
+        
+        for (size_t i = 0; i < n; i++) {
+            pool.submit([&, i] {
+                size_t first = (b + i) * chunk;
+                size_t last  = std::min(first + chunk, seq_count);
+                encoder cenc(enc.get_sync_period());
+                
+                cenc.set_coder(enc.get_coder());
+                cenc.set_seek_index(&indices[i]);
+                
+                seq_metrics[i].resize(last - first);
+                
+                for (size_t j = first; j < last; j++) {
+                    lengths[i] += compress(cenc, outs[i], seq_files[j], 
+                        sync_map, metrics ? &seq_metrics[i][j - first] : NULL);
+                }
+                
+                stats[i] = cenc.get_stats();
+            });
+        }
+        
+        pool.wait();
+        
+        for (size_t i = 0; i < n; i++) {
+            size_t first = (b + i) * chunk;
+            size_t last  = std::min(first + chunk, seq_count);
+            
+            for (size_t j = first; j < last; j++) {
+                fprintf(stderr, "%s\n", seq_files[j]);
+                write_metrics(metrics, j, seq_files[j], 
+                    seq_metrics[i][j - first]);
+            }
+            
+            bw.align();
+            uint64_t base = bw.tell();
+            outs[i].write_to(bw);
+            
+            for (size_t j = 0; j < indices[i].size(); j++) {
+                seek_point p = indices[i][j];
+                p.offset += base;
+                p.seq    += first;
+                sindex.add(p);
+            }
+            
+            enc.add_stats(stats[i]);
+            total_aseq_len += lengths[i];
+        }
+    }
+    
+    return total_aseq_len;
 }
 
 /**
@@ -238,39 +903,357 @@ static void create_sync_map(const char** seq_files, int count,
  * @param sync_period synchronization period (or minimum phrase length in case 
  * of adaptive synchronizatioin)
  * @param async       use adaptive synchronization
+ * @param index       write seek index footer
+ * @param freeze      freeze the dictionary after encoding a given number of 
+ * alignments
+ * @param chunk       split the alignments into chunks of a given size (0 
+ * means no chunks)
+ * @param threads     number of threads used for encoding with the frozen 
+ * dictionary or for encoding chunks
+ * @param pipeline    parse the alignments and write the output on separate 
+ * threads
+ * @param sync_cache  synchronization map cache file used in case of adaptive
+ * synchronization (may be NULL)
+ * @param budget      dictionary budget in bytes (0 means no budget)
+ * @param policy      dictionary budget policy (BUDGET_FREEZE or 
+ * BUDGET_RESET)
+ * @param coder       codeword coder (CODER_FIXED or CODER_RANGE)
+ * @param stats_file  file for per-alignment metrics in JSON (may be NULL)
  * @param seq_files   pairwise alignments in FASTA format
  * @param seq_count   number of pairwise alignments
  */
-static void compress(int sync_period, bool async, 
+static void compress(int sync_period, bool async, bool index, size_t freeze, 
+    size_t chunk, size_t threads, bool pipeline, const char* sync_cache, 
+    uint64_t budget, uint8_t policy, uint8_t coder, const char* stats_file, 
     const char** seq_files, size_t seq_count) {
-    stream_bwriter bw(stdout);
+    FILE* metrics = open_metrics(stats_file);
+    
+    // the writer is released (and the writer thread stopped) also if the 
+    // compression fails
+    std::unique_ptr<bwriter> out;
+    if (pipeline)
+        out.reset(new async_bwriter(stdout));
+    else
+        out.reset(new stream_bwriter(stdout));
+    
+    bwriter& bw = *out;
     encoder enc(sync_period);
+    archive_header hdr;
     size_t total_aseq_len = 0;
-    //char buffer[4096];
+    
+    // range-coded sequences can be entered only at their beginning
+    seek_index sindex(index && coder == CODER_FIXED);
+    
+    // the seek index is always needed for sequences encoded using the frozen
+    // dictionary and for chunks (they can be decoded concurrently), it also 
+    // records where the dictionary budget was applied
+    bool frozen  = freeze < seq_count;
+    bool chunked = chunk > 0 && chunk < seq_count;
+    bool limited = budget > 0;
+    if (frozen && chunked)
+        throw runtime_exception("frozen dictionary cannot be combined with chunks");
+    if (limited && (frozen || chunked))
+        throw runtime_exception("dictionary budget cannot be combined with frozen dictionary or chunks");
+    if (index || frozen || limited)
+        enc.set_seek_index(&sindex);
     
     std::vector<uint32_t> sync_map;
     std::vector<uint32_t>* smap_p;
     if (async) {
-        create_sync_map(seq_files, seq_count, sync_map);
+        create_sync_map(seq_files, seq_count, threads, sync_cache, sync_map);
         smap_p = &sync_map;
     } else
         smap_p = NULL;
     
-    bw.write(seq_count, sizeof(int) << 3);
     for (size_t i = 0; i < seq_count; i++)
-        bw.write_str(seq_files[i]);
+        hdr.add_name(seq_files[i]);
+    if (frozen)
+        hdr.set_freeze_point(freeze);
+    if (chunked)
+        hdr.set_chunk_size(chunk);
+    if (limited)
+        hdr.set_budget(budget, policy);
+    
+    hdr.set_coder(coder);
+    enc.set_coder(coder);
+    
+    hdr.write(bw);
+    
+    if (chunked) {
+        total_aseq_len = compress_chunks(enc, bw, sindex, 
+            seq_files, seq_count, chunk, threads, smap_p, metrics);
+    }
+    
+    size_t i = 0;
+    
+    if (pipeline && !chunked) {
+        total_aseq_len += compress_pipelined(enc, bw, hdr, sindex, seq_files, 
+            std::min(freeze, seq_count), smap_p, metrics, i);
+    }
+    
+    for (; i < seq_count && i < freeze && !chunked && !pipeline; i++) {
+        if (apply_budget(enc, bw, hdr, sindex, i))
+            break;
+        
+        fprintf(stderr, "%s\n", seq_files[i]);
+        
+        sequence_metrics m;
+        total_aseq_len += compress(enc, bw, seq_files[i], smap_p, 
+            metrics ? &m : NULL);
+        write_metrics(metrics, i, seq_files[i], m);
+    }
+    
+    // the freeze point may be also set by the dictionary budget
+    if (hdr.freeze_point() < seq_count) {
+        total_aseq_len += compress_frozen(enc, bw, sindex, 
+            seq_files, hdr.freeze_point(), seq_count, threads, smap_p, 
+            metrics);
+    }
+    
+    if (index || frozen || chunked || limited)
+        sindex.write(bw);
+    
+    if (pipeline)
+        ((async_bwriter&)bw).close();
+    
+    out.reset();
+    
+    close_metrics(metrics);
+    
+    print_stats(enc, total_aseq_len);
+}
+
+/**
+ * Replace a given ALZW file with its first bytes followed by a new segment
+ * and a seek index footer. The result is written into ALZW.tmp which is 
+ * renamed to the ALZW file only once it is complete, so the original file 
+ * is left intact if anything fails.
+ *
+ * @param alzw_file ALZW file
+ * @param end       number of bytes of the ALZW file to keep (i.e. the end 
+ * of the ALZW stream without the old seek index footer)
+ * @param segment   encoded segment
+ * @param sindex    seek index of the whole stream
+ */
+static void write_appended(const char* alzw_file, uint64_t end, 
+    memory_bwriter& segment, seek_index& sindex) {
+    std::string tmp_file = std::string(alzw_file) + ".tmp";
+    char buffer[65536];
+    uint64_t left = end;
+    size_t len;
+    
+    FILE* fin = fopen(alzw_file, "rb");
+    if (!fin)
+        throw io_exception("unable to open ALZW file: %s", alzw_file);
+    
+    FILE* fout = fopen(tmp_file.c_str(), "wb");
+    if (!fout) {
+        fclose(fin);
+        throw io_exception("unable to open output file: %s", tmp_file.c_str());
+    }
+    
+    try {
+        while (left > 0) {
+            len = fread(buffer, 1, std::min(left, (uint64_t)sizeof(buffer)), fin);
+            if (len == 0 || fwrite(buffer, 1, len, fout) != len)
+                throw io_exception("unable to copy ALZW file: %s", alzw_file);
+            left -= len;
+        }
+        
+        stream_bwriter bw(fout, end);
+        segment.write_to(bw);
+        sindex.write(bw);
+        bw.flush();
+        
+        if (fflush(fout) || ferror(fout) || fsync(fileno(fout)))
+            throw io_exception("unable to write output file: %s", tmp_file.c_str());
+    } catch (...) {
+        fclose(fin);
+        fclose(fout);
+        remove(tmp_file.c_str());
+        throw;
+    }
+    
+    fclose(fin);
+    
+    if (fclose(fout) || rename(tmp_file.c_str(), alzw_file)) {
+        remove(tmp_file.c_str());
+        throw io_exception("unable to replace ALZW file: %s", alzw_file);
+    }
+}
+
+/**
+ * Append given pairwise alignments to an existing ALZW file. The dictionary 
+ * is restored by decoding the existing ALZW stream and the new alignments 
+ * are encoded as a new segment using the restored dictionary. The seek index
+ * footer is always (re)written because it contains offsets of all segments.
+ * The ALZW file is replaced atomically (see write_appended()).
+ *
+ * @param sync_period synchronization period (or minimum phrase length in case 
+ * of adaptive synchronizatioin)
+ * @param async       use adaptive synchronization
+ * @param index       add synchronization points into the seek index
+ * @param threads     number of threads used for creating the adaptive 
+ * synchronization map
+ * @param alzw_file   ALZW file
+ * @param stats_file  file for per-alignment metrics in JSON (may be NULL)
+ * @param seq_files   pairwise alignments in FASTA format
+ * @param seq_count   number of pairwise alignments
+ */
+static void append(int sync_period, bool async, bool index, size_t threads, 
+    const char* alzw_file, const char* stats_file, const char** seq_files, 
+    size_t seq_count) {
+    fasta_alignment_reader first(seq_files[0]);
+    std::vector<char> rblock(BLOCK_SIZE);
+    std::vector<char> ablock(BLOCK_SIZE);
+    std::string rseq;
+    size_t len;
+    
+    while ((len = first.read(rblock.data(), ablock.data(), BLOCK_SIZE)) > 0) {
+        for (size_t i = 0; i < len; i++) {
+            if (rblock[i] != '-')
+                rseq += rblock[i];
+        }
+    }
+    
+    seek_index* old_index = seek_index::load(alzw_file);
+    archive_header hdr;
+    size_t count;
+    uint64_t end;
+    int width;
+    
+    dictionary dict;
+    
+    try {
+        file_breader br(alzw_file);
+        hdr.read(br);
+        
+        if (hdr.get_names().empty())
+            throw runtime_exception("unable to append to an ALZW stream without sequence names");
+        if (hdr.freeze_point() < hdr.sequences() || hdr.chunks() > 1 
+            || hdr.has_budget())
+            throw runtime_exception("unable to append to an ALZW stream with frozen dictionary, chunks or dictionary budget");
+        
+        if (old_index) {
+            hdr.read_segments(br, *old_index);
+            if (old_index->sequences() != hdr.sequences())
+                throw runtime_exception("seek index does not match the ALZW stream");
+        } else
+            old_index = new seek_index(index && hdr.get_coder() == CODER_FIXED);
+        
+        count = hdr.sequences();
+        
+        // restore the dictionary (and the seek index if there is none)
+        decoder dec(rseq, dict);
+        dec.set_coder(hdr.get_coder());
+        bool new_index = old_index->sequences() != count;
+        
+        for (size_t i = 0; i < count; i++) {
+            if (hdr.is_segment_start(i))
+                hdr.skip_segment(br);
+            
+            if (new_index) {
+                seek_point p;
+                p.offset  = br.tell();
+                p.next_id = dec.next_id();
+                p.roffset = 0;
+                p.aoffset = 0;
+                p.seq     = i;
+                p.width   = dec.get_width();
+                old_index->add(p);
+            }
+            
+            dec.decode(br);
+        }
+        
+        end   = (br.tell() + 7) >> 3;
+        width = dec.get_width();
+    } catch (...) {
+        delete old_index;
+        throw;
+    }
+    
+    // keep synchronization points if the existing index contains them
+    seek_index sindex((index && hdr.get_coder() == CODER_FIXED) 
+        || old_index->size() > old_index->sequences());
+    
+    for (size_t i = 0; i < old_index->size(); i++)
+        sindex.add((*old_index)[i]);
+    for (size_t i = 0; i < old_index->get_segments().size(); i++)
+        sindex.add_segment(old_index->get_segments()[i]);
+    
+    delete old_index;
+    
+    // encode the new segment
+    encoder enc(sync_period, dict, width);
+    seek_index nindex(sindex.has_sync_points());
+    archive_header seg;
+    memory_bwriter mw;
+    size_t total_aseq_len = 0;
+    
+    enc.set_coder(hdr.get_coder());
+    enc.set_seek_index(&nindex);
+    
+    for (size_t i = 0; i < seq_count; i++)
+        seg.add_name(seq_files[i]);
+    
+    seg.write_segment(mw);
+    
+    std::vector<uint32_t> sync_map;
+    std::vector<uint32_t>* smap_p;
+    if (async) {
+        create_sync_map(seq_files, seq_count, threads, NULL, sync_map);
+        smap_p = &sync_map;
+    } else
+        smap_p = NULL;
+    
+    FILE* metrics = open_metrics(stats_file);
     
     for (size_t i = 0; i < seq_count; i++) {
         fprintf(stderr, "%s\n", seq_files[i]);
-        //snprintf(buffer, sizeof(buffer), "%s.fa.orig", seq_files[i]);
-        fasta_alignment fa = fasta_alignment::load(seq_files[i]);
-        //save_seq(buffer, fa[1]);
-        total_aseq_len += compress(enc, bw, fa, smap_p);
+        
+        sequence_metrics m;
+        total_aseq_len += compress(enc, mw, seq_files[i], smap_p, 
+            metrics ? &m : NULL);
+        write_metrics(metrics, count + i, seq_files[i], m);
+    }
+    
+    close_metrics(metrics);
+    
+    for (size_t i = 0; i < nindex.size(); i++) {
+        seek_point p = nindex[i];
+        p.offset += end << 3;
+        p.seq    += count;
+        sindex.add(p);
     }
     
+    sindex.add_segment(end << 3);
+    
+    write_appended(alzw_file, end, mw, sindex);
+    
     print_stats(enc, total_aseq_len);
 }
 
+/**
+ * Decode a single sequence from a given ALZW stream using a pipeline. Raw 
+ * symbols are produced by the decoder on the calling thread, they are 
+ * broken into lines and written into the output by two other threads.
+ *
+ * @param br     input
+ * @param dec    decoder
+ * @param stream output (positioned right after the sequence header)
+ */
+static void decode_pipelined(breader& br, decoder& dec, FILE* stream) {
+    async_fasta_writer writer(stream);
+    std::ostream out(&writer);
+    
+    dec.set_line_length(0);
+    dec.decode(br, out);
+    dec.set_line_length(FASTA_LINE_LENGTH);
+    
+    writer.close();
+}
+
 /**
  * Decode a single sequence from a given ALZW stream.
  *
@@ -278,11 +1261,31 @@ static void compress(int sync_period, bool async,
  * @param dec      decoder
  * @param seq_name name of the sequence
  * @param out_file path to an output file
+ * @param pipeline decode the sequence using a pipeline
  */
 static void decompress(breader& br, decoder& dec, 
-    const std::string& seq_name, const char* out_file) {
+    const std::string& seq_name, const char* out_file, bool pipeline) {
     fprintf(stderr, "%s\n", out_file);
     
+    if (pipeline) {
+        FILE* f = fopen(out_file, "w");
+        if (!f)
+            throw io_exception("unable to open output file: %s", out_file);
+        
+        try {
+            fprintf(f, ">%s\n", seq_name.c_str());
+            decode_pipelined(br, dec, f);
+        } catch (...) {
+            fclose(f);
+            throw;
+        }
+        
+        if (fclose(f))
+            throw io_exception("error while writing into a file");
+        
+        return;
+    }
+    
     std::ofstream fout(out_file);
     if (!fout)
         throw io_exception("unable to open output file: %s", out_file);
@@ -295,64 +1298,576 @@ static void decompress(breader& br, decoder& dec,
     fout.close();
 }
 
+/**
+ * Parse a given reference range.
+ *
+ * @param range range in format "start-end" (one-based, inclusive)
+ * @param start range start (zero-based, inclusive)
+ * @param end   range end (zero-based, exclusive)
+ */
+static void parse_range(const char* range, size_t& start, size_t& end) {
+    const char* p = range;
+    char* e;
+    
+    start = strtoul(p, &e, 10);
+    if (e == p || *e != '-')
+        throw parse_exception("invalid reference range: %s", range);
+    
+    p   = e + 1;
+    end = strtoul(p, &e, 10);
+    if (e == p || *e != 0 || start == 0 || start > end)
+        throw parse_exception("invalid reference range: %s", range);
+    
+    start--;
+}
+
+/**
+ * Parse a given size.
+ *
+ * @param size number of bytes optionally followed by a k, M or G suffix
+ * @returns number of bytes
+ */
+static uint64_t parse_size(const char* size) {
+    char* e;
+    
+    uint64_t result = strtoull(size, &e, 10);
+    if (e == size)
+        throw parse_exception("invalid size: %s", size);
+    
+    if (*e == 'k')
+        result <<= 10;
+    else if (*e == 'M')
+        result <<= 20;
+    else if (*e == 'G')
+        result <<= 30;
+    else if (*e != 0)
+        throw parse_exception("invalid size: %s", size);
+    
+    if (*e != 0 && e[1] != 0)
+        throw parse_exception("invalid size: %s", size);
+    
+    return result;
+}
+
+/**
+ * Parse a given dictionary budget policy.
+ *
+ * @param policy policy name ("reset" or "freeze")
+ * @returns BUDGET_RESET or BUDGET_FREEZE
+ */
+static uint8_t parse_policy(const char* policy) {
+    if (!strcmp("reset", policy))
+        return BUDGET_RESET;
+    else if (!strcmp("freeze", policy))
+        return BUDGET_FREEZE;
+    
+    throw parse_exception("unknown dictionary budget policy: %s", policy);
+}
+
+/**
+ * Parse a given codeword coder name.
+ *
+ * @param coder coder name ("fixed" or "range")
+ * @returns CODER_FIXED or CODER_RANGE
+ */
+static uint8_t parse_coder(const char* coder) {
+    if (!strcmp("fixed", coder))
+        return CODER_FIXED;
+    else if (!strcmp("range", coder))
+        return CODER_RANGE;
+    
+    throw parse_exception("unknown codeword coder: %s", coder);
+}
+
+/**
+ * Use a given seek index to skip as much of the ALZW stream as possible on 
+ * the way to a given position. It is possible to skip a part of the stream 
+ * only if there are no new dictionary nodes in that part.
+ *
+ * @param index   seek index
+ * @param dec     decoder
+ * @param br      input (positioned at the beginning of a given sequence)
+ * @param seq     current sequence (zero-based)
+ * @param tseq    target sequence (zero-based)
+ * @param roffset target reference offset
+ * @returns sequence the decoder will continue with
+ */
+static size_t skip(const seek_index& index, decoder& dec, breader& br, 
+    size_t seq, size_t tseq, size_t roffset) {
+    const seek_point* from = index.sequence_start(seq);
+    const seek_point* to   = index.find(tseq, roffset);
+    const seek_point* p;
+    
+    if (from->next_id != dec.next_id())
+        throw runtime_exception("seek index does not match the ALZW stream");
+    
+    p = index.find_reachable(from, to, dec.next_id());
+    if (p != from)
+        dec.seek(br, *p);
+    
+    return p->seq;
+}
+
+/**
+ * Decode a given sequence from a given ALZW stream into a file named after 
+ * the sequence (or into the standard output if the sequence has no name).
+ *
+ * @param br       input
+ * @param dec      decoder
+ * @param hdr      archive header
+ * @param seq      zero-based sequence index
+ * @param suffix   sequence name suffix
+ * @param pipeline decode the sequence using a pipeline
+ */
+static void decompress(breader& br, decoder& dec, const archive_header& hdr, 
+    size_t seq, const std::string& suffix, bool pipeline) {
+    if (hdr.get_names().empty() && pipeline) {
+        std::cout.flush();
+        decode_pipelined(br, dec, stdout);
+        return;
+    } else if (hdr.get_names().empty()) {
+        dec.decode(br, std::cout);
+        return;
+    }
+    
+    const std::string& name = hdr.get_names()[seq];
+    std::string out_file = name + ".fa";
+    
+    decompress(br, dec, name + suffix, out_file.c_str(), pipeline);
+}
+
+/**
+ * Sequence extraction parameters.
+ */
+struct extraction {
+    archive_header hdr;
+    seek_index* index;
+    size_t wstart;
+    size_t wend;
+    std::string suffix;
+    bool pipeline;
+};
+
+/**
+ * Prepare a given ALZW stream and decoder for decoding of a given sequence. 
+ * The dictionary budget is applied and the dictionary is frozen if the 
+ * sequence was encoded using the frozen dictionary. Header of an appended 
+ * segment is skipped if the sequence starts the segment. Segments are 
+ * discovered while reading if there is no seek index.
+ *
+ * @param br  input (positioned at the beginning of the sequence)
+ * @param dec decoder
+ * @param ext extraction parameters
+ * @param seq zero-based sequence index
+ */
+static void enter_sequence(breader& br, decoder& dec, extraction& ext, 
+    size_t seq) {
+    // all budget points are known if there is a seek index (chunks are then 
+    // decoded concurrently and they share the header), otherwise they are 
+    // recorded as they are found
+    uint8_t action = ext.index 
+        ? ext.hdr.budget_action(seq, dec.node_memory()) 
+        : ext.hdr.apply_budget(seq, dec.node_memory());
+    
+    // a reset dictionary starts a new chunk at a byte boundary
+    if (action == BUDGET_RESET) {
+        dec.reset_dictionary();
+        br.align();
+    }
+    
+    if (ext.hdr.is_frozen(seq))
+        dec.freeze_dictionary();
+    
+    if (ext.index) {
+        if (ext.hdr.is_segment_start(seq) 
+            && br.tell() < ext.index->sequence_start(seq)->offset)
+            ext.hdr.skip_segment(br);
+    } else if (seq >= ext.hdr.sequences() && !ext.hdr.read_segment(br))
+        throw runtime_exception("no such sequence: %lu", (unsigned long)seq + 1);
+}
+
+/**
+ * Decode selected sequences from a single chunk of a given ALZW stream. An 
+ * ALZW stream that is not split into chunks is considered to be a single 
+ * chunk. The input is left at the beginning of the next chunk unless this 
+ * is the last chunk to be decoded.
+ *
+ * @param br    input (positioned at the beginning of the chunk)
+ * @param dec   decoder (containing the initial dictionary of the chunk)
+ * @param ext   extraction parameters
+ * @param first first sequence of the chunk (zero-based)
+ * @param seqs  selected sequences (one-based, sorted, all from this chunk)
+ * @param count number of selected sequences
+ * @param last  true if nothing will be decoded after the selected sequences
+ * @returns sequence the decoder will continue with
+ */
+static size_t decompress_chunk(breader& br, decoder& dec, 
+    extraction& ext, size_t first, const size_t* seqs, size_t count, 
+    bool last) {
+    size_t i = first;
+    
+    // every chunk starts at a byte boundary
+    br.align();
+    
+    for (size_t j = 0; j < count; j++) {
+        size_t s = seqs[j] - 1;
+        
+        // skip all sequences before the selected one
+        while (true) {
+            if (ext.index)
+                i = skip(*ext.index, dec, br, i, s, ext.wstart);
+            
+            enter_sequence(br, dec, ext, i);
+            if (i == s)
+                break;
+            
+            dec.decode(br);
+            i++;
+        }
+        
+        // there is no need to decode anything beyond the last window
+        dec.set_window(ext.wstart, ext.wend, last && (j + 1) == count);
+        decompress(br, dec, ext.hdr, s, ext.suffix, ext.pipeline);
+        
+        i++;
+    }
+    
+    // the next chunk cannot be reached without reading the rest of this one
+    if (!last && !ext.index) {
+        size_t end = ext.hdr.chunk_end(ext.hdr.chunk_of(first));
+        for (; i < end; i++) {
+            enter_sequence(br, dec, ext, i);
+            dec.decode(br);
+        }
+    }
+    
+    return i;
+}
+
+/**
+ * Decode selected sequences from an ALZW stream split into chunks. Chunks 
+ * are decoded concurrently if the ALZW stream contains a seek index.
+ *
+ * @param rseq      reference sequence
+ * @param alzw_file ALZW file
+ * @param br        input (positioned right after the header)
+ * @param ext       extraction parameters
+ * @param seqs      selected sequences (one-based, sorted)
+ * @param threads   number of threads
+ */
+static void decompress_chunks(const std::string& rseq, const char* alzw_file, 
+    breader& br, extraction& ext, const std::vector<size_t>& seqs, 
+    size_t threads) {
+    thread_pool* pool = NULL;
+    size_t i = 0;
+    size_t j = 0;
+    
+    if (threads > 1 && ext.index)
+        pool = new thread_pool(threads);
+    
+    while (j < seqs.size()) {
+        size_t chunk = ext.hdr.chunk_of(seqs[j] - 1);
+        size_t first = ext.hdr.chunk_start(chunk);
+        size_t end   = ext.hdr.chunk_end(chunk);
+        size_t k = j;
+        
+        while (k < seqs.size() && (seqs[k] - 1) < end)
+            k++;
+        
+        const size_t* cseqs = seqs.data() + j;
+        size_t count = k - j;
+        bool last = k == seqs.size();
+        
+        if (pool) {
+            pool->submit([&, first, cseqs, count] {
+                file_breader sbr(alzw_file);
+                decoder sdec(rseq, false);
+                
+                sdec.set_coder(ext.hdr.get_coder());
+                sdec.seek(sbr, *ext.index->sequence_start(first));
+                decompress_chunk(sbr, sdec, ext, first, cseqs, count, true);
+            });
+        } else {
+            decoder dec(rseq, false);
+            
+            dec.set_coder(ext.hdr.get_coder());
+            
+            // all preceding chunks must be read if there is no seek index
+            if (ext.index)
+                dec.seek(br, *ext.index->sequence_start(first));
+            else {
+                while (i < first) {
+                    decoder sdec(rseq, false);
+                    sdec.set_coder(ext.hdr.get_coder());
+                    i = decompress_chunk(br, sdec, ext, i, NULL, 0, false);
+                }
+            }
+            
+            i = decompress_chunk(br, dec, ext, first, cseqs, count, last);
+        }
+        
+        j = k;
+    }
+    
+    if (pool) {
+        pool->wait();
+        delete pool;
+    }
+}
+
 /**
  * Decode a given ALZW stream.
  *
  * @param rseq_file reference sequence in FASTA format
  * @param alzw_file ALZW file
+ * @param seq_list  list of sequences to be decoded (one-based, e.g. "1,4-6";
+ * may be NULL)
+ * @param range     reference range to be decoded (one-based, e.g. 
+ * "1000-2000"; may be NULL)
+ * @param threads   number of threads used for decoding of sequences encoded 
+ * using a frozen dictionary or split into chunks
+ * @param pipeline  format and write the decoded sequences on separate threads
  */
-static void decompress(const char* rseq_file, const char* alzw_file) {
+static void decompress(const char* rseq_file, const char* alzw_file, 
+    const char* seq_list, const char* range, size_t threads, bool pipeline) {
     std::string rseq = utils::load_fasta(rseq_file);
-    std::vector<std::string> fnames;
+    std::vector<size_t> seqs;
+    extraction ext;
     decoder dec(rseq, false);
     breader* br;
     
+    ext.index    = NULL;
+    ext.wstart   = 0;
+    ext.wend     = rseq.length();
+    ext.pipeline = pipeline;
+    
     char buffer[4096];
     
-    if (strcmp("-", alzw_file))
+    if (range) {
+        parse_range(range, ext.wstart, ext.wend);
+        if (ext.wend > rseq.length())
+            ext.wend = rseq.length();
+        if (ext.wstart >= ext.wend)
+            throw runtime_exception("reference range is out of the reference sequence: %s", range);
+        
+        snprintf(buffer, sizeof(buffer), ":%lu-%lu", 
+            (unsigned long)ext.wstart + 1, (unsigned long)ext.wend);
+        ext.suffix = buffer;
+    }
+    
+    if (strcmp("-", alzw_file)) {
         br = new file_breader(alzw_file);
-    else
+        ext.index = seek_index::load(alzw_file);
+    } else
         br = new stream_breader(stdin);
     
-    int seqc = br->read_int();
-    for (int i = 0; i < seqc; i++) {
-        if (br->read_str(buffer, sizeof(buffer)) < 0)
-            throw runtime_exception("ALZW sequence file name is too long, maximum supported length is 4095 characters");
-        fnames.push_back(buffer);
+    ext.hdr.read(*br);
+    dec.set_coder(ext.hdr.get_coder());
+    if (ext.index) {
+        ext.hdr.read_segments(*br, *ext.index);
+        ext.hdr.read_budget(*ext.index);
+    }
+    
+    size_t count  = ext.hdr.sequences();
+    size_t freeze = ext.hdr.freeze_point();
+    
+    if (seq_list)
+        seqs = utils::parse_seq_list(seq_list);
+    else {
+        for (size_t i = 1; i <= count; i++)
+            seqs.push_back(i);
+    }
+    
+    // appended segments are discovered while decoding if there is no index
+    if (ext.index && seqs.back() > count)
+        throw runtime_exception("no such sequence: %lu", (unsigned long)seqs.back());
+    if (ext.index && ext.index->sequences() != count)
+        throw runtime_exception("seek index does not match the ALZW stream");
+    
+    if (ext.hdr.chunks() > 1) {
+        decompress_chunks(rseq, alzw_file, *br, ext, seqs, threads);
+        delete ext.index;
+        delete br;
+        return;
     }
     
-    if (seqc < 0)
-        throw runtime_exception("negative number of ALZW sequences");
-    else if (seqc > 0) {
-        for (int i = 0; i < seqc; i++) {
-            snprintf(buffer, sizeof(buffer), "%s.fa", fnames[i].c_str());
-            decompress(*br, dec, fnames[i], buffer);
+    // selected sequences encoded using the frozen dictionary can be decoded 
+    // concurrently once the dictionary is complete
+    size_t serial = seqs.size();
+    if (threads > 1 && ext.index && freeze < count) {
+        serial = std::lower_bound(seqs.begin(), seqs.end(), freeze + 1) 
+            - seqs.begin();
+    }
+    
+    bool discover = !ext.index && !seq_list;
+    size_t i = decompress_chunk(*br, dec, ext, 0, seqs.data(), serial, 
+        serial == seqs.size() && !discover);
+    
+    if (serial < seqs.size()) {
+        // complete the dictionary
+        while (i < freeze) {
+            i = skip(*ext.index, dec, *br, i, freeze, 0);
+            if (i == freeze)
+                break;
+            
+            dec.decode(*br);
+            i++;
         }
-    } else
-        dec.decode(*br, std::cout);
+        
+        dec.freeze_dictionary();
+        
+        thread_pool pool(threads);
+        
+        for (size_t j = serial; j < seqs.size(); j++) {
+            size_t s = seqs[j] - 1;
+            
+            pool.submit([&, s] {
+                file_breader sbr(alzw_file);
+                decoder sdec(&dec);
+                
+                sdec.set_window(ext.wstart, ext.wend, true);
+                sdec.seek(sbr, *ext.index->find(s, ext.wstart));
+                decompress(sbr, sdec, ext.hdr, s, ext.suffix, 
+                    ext.pipeline);
+            });
+        }
+        
+        pool.wait();
+    }
+    
+    // decode all appended segments
+    while (discover && ext.hdr.read_segment(*br)) {
+        size_t j = seqs.size();
+        for (size_t k = j + 1; k <= ext.hdr.sequences(); k++)
+            seqs.push_back(k);
+        
+        i = decompress_chunk(*br, dec, ext, i, seqs.data() + j, 
+            seqs.size() - j, false);
+    }
     
+    delete ext.index;
     delete br;
 }
 
+/**
+ * Create a dictionary snapshot for a given ALZW stream. The snapshot will be 
+ * saved next to the ALZW file. There is a separate snapshot for every chunk 
+ * of an ALZW stream split into chunks.
+ *
+ * @param rseq_file reference sequence in FASTA format
+ * @param alzw_file ALZW file
+ */
+static void export_snapshot(const char* rseq_file, const char* alzw_file) {
+    std::string rseq = utils::load_fasta(rseq_file);
+    file_breader br(alzw_file);
+    archive_header hdr;
+    
+    hdr.read(br);
+    
+    seek_index* index = seek_index::load(alzw_file);
+    if (index) {
+        hdr.read_budget(*index);
+        delete index;
+    }
+    
+    // the whole archive is hashed, do it only once for all chunks
+    dictionary_snapshot::origin origin(alzw_file, rseq);
+    
+    for (size_t i = 0; i < hdr.chunks(); i++) {
+        std::string sfile = dictionary_snapshot::snapshot_file(alzw_file, i);
+        
+        dictionary_snapshot* snapshot = dictionary_snapshot::create(
+            rseq, alzw_file, i, origin);
+        
+        fprintf(stderr, "%s\n", sfile.c_str());
+        snapshot->save(sfile.c_str());
+        
+        delete snapshot;
+    }
+}
+
 int main(int argc, const char **argv) {
     const char* usage = 
         "USAGE: alzw [OPTIONS] [RSEQ] [ALZW] [A1 [A2 [...]]]\n\n"
         "    RSEQ  reference sequence file in FASTA format (used only in case of\n"
-        "          decompression)\n"
-        "    ALZW  ALZW compressed file (used only in case of decompression)\n"
+        "          decompression or snapshot export)\n"
+        "    ALZW  ALZW compressed file (used only in case of decompression or\n"
+        "          snapshot export)\n"
         "    A#    sequence alignment file in FASTA format (used only in case of\n"
         "          compression)\n\n"
         "OPTIONS\n\n"
         "    -d     decompression\n"
+        "    -n seqs decompress only given sequences (one-based, e.g. 1,4,7-9; valid\n"
+        "           only in case of decompression)\n"
+        "    -r s-e decompress only symbols aligned to a given reference range\n"
+        "           (one-based, inclusive; valid only in case of decompression)\n"
+        "    -x     export dictionary snapshot into ALZW.dict (used by alzwq to load\n"
+        "           the index without decoding the whole file)\n"
+        "    -u alzw append the alignments to a given ALZW file without\n"
+        "           recompressing the existing sequences; the ALZW file is\n"
+        "           replaced only once the new segment is written (options -f,\n"
+        "           -c, -p, -b, -B, -e and -m cannot be used)\n"
         "    -s num synchronization period [200] (valid only in case of compression)\n"
         "    -a     adaptive synchronization (valid only in case of compression)\n"
+        "    -m file cache the adaptive synchronization map in a given file, the\n"
+        "           cached map is reused if the alignments did not change (valid\n"
+        "           only in case of compression)\n"
+        "    -i     write seek index of sequences and synchronization points (valid\n"
+        "           only in case of compression)\n"
+        "    -f num freeze the dictionary after the first num alignments; the\n"
+        "           remaining alignments are encoded independently (valid only in\n"
+        "           case of compression)\n"
+        "    -c num split the alignments into chunks of num alignments, every chunk\n"
+        "           is encoded using its own dictionary (valid only in case of\n"
+        "           compression)\n"
+        "    -j num number of threads used for alignments encoded using a frozen\n"
+        "           dictionary or split into chunks (in case of both compression\n"
+        "           and decompression) and for creating the adaptive\n"
+        "           synchronization map (also in case of appending) [1]\n"
+        "    -p     pipelined compression, the alignments are parsed and the output\n"
+        "           is written on separate threads; in case of decompression the\n"
+        "           decoded sequences are formatted and written on separate\n"
+        "           threads\n"
+        "    -b num limit memory used by dictionary nodes to num bytes (a k, M or G\n"
+        "           suffix may be used), the budget is checked before every\n"
+        "           alignment (valid only in case of compression)\n"
+        "    -B pol policy used once the dictionary exceeds the budget: reset (start\n"
+        "           a new dictionary) or freeze (encode the remaining alignments\n"
+        "           using the frozen dictionary) [reset]\n"
+        "    -e cod codeword coder: fixed (fixed-width codewords) or range (adaptive\n"
+        "           range coder, smaller output but the seek index contains only\n"
+        "           beginnings of the alignments) [fixed] (valid only in case of\n"
+        "           compression)\n"
+        "    --stats-json file\n"
+        "           write metrics of every compressed alignment (wall and CPU time,\n"
+        "           input and output size, bits of M/Rs, inserts and deletes and\n"
+        "           the dictionary state) into a given file, one JSON object per\n"
+        "           line (valid only in case of compression)\n"
         "    -h     show help\n";
     
     int  i = 1;
     
     bool d = false;
+    bool x = false;
     int  s = 200;
     bool a = false;
+    bool idx = false;
+    bool p = false;
+    size_t f = SIZE_MAX;
+    size_t c = 0;
+    size_t j = 1;
+    
+    const char* n = NULL;
+    const char* r = NULL;
+    const char* u = NULL;
+    const char* m = NULL;
+    const char* b = NULL;
+    const char* B = "reset";
+    const char* e = "fixed";
+    const char* json = NULL;
+    
+    // the last option which is not valid in case of appending
+    const char* nua = NULL;
     
     for (; i < argc; i++) {
         if (*argv[i] != '-')
@@ -367,10 +1882,45 @@ int main(int argc, const char **argv) {
             return 0;
         } else if (!strcmp("d", option)) {
             d = true;
+        } else if (!strcmp("x", option)) {
+            x = true;
         } else if (!strcmp("s", option)) {
             s = atoi(argv[++i]);
         } else if (!strcmp("a", option)) {
             a = true;
+        } else if (!strcmp("i", option)) {
+            idx = true;
+        } else if (!strcmp("f", option)) {
+            f = strtoul(argv[++i], NULL, 10);
+            nua = argv[i - 1];
+        } else if (!strcmp("c", option)) {
+            c = strtoul(argv[++i], NULL, 10);
+            nua = argv[i - 1];
+        } else if (!strcmp("j", option)) {
+            j = strtoul(argv[++i], NULL, 10);
+        } else if (!strcmp("p", option)) {
+            p = true;
+            nua = argv[i];
+        } else if (!strcmp("n", option)) {
+            n = argv[++i];
+        } else if (!strcmp("r", option)) {
+            r = argv[++i];
+        } else if (!strcmp("u", option)) {
+            u = argv[++i];
+        } else if (!strcmp("m", option)) {
+            m = argv[++i];
+            nua = argv[i - 1];
+        } else if (!strcmp("b", option)) {
+            b = argv[++i];
+            nua = argv[i - 1];
+        } else if (!strcmp("B", option)) {
+            B = argv[++i];
+            nua = argv[i - 1];
+        } else if (!strcmp("e", option)) {
+            e = argv[++i];
+            nua = argv[i - 1];
+        } else if (!strcmp("-stats-json", option)) {
+            json = argv[++i];
         } else {
             fprintf(stderr, "unrecognized option: -%s\n\n", option);
             fprintf(stderr, "%s\n", usage);
@@ -381,34 +1931,51 @@ int main(int argc, const char **argv) {
     argv += i;
     argc -= i;
     
-    if (d && argc < 2) {
+    if ((d || x) && argc < 2) {
         fprintf(stderr, "a reference sequence and a set of compressed sequences are required\n"
-                        "    for decompression\n\n");
+                        "    for decompression and snapshot export\n\n");
         fprintf(stderr, "%s\n", usage);
         return 1;
-    } else if (!d && argc < 1) {
+    } else if (!d && !x && argc < 1) {
         fprintf(stderr, "at least a single FASTA alignment is required for compression\n\n");
         fprintf(stderr, "%s\n", usage);
         return 1;
     }
     
+    if (u && nua) {
+        fprintf(stderr, "option %s is not valid in case of appending\n\n", nua);
+        fprintf(stderr, "%s\n", usage);
+        return 1;
+    }
+    
     if (s < 0)
         s = 0;
+    if (j < 1)
+        j = 1;
     
     double t = utils::time();
+    double w = utils::wall_time();
     
     try {
-        if (d)
-            decompress(argv[0], argv[1]);
-        else
-            compress(s, a, argv, argc);
+        if (x)
+            export_snapshot(argv[0], argv[1]);
+        else if (d)
+            decompress(argv[0], argv[1], n, r, j, p);
+        else if (u)
+            append(s, a, idx, j, u, json, argv, argc);
+        else {
+            compress(s, a, idx, f, c, j, p, m, b ? parse_size(b) : 0, 
+                parse_policy(B), parse_coder(e), json, argv, argc);
+        }
     } catch (std::exception& ex) {
         fprintf(stderr, "ERROR: %s\n", ex.what());
         return 2;
     }
     
     t = utils::time() - t;
+    w = utils::wall_time() - w;
     fprintf(stderr, "elapsed time [s]: %f\n", t);
+    fprintf(stderr, "wall time [s]:    %f\n", w);
     
     return 0;
 }
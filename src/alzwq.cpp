@@ -22,6 +22,7 @@ THE SOFTWARE.
 
 #include <sstream>
 #include <cstring>
+#include <cstdlib>
 
 #include "utils.hpp"
 #include "search-engine.hpp"
@@ -97,11 +98,17 @@ int main(int argc, const char** argv) {
         "               dfa deterministic finite automaton\n"
         "               bmh Boyer-Moore-Horspool\n"
         "               s   simple search (naive algorithm)\n"
+        "    -n seqs search only in given sequences (one-based, e.g. 1,4,7-9); the\n"
+        "           sequences are accessed directly if ALZW contains a seek index\n"
+        "    -j num number of threads used for searching in ALZW split into chunks [1]\n"
         "    -h     show help\n";
     
     int  i = 1;
     
     int  a = SE_ALG_LM;
+    size_t j = 1;
+    
+    const char* n = NULL;
     
     for (; i < argc; i++) {
         if (*argv[i] != '-')
@@ -127,6 +134,10 @@ int main(int argc, const char** argv) {
                 fprintf(stderr, "%s\n", usage);
                 return 1;
             }
+        } else if (!strcmp("n", option)) {
+            n = argv[++i];
+        } else if (!strcmp("j", option)) {
+            j = strtoul(argv[++i], NULL, 10);
         } else {
             fprintf(stderr, "unrecognized option: -%s\n\n", option);
             fprintf(stderr, "%s\n", usage);
@@ -145,7 +156,10 @@ int main(int argc, const char** argv) {
     
     try {
         fprintf(stderr, "loading index...\n");
-        search_engine se(argv[0], argv[1]);
+        search_engine se(argv[0], argv[1], j < 1 ? 1 : j);
+        
+        if (n)
+            se.select(utils::parse_seq_list(n));
         
         fprintf(stderr, "enter query:\n");
         while (process_query(a, se))
@@ -0,0 +1,331 @@
+/*
+Copyright (c) 2015 Perutka, Ondrej
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <algorithm>
+
+#include "archive.hpp"
+#include "exception.hpp"
+
+using namespace alzw;
+
+archive_header::archive_header() {
+    version = 1;
+    flags   = 0;
+    freeze  = 0;
+    chunk   = 0;
+    policy  = BUDGET_NONE;
+    budget  = 0;
+    coder   = CODER_FIXED;
+}
+
+void archive_header::read(breader& in) {
+    char buffer[4096];
+    uint64_t tmp;
+    
+    names.clear();
+    segment_starts.clear();
+    reset_points.clear();
+    version = 1;
+    flags   = 0;
+    freeze  = 0;
+    chunk   = 0;
+    policy  = BUDGET_NONE;
+    budget  = 0;
+    coder   = CODER_FIXED;
+    
+    int seqc = in.read_int();
+    if (seqc == -1) {
+        in.read(tmp, 8);
+        version = tmp;
+        if (version != ARCHIVE_VERSION)
+            throw parse_exception("unsupported ALZW format version: %u", (unsigned)version);
+        
+        in.read(tmp, 8);
+        flags = tmp;
+        if (flags & ~(ARCHIVE_FROZEN | ARCHIVE_CHUNKED | ARCHIVE_BUDGET 
+            | ARCHIVE_CODER))
+            throw parse_exception("unsupported ALZW format flags: 0x%02x", (unsigned)flags);
+        if ((flags & ARCHIVE_BUDGET) 
+            && (flags & (ARCHIVE_FROZEN | ARCHIVE_CHUNKED)))
+            throw parse_exception("unsupported ALZW format flags: 0x%02x", (unsigned)flags);
+        
+        seqc = in.read_int();
+    }
+    
+    if (seqc < 0)
+        throw runtime_exception("negative number of ALZW sequences");
+    
+    for (int i = 0; i < seqc; i++) {
+        if (in.read_str(buffer, sizeof(buffer)) < 0)
+            throw runtime_exception("ALZW sequence file name is too long, maximum supported length is 4095 characters");
+        names.push_back(buffer);
+    }
+    
+    if (flags & ARCHIVE_FROZEN)
+        freeze = in.read_int();
+    if (flags & ARCHIVE_CHUNKED)
+        chunk = in.read_int();
+    if (flags & ARCHIVE_BUDGET) {
+        in.read(tmp, 8);
+        policy = tmp;
+        in.read(budget, 64);
+    }
+    if (flags & ARCHIVE_CODER) {
+        in.read(tmp, 8);
+        coder = tmp;
+    }
+    
+    if ((flags & ARCHIVE_CHUNKED) && chunk == 0)
+        throw parse_exception("invalid ALZW chunk size");
+    if ((flags & ARCHIVE_BUDGET) 
+        && policy != BUDGET_FREEZE && policy != BUDGET_RESET)
+        throw parse_exception("unsupported ALZW dictionary budget policy: %u", (unsigned)policy);
+    if (coder != CODER_FIXED && coder != CODER_RANGE)
+        throw parse_exception("unsupported ALZW codeword coder: %u", (unsigned)coder);
+}
+
+void archive_header::write(bwriter& out) const {
+    if (version > 1) {
+        out.write(-1, sizeof(int) << 3);
+        out.write(version, 8);
+        out.write(flags, 8);
+    }
+    
+    out.write(names.size(), sizeof(int) << 3);
+    for (size_t i = 0; i < names.size(); i++)
+        out.write_str(names[i].c_str());
+    
+    if (flags & ARCHIVE_FROZEN)
+        out.write(freeze, sizeof(int) << 3);
+    if (flags & ARCHIVE_CHUNKED)
+        out.write(chunk, sizeof(int) << 3);
+    if (flags & ARCHIVE_BUDGET) {
+        out.write(policy, 8);
+        out.write(budget, 64);
+    }
+    if (flags & ARCHIVE_CODER)
+        out.write(coder, 8);
+}
+
+void archive_header::set_freeze_point(uint32_t seqc) {
+    version = ARCHIVE_VERSION;
+    flags  |= ARCHIVE_FROZEN;
+    freeze  = seqc;
+}
+
+size_t archive_header::freeze_point() const {
+    if (flags & ARCHIVE_FROZEN)
+        return freeze;
+    
+    return sequences();
+}
+
+void archive_header::set_chunk_size(uint32_t seqc) {
+    version = ARCHIVE_VERSION;
+    flags  |= ARCHIVE_CHUNKED;
+    chunk   = seqc;
+}
+
+size_t archive_header::chunk_size() const {
+    if (flags & ARCHIVE_CHUNKED)
+        return chunk;
+    
+    return sequences();
+}
+
+size_t archive_header::chunks() const {
+    if (flags & ARCHIVE_BUDGET)
+        return reset_points.size() + 1;
+    
+    size_t size = chunk_size();
+    
+    return (sequences() + size - 1) / size;
+}
+
+size_t archive_header::chunk_start(size_t chunk) const {
+    if (flags & ARCHIVE_BUDGET)
+        return chunk > 0 ? reset_points[chunk - 1] : 0;
+    
+    return chunk * chunk_size();
+}
+
+size_t archive_header::chunk_end(size_t chunk) const {
+    if ((chunk + 1) < chunks())
+        return chunk_start(chunk + 1);
+    
+    return sequences();
+}
+
+size_t archive_header::chunk_of(size_t seq) const {
+    if (flags & ARCHIVE_BUDGET) {
+        return std::upper_bound(reset_points.begin(), reset_points.end(), 
+            seq) - reset_points.begin();
+    }
+    
+    return seq / chunk_size();
+}
+
+bool archive_header::is_chunk_start(size_t seq) const {
+    if (flags & ARCHIVE_BUDGET) {
+        return std::binary_search(reset_points.begin(), 
+            reset_points.end(), seq);
+    }
+    
+    return (flags & ARCHIVE_CHUNKED) && (seq % chunk) == 0;
+}
+
+void archive_header::set_budget(uint64_t bytes, uint8_t policy) {
+    version = ARCHIVE_VERSION;
+    flags  |= ARCHIVE_BUDGET;
+    budget  = bytes;
+    
+    this->policy = policy;
+}
+
+void archive_header::read_budget(const seek_index& index) {
+    const std::vector<uint32_t>& points = index.get_budget_points();
+    
+    if (!(flags & ARCHIVE_BUDGET)) {
+        if (!points.empty())
+            throw parse_exception("unexpected ALZW dictionary budget points");
+        return;
+    }
+    
+    for (size_t i = 0; i < points.size(); i++) {
+        if (points[i] == 0 || points[i] >= sequences() 
+            || (i > 0 && points[i] <= points[i - 1]))
+            throw parse_exception("invalid ALZW dictionary budget point");
+    }
+    
+    if (policy == BUDGET_RESET)
+        reset_points.assign(points.begin(), points.end());
+    else if (points.size() > 1)
+        throw parse_exception("invalid ALZW dictionary budget point");
+    else if (!points.empty()) {
+        flags |= ARCHIVE_FROZEN;
+        freeze = points[0];
+    }
+}
+
+uint8_t archive_header::budget_action(size_t seq, size_t memory) const {
+    if (!(flags & ARCHIVE_BUDGET) || seq == 0 || memory < budget)
+        return BUDGET_NONE;
+    
+    if (policy == BUDGET_FREEZE)
+        return (flags & ARCHIVE_FROZEN) ? BUDGET_NONE : BUDGET_FREEZE;
+    
+    return BUDGET_RESET;
+}
+
+uint8_t archive_header::apply_budget(size_t seq, size_t memory) {
+    uint8_t action = budget_action(seq, memory);
+    
+    if (action == BUDGET_FREEZE) {
+        flags |= ARCHIVE_FROZEN;
+        freeze = seq;
+    } else if (action == BUDGET_RESET 
+        && (reset_points.empty() || reset_points.back() < seq))
+        reset_points.push_back(seq);
+    
+    return action;
+}
+
+void archive_header::set_coder(uint8_t coder) {
+    this->coder = coder;
+    
+    if (coder == CODER_FIXED)
+        flags &= ~ARCHIVE_CODER;
+    else {
+        version = ARCHIVE_VERSION;
+        flags  |= ARCHIVE_CODER;
+    }
+}
+
+void archive_header::read_segments(breader& in, const seek_index& index) {
+    const std::vector<uint64_t>& segments = index.get_segments();
+    uint64_t offset = in.tell();
+    
+    for (size_t i = 0; i < segments.size(); i++) {
+        in.seek(segments[i]);
+        if (!read_segment(in))
+            throw parse_exception("invalid ALZW segment offset");
+    }
+    
+    in.seek(offset);
+}
+
+bool archive_header::read_segment(breader& in) {
+    char buffer[4096];
+    uint64_t tmp;
+    
+    in.align();
+    
+    if (in.read(tmp, sizeof(int) << 3) < (int)(sizeof(int) << 3) 
+        || (int)tmp != -1)
+        return false;
+    
+    in.read(tmp, 8);
+    if (tmp != ARCHIVE_VERSION)
+        throw parse_exception("unsupported ALZW format version: %u", (unsigned)tmp);
+    
+    in.read(tmp, 8);
+    if (tmp != ARCHIVE_SEGMENT)
+        throw parse_exception("invalid ALZW segment header");
+    
+    int seqc = in.read_int();
+    if (seqc <= 0)
+        throw parse_exception("invalid number of ALZW sequences in a segment");
+    
+    segment_starts.push_back(names.size());
+    
+    for (int i = 0; i < seqc; i++) {
+        if (in.read_str(buffer, sizeof(buffer)) < 0)
+            throw runtime_exception("ALZW sequence file name is too long, maximum supported length is 4095 characters");
+        names.push_back(buffer);
+    }
+    
+    return true;
+}
+
+void archive_header::skip_segment(breader& in) const {
+    archive_header tmp;
+    
+    if (!tmp.read_segment(in))
+        throw parse_exception("missing ALZW segment header");
+}
+
+void archive_header::write_segment(bwriter& out) const {
+    out.align();
+    out.write(-1, sizeof(int) << 3);
+    out.write(ARCHIVE_VERSION, 8);
+    out.write(ARCHIVE_SEGMENT, 8);
+    
+    out.write(names.size(), sizeof(int) << 3);
+    for (size_t i = 0; i < names.size(); i++)
+        out.write_str(names[i].c_str());
+}
+
+bool archive_header::is_segment_start(size_t seq) const {
+    return std::binary_search(segment_starts.begin(), 
+        segment_starts.end(), seq);
+}
+
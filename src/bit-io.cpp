@@ -40,15 +40,16 @@ void bwriter::write_buf(const uint8_t* buffer, size_t bits) {
         bits -= 8;
     }
     
+    // the last byte is filled from the most significant bit
     if (bits > 0)
-        write(buffer[offset], bits);
+        write(buffer[offset] >> (8 - bits), bits);
 }
 
 int bwriter::write_gamma(uint64_t n) {
     int bits  = utils::number_width(n);
     int width = (bits << 1) - 1;
     
-    n = (1 << (bits - 1)) | n;
+    n = ((uint64_t)1 << (bits - 1)) | n;
     
     write(n, width);
     
@@ -65,6 +66,12 @@ int bwriter::write_delta(uint64_t n) {
     return gwidth + bwidth;
 }
 
+void bwriter::align() {
+    int rest = tell() & 0x7;
+    if (rest > 0)
+        write(0, 8 - rest);
+}
+
 int breader::read_int() {
     uint64_t val = 0;
     
@@ -91,7 +98,7 @@ uint64_t breader::read_gamma() {
     
     read(val, bits);
     
-    return (1 << bits) | val;
+    return ((uint64_t)1 << bits) | val;
 }
 
 uint64_t breader::read_delta() {
@@ -105,7 +112,7 @@ uint64_t breader::read_delta() {
     
     read(val, bits);
     
-    return (1 << bits) | val;
+    return ((uint64_t)1 << bits) | val;
 }
 
 ssize_t breader::read_str(char* buffer, size_t size) {
@@ -126,9 +133,41 @@ ssize_t breader::read_str(char* buffer, size_t size) {
     return offset;
 }
 
-stream_bwriter::stream_bwriter(FILE* stream) {
+void breader::align() {
+    uint64_t tmp;
+    int rest = tell() & 0x7;
+    if (rest > 0)
+        read(tmp, 8 - rest);
+}
+
+memory_bwriter::memory_bwriter() {
+    bit_offset = 0;
+}
+
+void memory_bwriter::write(uint64_t bits, int width) {
+    while (width > 0) {
+        if ((bit_offset & 0x7) == 0)
+            buffer.push_back(0);
+        
+        int wa = 8 - (bit_offset & 0x7);
+        int wr = wa > width ? width : wa;
+        uint8_t m = (1 << wr) - 1;
+        uint8_t b = (bits >> (width - wr)) & m;
+        buffer.back() |= b << (wa - wr);
+        
+        width -= wr;
+        bit_offset += wr;
+    }
+}
+
+void memory_bwriter::write_to(bwriter& out) const {
+    out.write_buf(buffer.data(), bit_offset);
+}
+
+stream_bwriter::stream_bwriter(FILE* stream, uint64_t offset) {
     this->stream     = stream;
     this->bit_offset = 0;
+    this->written    = offset;
 }
 
 stream_bwriter::~stream_bwriter() {
@@ -141,6 +180,7 @@ void stream_bwriter::write(uint64_t bits, int width) {
         if (ferror(stream))
             throw io_exception("error while writing into a file");
         
+        written += bit_offset >> 3;
         buffer[0] = buffer[bit_offset >> 3];
         bit_offset &= 0x7;
     }
@@ -158,13 +198,121 @@ void stream_bwriter::write(uint64_t bits, int width) {
     }
 }
 
+uint64_t stream_bwriter::tell() const {
+    return (written << 3) + bit_offset;
+}
+
 void stream_bwriter::flush() {
     fwrite(buffer, sizeof(uint8_t), (bit_offset + 7) >> 3, stream);
     fflush(stream);
     
+    written += (bit_offset + 7) >> 3;
     bit_offset = 0;
 }
 
+// size of buffers passed to the writer thread
+#define ASYNC_BUFFER_SIZE   65536
+
+async_bwriter::async_bwriter(FILE* stream, size_t capacity)
+    : buffer(ASYNC_BUFFER_SIZE)
+    , queue(capacity) {
+    this->stream     = stream;
+    this->bit_offset = 0;
+    this->written    = 0;
+    this->failed     = false;
+    
+    writer_thread = std::thread(&async_bwriter::writer, this);
+}
+
+async_bwriter::~async_bwriter() {
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+void async_bwriter::writer() {
+    std::vector<uint8_t> data;
+    
+    while (queue.pop(data)) {
+        fwrite(data.data(), sizeof(uint8_t), data.size(), stream);
+        if (ferror(stream)) {
+            failed = true;
+            queue.close();
+            return;
+        }
+    }
+    
+    fflush(stream);
+    if (ferror(stream))
+        failed = true;
+}
+
+void async_bwriter::submit(size_t bytes) {
+    if (bytes == 0)
+        return;
+    
+    std::vector<uint8_t> data(ASYNC_BUFFER_SIZE);
+    
+    // keep the incomplete byte (if any) in the new buffer
+    if (bytes < buffer.size())
+        data[0] = buffer[bytes];
+    
+    data.swap(buffer);
+    data.resize(bytes);
+    
+    if (!queue.push(std::move(data)))
+        throw io_exception("error while writing into a file");
+    
+    written    += bytes;
+    bit_offset -= bytes << 3;
+}
+
+void async_bwriter::write(uint64_t bits, int width) {
+    if ((bit_offset + width) > (buffer.size() << 3))
+        submit(bit_offset >> 3);
+    
+    while (width > 0) {
+        int wa = 8 - (bit_offset & 0x7);
+        int wr = wa > width ? width : wa;
+        uint8_t m = (1 << wr) - 1;
+        uint8_t b = (bits >> (width - wr)) & m;
+        buffer[bit_offset >> 3] &= ~m << (wa - wr);
+        buffer[bit_offset >> 3] |=  b << (wa - wr);
+        
+        width -= wr;
+        bit_offset += wr;
+    }
+}
+
+uint64_t async_bwriter::tell() const {
+    return (written << 3) + bit_offset;
+}
+
+void async_bwriter::flush() {
+    bit_offset = (bit_offset + 7) & ~(size_t)0x7;
+    submit(bit_offset >> 3);
+}
+
+void async_bwriter::close() {
+    if (!writer_thread.joinable())
+        return;
+    
+    try {
+        flush();
+    } catch (...) {
+        queue.close();
+        writer_thread.join();
+        throw;
+    }
+    
+    queue.close();
+    writer_thread.join();
+    
+    if (failed)
+        throw io_exception("error while writing into a file");
+}
+
 file_bwriter::file_bwriter(const char* file)
     : stream_bwriter(fopen(file, "wb")) {
     if (!stream)
@@ -172,6 +320,7 @@ file_bwriter::file_bwriter(const char* file)
 }
 
 file_bwriter::~file_bwriter() {
+    flush();
     fclose(stream);
 }
 
@@ -179,6 +328,7 @@ stream_breader::stream_breader(FILE* stream) {
     this->stream     = stream;
     this->bit_offset = 0;
     this->available  = 0;
+    this->consumed   = 0;
 }
 
 stream_breader::~stream_breader() {
@@ -195,6 +345,7 @@ int stream_breader::read(uint64_t& bits, int width) {
         if (ferror(stream))
             throw io_exception("error while reading from a file");
         
+        consumed  += a;
         available += a << 3;
     }
     
@@ -221,6 +372,24 @@ int stream_breader::read(uint64_t& bits, int width) {
     return width;
 }
 
+uint64_t stream_breader::tell() const {
+    return ((consumed - (available >> 3)) << 3) + bit_offset;
+}
+
+void stream_breader::seek(uint64_t offset) {
+    uint64_t tmp;
+    
+    if (fseek(stream, offset >> 3, SEEK_SET))
+        throw io_exception("unable to seek within the input stream");
+    
+    consumed   = offset >> 3;
+    available  = 0;
+    bit_offset = 0;
+    
+    if (offset & 0x7)
+        read(tmp, offset & 0x7);
+}
+
 file_breader::file_breader(const char* file)
     : stream_breader(fopen(file, "rb")) {
     if (!stream)
@@ -0,0 +1,439 @@
+/*
+Copyright (c) 2015 Perutka, Ondrej
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <cmath>
+
+#include "codeword-coder.hpp"
+#include "utils.hpp"
+#include "exception.hpp"
+
+using namespace alzw;
+
+// price table resolution (probabilities are reduced by this number of bits)
+#define RC_PRICE_SHIFT      4
+
+/**
+ * Table of bit prices in 1/16 bits indexed by the reduced probability of 
+ * the bit.
+ */
+struct price_table {
+    uint32_t prices[RC_MODEL_TOTAL >> RC_PRICE_SHIFT];
+    
+    price_table() {
+        size_t count = RC_MODEL_TOTAL >> RC_PRICE_SHIFT;
+        for (size_t i = 0; i < count; i++) {
+            double p = (i + 0.5) / count;
+            prices[i] = (uint32_t)(-log(p) / log(2) * 16 + 0.5);
+        }
+    }
+};
+
+/**
+ * Get price of a given bit.
+ *
+ * @param prob probability of 0
+ * @param bit  bit
+ * @returns price in 1/16 bits
+ */
+static uint32_t bit_price(uint16_t prob, int bit) {
+    static const price_table table;
+    
+    if (bit)
+        prob = RC_MODEL_TOTAL - prob;
+    
+    return table.prices[prob >> RC_PRICE_SHIFT];
+}
+
+// ####################
+// number_model methods
+// ####################
+
+void number_model::reset() {
+    for (size_t i = 0; i < sizeof(slots) / sizeof(slots[0]); i++)
+        slots[i] = RC_MODEL_TOTAL >> 1;
+    
+    for (size_t i = 0; i < 65; i++) {
+        for (size_t j = 0; j < (1 << RC_MANTISSA_BITS); j++)
+            mantissa[i][j] = RC_MODEL_TOTAL >> 1;
+    }
+}
+
+// #####################
+// range_encoder methods
+// #####################
+
+void range_encoder::reset() {
+    low        = 0;
+    range      = 0xffffffff;
+    cache_size = 1;
+    cache      = 0;
+    first      = true;
+    cost       = 0;
+}
+
+void range_encoder::shift_low(bwriter& out) {
+    if ((uint32_t)low < 0xff000000 || (low >> 32) != 0) {
+        uint8_t carry = low >> 32;
+        uint8_t b = cache;
+        
+        // the very first byte is always zero, so it is not written at all
+        do {
+            if (!first)
+                out.write((uint8_t)(b + carry), 8);
+            first = false;
+            b = 0xff;
+        } while (--cache_size != 0);
+        
+        cache = (uint8_t)(low >> 24);
+    }
+    
+    cache_size++;
+    low = (low & 0x00ffffff) << 8;
+}
+
+void range_encoder::encode(uint16_t& prob, int bit, bwriter& out) {
+    uint32_t bound = (range >> RC_MODEL_BITS) * prob;
+    
+    cost += bit_price(prob, bit);
+    
+    if (bit) {
+        low   += bound;
+        range -= bound;
+        prob  -= prob >> RC_MOVE_BITS;
+    } else {
+        range  = bound;
+        prob  += (RC_MODEL_TOTAL - prob) >> RC_MOVE_BITS;
+    }
+    
+    while (range < RC_TOP) {
+        range <<= 8;
+        shift_low(out);
+    }
+}
+
+void range_encoder::encode_direct(uint64_t bits, int width, bwriter& out) {
+    cost += (uint64_t)width << 4;
+    
+    while (width-- > 0) {
+        range >>= 1;
+        if ((bits >> width) & 1)
+            low += range;
+        
+        while (range < RC_TOP) {
+            range <<= 8;
+            shift_low(out);
+        }
+    }
+}
+
+void range_encoder::encode(number_model& model, uint64_t n, int base, 
+    bwriter& out) {
+    int width = utils::number_width(n);
+    uint32_t slot = base - width;
+    uint32_t index = 1;
+    
+    for (int i = 6; i >= 0; i--) {
+        int bit = (slot >> i) & 1;
+        encode(model.slots[index], bit, out);
+        index = (index << 1) | bit;
+    }
+    
+    if (width < 2)
+        return;
+    
+    // the leading one is implied by the slot
+    int rest = width - 1;
+    int mbits = std::min(rest, RC_MANTISSA_BITS);
+    
+    index = 1;
+    
+    for (int i = rest - 1; i >= rest - mbits; i--) {
+        int bit = (n >> i) & 1;
+        encode(model.mantissa[width][index], bit, out);
+        index = (index << 1) | bit;
+    }
+    
+    encode_direct(n, rest - mbits, out);
+}
+
+void range_encoder::flush(bwriter& out) {
+    for (int i = 0; i < 5; i++)
+        shift_low(out);
+    
+    uint64_t c = cost;
+    reset();
+    cost = c;
+}
+
+size_t range_encoder::take_cost() {
+    size_t bits = cost >> 4;
+    cost &= 0xf;
+    
+    return bits;
+}
+
+// #####################
+// range_decoder methods
+// #####################
+
+uint32_t range_decoder::next_byte(breader& in) {
+    uint64_t b;
+    
+    if (in.read(b, 8) < 8)
+        throw runtime_exception("unexpected EOF in ALZW stream");
+    
+    return (uint32_t)b;
+}
+
+void range_decoder::init(breader& in) {
+    range = 0xffffffff;
+    code  = 0;
+    
+    // the first (always zero) byte is not stored
+    for (int i = 0; i < 4; i++)
+        code = (code << 8) | next_byte(in);
+}
+
+int range_decoder::decode(uint16_t& prob, breader& in) {
+    uint32_t bound = (range >> RC_MODEL_BITS) * prob;
+    int bit;
+    
+    if (code < bound) {
+        range = bound;
+        prob += (RC_MODEL_TOTAL - prob) >> RC_MOVE_BITS;
+        bit   = 0;
+    } else {
+        code  -= bound;
+        range -= bound;
+        prob  -= prob >> RC_MOVE_BITS;
+        bit    = 1;
+    }
+    
+    while (range < RC_TOP) {
+        range <<= 8;
+        code = (code << 8) | next_byte(in);
+    }
+    
+    return bit;
+}
+
+uint64_t range_decoder::decode_direct(int width, breader& in) {
+    uint64_t result = 0;
+    
+    while (width-- > 0) {
+        range >>= 1;
+        
+        uint32_t bit = code >= range;
+        if (bit)
+            code -= range;
+        
+        result = (result << 1) | bit;
+        
+        while (range < RC_TOP) {
+            range <<= 8;
+            code = (code << 8) | next_byte(in);
+        }
+    }
+    
+    return result;
+}
+
+uint64_t range_decoder::decode(number_model& model, int base, breader& in) {
+    uint32_t index = 1;
+    
+    for (int i = 0; i < 7; i++)
+        index = (index << 1) | decode(model.slots[index], in);
+    
+    uint32_t slot = index & 0x7f;
+    if ((int)slot > base)
+        throw runtime_exception("corrupted range-coded ALZW stream");
+    
+    int width = base - slot;
+    if (width < 2)
+        return width;
+    
+    int rest = width - 1;
+    int mbits = std::min(rest, RC_MANTISSA_BITS);
+    uint64_t n = 1;
+    
+    index = 1;
+    
+    for (int i = 0; i < mbits; i++) {
+        int bit = decode(model.mantissa[width][index], in);
+        index = (index << 1) | bit;
+        n = (n << 1) | bit;
+    }
+    
+    n <<= rest - mbits;
+    n |= decode_direct(rest - mbits, in);
+    
+    return n;
+}
+
+// #######################
+// codeword_writer methods
+// #######################
+
+codeword_writer * codeword_writer::create(uint8_t coder) {
+    if (coder == CODER_FIXED)
+        return new fixed_codeword_writer();
+    else if (coder == CODER_RANGE)
+        return new range_codeword_writer();
+    
+    throw runtime_exception("unknown codeword coder: %u", (unsigned)coder);
+}
+
+// #######################
+// codeword_reader methods
+// #######################
+
+codeword_reader * codeword_reader::create(uint8_t coder) {
+    if (coder == CODER_FIXED)
+        return new fixed_codeword_reader();
+    else if (coder == CODER_RANGE)
+        return new range_codeword_reader();
+    
+    throw runtime_exception("unknown codeword coder: %u", (unsigned)coder);
+}
+
+// #############################
+// fixed_codeword_writer methods
+// #############################
+
+size_t fixed_codeword_writer::write_cw(uint64_t cw, int width, 
+    bwriter& out) {
+    out.write(cw, width);
+    
+    return width;
+}
+
+size_t fixed_codeword_writer::write_ins_cw(uint64_t cw, int width, 
+    bwriter& out) {
+    out.write(cw, width);
+    
+    return width;
+}
+
+size_t fixed_codeword_writer::write_ins_count(uint64_t n, bwriter& out) {
+    return out.write_delta(n);
+}
+
+size_t fixed_codeword_writer::write_del_length(uint64_t n, bwriter& out) {
+    return out.write_delta(n);
+}
+
+// #############################
+// fixed_codeword_reader methods
+// #############################
+
+uint64_t fixed_codeword_reader::read_cw(int width, breader& in) {
+    uint64_t cw = 0;
+    
+    // drop the last read if it's too short
+    if (width > in.read(cw, width))
+        throw runtime_exception("unexpected EOF in ALZW stream");
+    
+    return cw;
+}
+
+uint64_t fixed_codeword_reader::read_ins_cw(int width, breader& in) {
+    return read_cw(width, in);
+}
+
+uint64_t fixed_codeword_reader::read_ins_count(breader& in) {
+    return in.read_delta();
+}
+
+uint64_t fixed_codeword_reader::read_del_length(breader& in) {
+    return in.read_delta();
+}
+
+// #############################
+// range_codeword_writer methods
+// #############################
+
+void range_codeword_writer::begin_sequence(bwriter& out) {
+    mm_model.reset();
+    icw_model.reset();
+    icount_model.reset();
+    dlength_model.reset();
+}
+
+size_t range_codeword_writer::write_cw(uint64_t cw, int width, 
+    bwriter& out) {
+    rc.encode(mm_model, cw, width, out);
+    
+    return rc.take_cost();
+}
+
+size_t range_codeword_writer::write_ins_cw(uint64_t cw, int width, 
+    bwriter& out) {
+    rc.encode(icw_model, cw, width, out);
+    
+    return rc.take_cost();
+}
+
+size_t range_codeword_writer::write_ins_count(uint64_t n, bwriter& out) {
+    rc.encode(icount_model, n, 64, out);
+    
+    return rc.take_cost();
+}
+
+size_t range_codeword_writer::write_del_length(uint64_t n, bwriter& out) {
+    rc.encode(dlength_model, n, 64, out);
+    
+    return rc.take_cost();
+}
+
+void range_codeword_writer::end_sequence(bwriter& out) {
+    rc.flush(out);
+}
+
+// #############################
+// range_codeword_reader methods
+// #############################
+
+void range_codeword_reader::begin_sequence(breader& in) {
+    mm_model.reset();
+    icw_model.reset();
+    icount_model.reset();
+    dlength_model.reset();
+    
+    rc.init(in);
+}
+
+uint64_t range_codeword_reader::read_cw(int width, breader& in) {
+    return rc.decode(mm_model, width, in);
+}
+
+uint64_t range_codeword_reader::read_ins_cw(int width, breader& in) {
+    return rc.decode(icw_model, width, in);
+}
+
+uint64_t range_codeword_reader::read_ins_count(breader& in) {
+    return rc.decode(icount_model, 64, in);
+}
+
+uint64_t range_codeword_reader::read_del_length(breader& in) {
+    return rc.decode(dlength_model, 64, in);
+}
+
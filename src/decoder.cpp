@@ -22,176 +22,428 @@ THE SOFTWARE.
 
 #include <cmath>
 #include <cstring>
+#include <algorithm>
+#include <stdint.h>
 
 #include "decoder.hpp"
+#include "fasta-writer.hpp"
 #include "utils.hpp"
 #include "exception.hpp"
 
 using namespace alzw;
 
-decoder::decoder(const std::string& rs, bool hash_index)
-    : rseq(rs) {
-    this->hash_index = hash_index;
+decoder::decoder(const std::string& rs, bool phrase_index)
+    : rseq(rs)
+    , own_dict(new dictionary())
+    , dict(*own_dict) {
+    this->phrase_index = phrase_index;
+    
+    frozen = false;
     
     width = (int)ceil(log(dict.used_nodes()) / log(2));
     
+    coder     = CODER_FIXED;
+    cw_reader = codeword_reader::create(coder);
+    
     rbufferSize = 1024;
     rbuffer = new char[rbufferSize];
     
+    window = NULL;
+    wpos   = 0;
+    refs   = NULL;
+    
     offset = 0;
+    line_length = FASTA_LINE_LENGTH;
+    
+    wstart    = 0;
+    wend      = SIZE_MAX;
+    wtruncate = false;
+    
+    sroffset = 0;
+    
+    seq_roffset = 0;
+    seq_rend    = 0;
     
     ob_offset = 0;
 }
 
-decoder::~decoder() {
-    delete [] rbuffer;
+decoder::decoder(const std::string& rs, dictionary& d)
+    : rseq(rs)
+    , own_dict(NULL)
+    , dict(d) {
+    phrase_index = false;
+    frozen = false;
+    
+    width = (int)ceil(log(dict.used_nodes()) / log(2));
+    
+    coder     = CODER_FIXED;
+    cw_reader = codeword_reader::create(coder);
+    
+    rbufferSize = 1024;
+    rbuffer = new char[rbufferSize];
+    
+    window = NULL;
+    wpos   = 0;
+    refs   = NULL;
+    
+    offset = 0;
+    line_length = FASTA_LINE_LENGTH;
+    
+    wstart    = 0;
+    wend      = SIZE_MAX;
+    wtruncate = false;
+    
+    sroffset = 0;
+    
+    seq_roffset = 0;
+    seq_rend    = 0;
+    
+    ob_offset = 0;
 }
 
-void decoder::output_char(char c, std::ostream* out) {
-    if ((ob_offset + 1) == sizeof(obuffer))
-        flush_output_buffer(out);
+decoder::decoder(const decoder* master)
+    : rseq(master->rseq)
+    , own_dict(NULL)
+    , dict(master->dict) {
+    if (!master->frozen)
+        throw runtime_exception("only a frozen dictionary can be shared");
+    
+    phrase_index = false;
+    frozen = true;
+    
+    width = master->width;
+    
+    coder     = master->coder;
+    cw_reader = codeword_reader::create(coder);
+    
+    rbufferSize = 1024;
+    rbuffer = new char[rbufferSize];
     
-    obuffer[ob_offset++] = c;
+    window = NULL;
+    wpos   = 0;
+    refs   = NULL;
+    
+    offset = 0;
+    line_length = master->line_length;
+    
+    wstart    = master->wstart;
+    wend      = master->wend;
+    wtruncate = master->wtruncate;
+    
+    sroffset = 0;
+    
+    seq_roffset = 0;
+    seq_rend    = 0;
+    
+    ob_offset = 0;
 }
 
-void decoder::flush_output_buffer(std::ostream* out) {
-    obuffer[ob_offset] = 0;
-    *out << obuffer;
+decoder::~decoder() {
+    delete [] rbuffer;
+    delete [] window;
+    delete [] refs;
+    delete own_dict;
+    delete cw_reader;
+}
+
+void decoder::flush_output_buffer(symbol_sink* out) {
+    out->write(obuffer, ob_offset);
     ob_offset = 0;
+}
+
+void decoder::output_symbols(const char* s, size_t len, 
+    symbol_sink* out) {
+    size_t n;
     
-    if (out->fail())
-        throw io_exception("error while writing into a file");
+    // there is nothing to format, the symbols can be passed as they are
+    if (line_length == 0) {
+        if (ob_offset > 0)
+            flush_output_buffer(out);
+        
+        out->write(s, len);
+        offset += len;
+        return;
+    }
+    
+    while (len > 0) {
+        n = std::min(len, sizeof(obuffer) >> 1);
+        n = std::min(n, line_length - (offset % line_length));
+        
+        // keep space for the line break
+        if ((ob_offset + n + 1) > sizeof(obuffer))
+            flush_output_buffer(out);
+        
+        memcpy(obuffer + ob_offset, s, n);
+        ob_offset += n;
+        offset    += n;
+        s   += n;
+        len -= n;
+        
+        if ((offset % line_length) == 0)
+            obuffer[ob_offset++] = '\n';
+    }
 }
 
-size_t decoder::output_node(const node* n, uint32_t noffset, 
-    size_t roffset, std::ostream* out) {
-    size_t i = 0;
+void decoder::reserve_phrase(size_t size) {
+    size_t nsize = rbufferSize;
+    while (nsize < size)
+        nsize <<= 1;
     
-    if (hash_index)
-        phrases[n->id() + noffset] = NULL;
+    if (nsize > rbufferSize)
+        rbufferSize = utils::crealloc((uint8_t**)&rbuffer, rbufferSize, nsize);
+}
+
+const char * decoder::build_phrase(const node* n, uint32_t noffset, 
+    size_t plen) {
+    size_t i = plen;
     
-    if (!out)
-        return n->phrase_length() + noffset - n->length();
+    reserve_phrase(plen);
     
     while (n->parent()) {
-        if (i >= rbufferSize) {
-            rbufferSize = utils::crealloc((uint8_t**)&rbuffer, 
-                rbufferSize, rbufferSize << 1);
-        }
+        i -= noffset;
+        n->expand(rbuffer + i, noffset);
         
-        if (noffset > 0)
-            rbuffer[i++] = utils::base2char(n->get_base(--noffset));
-        else {
-            rbuffer[i++] = utils::base2char(n->symbol());
-            n = n->parent();
-            noffset = n->length();
-        }
+        rbuffer[--i] = utils::base2char(n->symbol());
+        n = n->parent();
+        noffset = n->length();
     }
     
-    for (size_t j = 1; j <= i; j++) {
-        output_char(rbuffer[i - j], out);
-        if ((++offset % 60) == 0)
-            output_char('\n', out);
+    return rbuffer;
+}
+
+/**
+ * Get cache slot of a given codeword.
+ *
+ * @param cw codeword
+ * @returns slot index
+ */
+static size_t cache_slot(uint64_t cw) {
+    return ((cw * 0x9e3779b97f4a7c15ULL) >> 48) & (DECODER_CACHE_SIZE - 1);
+}
+
+const char * decoder::copy_phrase(uint64_t cw, size_t plen) {
+    if (!refs || plen < DECODER_MIN_COPY)
+        return NULL;
+    
+    const phrase_ref& ref = refs[cache_slot(cw)];
+    if (ref.cw != cw || (wpos - ref.pos) > DECODER_WINDOW_SIZE)
+        return NULL;
+    
+    size_t start = ref.pos & (DECODER_WINDOW_SIZE - 1);
+    size_t first = std::min(plen, (size_t)DECODER_WINDOW_SIZE - start);
+    
+    reserve_phrase(plen);
+    
+    memcpy(rbuffer, window + start, first);
+    memcpy(rbuffer + first, window, plen - first);
+    
+    // frequently used phrases must not age out
+    if ((wpos - ref.pos) > (DECODER_WINDOW_SIZE >> 1))
+        remember_phrase(cw, rbuffer, plen);
+    
+    return rbuffer;
+}
+
+void decoder::remember_phrase(uint64_t cw, const char* phrase, size_t plen) {
+    if (plen < DECODER_MIN_COPY || plen > (DECODER_WINDOW_SIZE >> 2))
+        return;
+    
+    if (!refs) {
+        window = new char[DECODER_WINDOW_SIZE];
+        refs   = new phrase_ref[DECODER_CACHE_SIZE];
+        clear_window();
+    }
+    
+    phrase_ref& ref = refs[cache_slot(cw)];
+    ref.cw  = cw;
+    ref.pos = wpos;
+    
+    size_t start = wpos & (DECODER_WINDOW_SIZE - 1);
+    size_t first = std::min(plen, (size_t)DECODER_WINDOW_SIZE - start);
+    
+    memcpy(window + start, phrase, first);
+    memcpy(window, phrase + first, plen - first);
+    
+    wpos += plen;
+}
+
+void decoder::clear_window() {
+    if (!refs)
+        return;
+    
+    for (size_t i = 0; i < DECODER_CACHE_SIZE; i++)
+        refs[i].cw = UINT64_MAX;
+}
+
+size_t decoder::output_node(const node* n, uint32_t noffset, 
+    size_t roffset, bool ins, symbol_sink* out) {
+    size_t plen = n->phrase_length() + noffset - n->length();
+    uint64_t cw = n->id() + noffset;
+    
+    if (phrase_index)
+        mark_phrase(cw);
+    
+    if (!out)
+        return plen;
+    else if (ins && !in_window(roffset, true))
+        return plen;
+    else if (!ins && (roffset >= wend || (roffset + plen) <= wstart))
+        return plen;
+    
+    const char* phrase = copy_phrase(cw, plen);
+    if (!phrase) {
+        phrase = build_phrase(n, noffset, plen);
+        remember_phrase(cw, phrase, plen);
     }
     
-    return i;
+    // only a part of a match/replace phrase may be within the window
+    size_t start = 0;
+    size_t end   = plen;
+    if (!ins && wstart > roffset)
+        start = wstart - roffset;
+    if (!ins && (wend - roffset) < plen)
+        end = wend - roffset;
+    
+    output_symbols(phrase + start, end - start, out);
+    
+    return plen;
 }
 
-size_t decoder::output_match(uint64_t id, size_t roffset, std::ostream* out) {
+size_t decoder::output_match(uint64_t id, size_t roffset, symbol_sink* out) {
     size_t i = roffset;
-    char c;
     
     dict.new_phrase();
     
-    while (id > dict.get_id() && i < rseq.length()) {
-        c = rseq[i++];
-        dict.add(c);
-        if (out) {
-            output_char(c, out);
-            if ((++offset % 60) == 0)
-                output_char('\n', out);
-        }
-    }
+    i += dict.add_run(rseq.data() + i, rseq.length() - i, id);
     
     if (id != dict.get_id())
         throw runtime_exception("match overflow");
     
+    // the phrase is a substring of the reference, output its part within 
+    // the window at once
+    size_t start = std::max(roffset, wstart);
+    size_t end   = std::min(i, wend);
+    if (out && start < end)
+        output_symbols(rseq.data() + start, end - start, out);
+    
     dict.commit_phrase();
     
-    if (hash_index)
-        phrases[id] = NULL;
+    if (phrase_index)
+        mark_phrase(id);
     
     return i - roffset;
 }
 
 size_t decoder::decode_mr(uint64_t cw, 
-    size_t roffset, breader& in, std::ostream* out) {
+    size_t roffset, breader& in, symbol_sink* out) {
     const node* n = dict.get(cw);
     if (n)
-        return output_node(n, cw - n->id(), roffset, out);
+        return output_node(n, cw - n->id(), roffset, false, out);
+    else if (frozen)
+        throw runtime_exception("unknown codeword: 0x%016lx", (unsigned long)cw);
     
     return output_match(cw, roffset, out);
 }
 
-void decoder::decode_ins(size_t roffset, breader& in, std::ostream* out) {
-    size_t count = in.read_delta();
+void decoder::decode_ins(size_t roffset, breader& in, symbol_sink* out) {
+    size_t count = cw_reader->read_ins_count(in);
     const node* n;
     uint64_t cw;
     
     for (size_t i = 0; i < count; i++) {
-        if (width > in.read(cw, width))
-            throw runtime_exception("unexpected EOF in ALZW stream");
+        cw = cw_reader->read_ins_cw(width, in);
         if (!(n = dict.get(cw)))
             throw runtime_exception("unknown codeword: 0x%016lx", (unsigned long)cw);
         
-        output_node(n, cw - n->id(), roffset, out);
+        output_node(n, cw - n->id(), roffset, true, out);
     }
 }
 
-void decoder::decode(breader& in, std::ostream* out) {
-    const node* inode = dict.get_inode();
-    const node* dnode = dict.get_dnode();
-    const node* wnode = dict.get_wnode();
-    uint64_t cw = 0;
+void decoder::start_sequence(breader& in) {
+    seq_roffset = sroffset;
+    seq_rend    = wtruncate && wend < rseq.size() ? wend : rseq.size();
     
-    size_t roffset = 0;
-    offset = 0;
+    offset   = 0;
+    sroffset = 0;
     
-    while (roffset < rseq.size()) {
-        // drop the last read if it's too short
-        if (width > in.read(cw, width))
-            throw runtime_exception("unexpected EOF in ALZW stream");
-        
-        if (cw == inode->id())
-            decode_ins(roffset, in, out);
-        else if (cw == dnode->id())
-            roffset += in.read_delta();
-        else if (cw == wnode->id()) {
-            if (width == (sizeof(cw) << 3))
-                throw runtime_exception("codeword width overflow");
-            width++;
-        } else
-            roffset += decode_mr(cw, roffset, in, out);
+    // sequences encoded using frozen dictionary start at a byte boundary
+    if (frozen && seq_roffset == 0)
+        in.align();
+    
+    if (seq_roffset == 0)
+        cw_reader->begin_sequence(in);
+}
+
+bool decoder::decode_codeword(breader& in, symbol_sink* out) {
+    if (seq_roffset >= seq_rend) {
+        if (out && ob_offset > 0)
+            flush_output_buffer(out);
+        return false;
     }
     
-    if (out)
-        flush_output_buffer(out);
+    uint64_t cw = cw_reader->read_cw(width, in);
+    
+    if (cw == dict.get_inode()->id())
+        decode_ins(seq_roffset, in, out);
+    else if (cw == dict.get_dnode()->id())
+        seq_roffset += cw_reader->read_del_length(in);
+    else if (cw == dict.get_wnode()->id()) {
+        if (width == (sizeof(cw) << 3))
+            throw runtime_exception("codeword width overflow");
+        width++;
+    } else
+        seq_roffset += decode_mr(cw, seq_roffset, in, out);
+    
+    return true;
+}
+
+void decoder::reset_dictionary() {
+    dict.clear();
+    phrases.clear();
+    clear_window();
+    
+    frozen = false;
+    
+    width = (int)ceil(log(dict.used_nodes()) / log(2));
 }
 
 void decoder::decode(breader& in) {
-    decode(in, NULL);
+    start_sequence(in);
+    while (decode_codeword(in, NULL)) { }
 }
 
 void decoder::decode(breader& in, std::ostream& out) {
-    decode(in, &out);
+    ostream_sink sink(out);
+    
+    decode(in, sink);
 }
 
-void decoder::freeze() {
-    if (!hash_index)
-        return;
+void decoder::decode(breader& in, symbol_sink& out) {
+    start_sequence(in);
+    while (decode_codeword(in, &out)) { }
+}
+
+void decoder::set_coder(uint8_t coder) {
+    codeword_reader* reader = codeword_reader::create(coder);
+    
+    delete cw_reader;
+    
+    this->coder = coder;
+    cw_reader   = reader;
+}
+
+void decoder::set_window(size_t start, size_t end, bool truncate) {
+    wstart    = start;
+    wend      = end;
+    wtruncate = truncate;
+}
+
+void decoder::seek(breader& in, const seek_point& p) {
+    if (p.next_id != dict.next_id())
+        throw runtime_exception("dictionary state does not match the seek point");
     
-    std::unordered_map<uint64_t, const node*>::iterator it = phrases.begin();
-    for (; it != phrases.end(); ++it)
-        it->second = dict.get(it->first);
+    in.seek(p.offset);
+    width    = p.width;
+    sroffset = p.roffset;
 }
 
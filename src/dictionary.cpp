@@ -22,7 +22,7 @@ THE SOFTWARE.
 
 #include <cstring>
 #include <sstream>
-#include <deque>
+#include <new>
 #include <algorithm>
 
 #include "dictionary.hpp"
@@ -37,106 +37,207 @@ using namespace alzw;
 // node methods
 // ############
 
+#ifdef COMPACT_NODES
+slab_region node::node_region(COMPACT_NODE_REGION);
+slab_region node::link_region(COMPACT_LINK_REGION);
+slab_region node::sequence_region(COMPACT_SEQUENCE_REGION);
+#endif
+
+#ifdef NODE_COLLAPSING
+/**
+ * Read a 32-bit value stored at an arbitrary address.
+ *
+ * @param p address
+ * @returns value
+ */
+static inline uint32_t load_u32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/**
+ * Write a 32-bit value at an arbitrary address.
+ *
+ * @param p address
+ * @param v value
+ */
+static inline void store_u32(uint8_t* p, uint32_t v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+/**
+ * Read 32 packed symbols (the first symbol ends up in the lowest bits).
+ *
+ * @param p packed symbols
+ * @returns packed symbols
+ */
+static inline uint64_t load_bases(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--)
+        v = (v << 8) | p[i];
+    
+    return v;
+}
+
+/**
+ * Get size of the storage of a collapsed sequence.
+ *
+ * @param len  sequence length
+ * @param runs capacity of the list of N runs
+ * @returns size in bytes
+ */
+static inline size_t sequence_size(uint32_t len, uint32_t runs) {
+    size_t size = (len + 3) >> 2;
+    if (runs > 0)
+        size += sizeof(uint32_t) * (1 + 2 * runs);
+    
+    return size;
+}
+
+/**
+ * Packed byte to characters conversion table.
+ */
+static struct unpack_table {
+    char chars[256][4];
+    
+    unpack_table() {
+        for (int i = 0; i < 256; i++) {
+            for (int j = 0; j < 4; j++)
+                chars[i][j] = utils::base2char((i >> (j << 1)) & 3);
+        }
+    }
+} unpack_table;
+#endif
+
 node::node() {
-    this->nid = 0;
+    set_id(0);
     this->sym = 0;
-    this->par = NULL;
+    this->par = ref(NULL);
     this->deg = 0;
     this->plen = 0;
-    this->children = NULL;
+    set_only_child(NULL);
 
 #ifdef NODE_COLLAPSING
     this->len = 0;
-    this->seq = NULL;
+    clear_sequence();
 #endif
 }
 
 node::node(uint64_t id, uint8_t sym, node* parent) {
-    this->nid = id;
+    set_id(id);
     this->sym = sym;
-    this->par = parent;
+    this->par = ref(parent);
     this->deg = 0;
     this->plen = 1;
-    this->children = NULL;
+    set_only_child(NULL);
     
     if (parent)
         this->plen += parent->plen;
 
 #ifdef NODE_COLLAPSING
     this->len = 0;
-    this->seq = NULL;
+    clear_sequence();
 #endif
 }
 
 node::node(uint64_t id, uint8_t sym, uint32_t plen, node* parent) {
-    this->nid = id;
+    set_id(id);
     this->sym = sym;
-    this->par = parent;
+    this->par = ref(parent);
     this->deg = 0;
     this->plen = plen;
-    this->children = NULL;
+    set_only_child(NULL);
 
 #ifdef NODE_COLLAPSING
     this->len = 0;
-    this->seq = NULL;
+    clear_sequence();
 #endif
 }
 
 #ifdef NODE_COLLAPSING
-node::node(uint64_t id, uint8_t* phrase, uint32_t len, node* parent) {
-    uint32_t size = len >> 1;
-    
-    this->nid = id;
+node::node(uint64_t id, uint8_t* phrase, uint32_t len, node* parent, 
+    nibble_pool& pool) {
+    set_id(id);
     this->sym = phrase[0];
-    this->par = parent;
+    this->par = ref(parent);
     this->deg = 0;
-    this->seq = new uint8_t[size];
-    this->len = len - 1;
-    this->plen = len;
-    this->children = NULL;
-    
-    memset(seq, 0, sizeof(uint8_t) * size);
-    
-    for (uint32_t i = 1; i < len; i++)
-        set_base(i - 1, phrase[i]);
+    this->len = 0;
+    this->plen = 1;
+    set_only_child(NULL);
     
     if (parent)
         this->plen += parent->plen;
+    
+    clear_sequence();
+    append(phrase + 1, len - 1, pool);
 }
 
-node::node(node* n, uint32_t offset, uint32_t len, uint32_t plen, node* parent) {
-    uint32_t size = (len + 1) >> 1;
+node::node(node* n, uint32_t offset, uint32_t len, uint32_t plen, node* parent, 
+    nibble_pool& pool) {
+    const uint8_t* src = n->sequence() + (offset >> 2);
+    uint32_t avail = ((n->len + 3) >> 2) - (offset >> 2);
+    uint32_t size = (len + 3) >> 2;
+    uint32_t shift = (offset & 3) << 1;
+    uint32_t runs = 0;
+    uint32_t start, end;
+    uint8_t* dst;
     
-    this->nid = n->id() + offset;
-    this->par = parent;
+    set_id(n->id() + offset);
+    this->par = ref(parent);
     this->deg = 0;
-    this->seq = new uint8_t[size];
-    this->len = len;
+    this->len = 0;
     this->plen = plen;
-    this->children = NULL;
+    set_only_child(NULL);
     
     if (offset > 0)
         this->sym = n->get_base(offset - 1);
     else
         this->sym = n->symbol();
     
-    memset(seq, 0, sizeof(uint8_t) * size);
+    clear_sequence();
+    
+    // the tail of a split node is shared if it starts at a whole byte and 
+    // there are no N runs, otherwise it is shifted into a new block
+    if (!n->has_runs() && shift == 0 && share_sequence(n, offset >> 2, len)) {
+        this->len = len;
+        return;
+    }
+    
+    for (uint32_t i = 0; i < n->run_count(); i++) {
+        n->get_run(i, start, end);
+        if (end > offset && start < (offset + len))
+            runs++;
+    }
     
-    for (uint32_t i = 0; i < len; i++)
-        set_base(i, n->get_base(offset + i));
+    resize_sequence(len, runs, pool);
+    
+    dst = sequence();
+    if (shift == 0)
+        memcpy(dst, src, size);
+    else {
+        for (uint32_t i = 0; i < size; i++) {
+            dst[i] = src[i] >> shift;
+            if ((i + 1) < avail)
+                dst[i] |= src[i + 1] << (8 - shift);
+        }
+    }
+    
+    for (uint32_t i = 0; runs > 0 && i < n->run_count(); i++) {
+        n->get_run(i, start, end);
+        if (end > offset && start < (offset + len))
+            add_run(std::max(start, offset) - offset, 
+                std::min(end, offset + len) - offset);
+    }
 }
+#endif
 
-node::~node() {
-    delete [] seq;
-}
-#else
 node::~node() {
 }
-#endif
 
 void node::release_children(node_allocator& allocator) {
     if (deg > 1)
-        allocator.free_children((node**)children, deg);
+        allocator.free_children(child_array(), deg);
     
     deg = 0;
 }
@@ -177,63 +278,74 @@ node * node::first_child(uint32_t offset) {
     else if (deg == 0)
         return NULL;
     else if (deg == 1)
-        return (node*)children;
+        return only_child();
+    else if (deg < NODE_TABLE_DEGREE)
+        return deref(child_array()[0]);
+    
+    node_ref* tmp = child_array();
+    for (uint8_t i = 0; i < NODE_TABLE_SIZE; i++) {
+        if (tmp[i])
+            return deref(tmp[i]);
+    }
     
-    return *(node**)children;
+    return NULL;
 }
 
 size_t node::size() const {
-    size_t s = sizeof(node) + ((length() + 1) >> 1);
+    size_t s = NODE_NOMINAL_SIZE + ((length() + 1) >> 1);
     if (deg > 1)
-        s += deg * sizeof(node*);
+        s += deg * NODE_NOMINAL_LINK_SIZE;
     
     return s;
 }
 
 #ifdef NODE_COLLAPSING
-void node::append(int base) {
+void node::append(int base, nibble_pool& pool) {
     // use this for debugging:
     //if (deg > 0)
     //    throw runtime_exception("not a leaf node");
     
-    size_t size = (++len + 1) >> 1;
-    uint8_t* nseq = new uint8_t[size];
-    
-    if (seq) {
-        memcpy(nseq, seq, len >> 1);
-        delete [] seq;
-    }
-    
-    seq = nseq;
+    uint8_t b = base;
     
+    resize_sequence(len + 1, run_count() + new_runs(&b, 1), pool);
     set_base(len - 1, base);
     
+    if (base == NODE_N_SYMBOL)
+        add_run(len - 1, len);
+    
     plen++;
 }
 
-void node::append(uint8_t* phrase, uint32_t len) {
+void node::append(uint8_t* phrase, uint32_t len, nibble_pool& pool) {
     // use this for debugging:
     //if (deg > 0)
     //    throw runtime_exception("not a leaf node");
     
-    size_t size = (this->len + len + 1) >> 1;
-    uint8_t* nseq = new uint8_t[size];
+    uint32_t start = this->len;
+    uint32_t runs = new_runs(phrase, len);
+    uint32_t i = 0;
     
-    if (seq) {
-        memcpy(nseq, seq, (this->len + 1) >> 1);
-        delete [] seq;
-    }
+    resize_sequence(this->len + len, run_count() + runs, pool);
+    this->plen += len;
     
-    seq = nseq;
+    // fill the last partially used byte first
+    for (; (start + i) & 3 && i < len; i++)
+        set_base(start + i, phrase[i]);
     
-    for (uint32_t i = 0; i < len; i++)
-        set_base(this->len + i, phrase[i]);
+    pack(sequence() + ((start + i) >> 2), phrase + i, len - i);
     
-    this->len += len;
-    this->plen += len;
+    // there are no N symbols unless there are new runs or the last run 
+    // continues
+    if (runs == 0 && (len == 0 || phrase[0] != NODE_N_SYMBOL))
+        return;
+    
+    for (i = 0; i < len; i++) {
+        if (phrase[i] == NODE_N_SYMBOL)
+            add_run(start + i, start + i + 1);
+    }
 }
 
-void node::shrink(uint32_t len) {
+void node::shrink(uint32_t len, nibble_pool& pool) {
     // use this for debugging:
     //if (len > this->len)
     //    throw runtime_exception("shrink size is greater than the current size");
@@ -241,22 +353,158 @@ void node::shrink(uint32_t len) {
     if (len == this->len)
         return;
     
-    size_t size = (len + 1) >> 1;
-    uint8_t* nseq;
-    if (len > 0)
-        nseq = new uint8_t[size];
-    else
-        nseq = NULL;
+    uint32_t count = 0;
+    uint32_t start, end;
     
-    if (seq) {
-        memcpy(nseq, seq, size);
-        delete [] seq;
+    // drop N runs beyond the new end
+    for (; count < run_count(); count++) {
+        get_run(count, start, end);
+        if (start >= len)
+            break;
+        else if (end > len)
+            store_u32(runs() + sizeof(uint32_t) * (2 + 2 * count), len);
     }
     
+    if (has_runs())
+        store_u32(runs(), count);
+    
     this->plen -= this->len - len;
-    this->seq = nseq;
+    
+    // the tail stays in the pool (it might be shared by a split node)
+    resize_sequence(len, count, pool);
+}
+
+void node::pack(uint8_t* dst, const uint8_t* bases, uint32_t count) {
+    uint32_t i;
+    for (i = 0; (i + 3) < count; i += 4) {
+        *dst++ = (bases[i] & 3) | ((bases[i + 1] & 3) << 2) 
+            | ((bases[i + 2] & 3) << 4) | ((bases[i + 3] & 3) << 6);
+    }
+    
+    if (i < count) {
+        *dst = 0;
+        for (uint32_t j = 0; (i + j) < count; j++)
+            *dst |= (bases[i + j] & 3) << (j << 1);
+    }
+}
+
+uint32_t node::run_count() const {
+    return has_runs() ? load_u32(runs()) : 0;
+}
+
+void node::get_run(uint32_t index, uint32_t& start, uint32_t& end) const {
+    const uint8_t* r = runs() + sizeof(uint32_t) * (1 + 2 * index);
+    start = load_u32(r);
+    end   = load_u32(r + sizeof(uint32_t));
+}
+
+void node::add_run(uint32_t start, uint32_t end) {
+    uint32_t count = run_count();
+    uint32_t pstart, pend;
+    
+    if (count > 0) {
+        get_run(count - 1, pstart, pend);
+        if (pend == start) {
+            store_u32(runs() + sizeof(uint32_t) * (2 * count), end);
+            return;
+        }
+    }
+    
+    uint8_t* r = runs() + sizeof(uint32_t) * (1 + 2 * count);
+    store_u32(r, start);
+    store_u32(r + sizeof(uint32_t), end);
+    store_u32(runs(), count + 1);
+}
+
+uint32_t node::new_runs(const uint8_t* bases, uint32_t count) const {
+    uint32_t result = 0;
+    uint32_t start, end = 0;
+    bool prev;
+    
+    if (has_runs())
+        get_run(run_count() - 1, start, end);
+    
+    prev = has_runs() && end == len;
+    for (uint32_t i = 0; i < count; i++) {
+        bool cur = bases[i] == NODE_N_SYMBOL;
+        if (cur && !prev)
+            result++;
+        prev = cur;
+    }
+    
+    return result;
+}
+
+void node::move_runs(uint8_t* block, uint32_t len, uint32_t runs) {
+    uint8_t* src = block + ((this->len + 3) >> 2);
+    uint8_t* dst = block + ((len + 3) >> 2);
+    
+    if (runs > 0 && has_runs())
+        memmove(dst, src, sequence_size(0, load_u32(src)));
+    else if (runs > 0)
+        store_u32(dst, 0);
+    
+    if (runs > 0)
+        sym |= NODE_N_RUNS;
+    else
+        sym &= ~NODE_N_RUNS;
+    
     this->len = len;
 }
+
+#ifdef COMPACT_NODES
+void node::resize_sequence(uint32_t len, uint32_t runs, nibble_pool& pool) {
+    size_t size = sequence_size(this->len, run_count());
+    size_t nsize = sequence_size(len, runs);
+    uint8_t* block;
+    
+    if (len <= NODE_INLINE_BASES && runs == 0) {
+        // move a shrunk sequence back into the node
+        if (!inline_sequence())
+            memcpy(seq.bases, sequence_region.address(seq.block), nsize);
+        
+        move_runs(seq.bases, len, 0);
+        return;
+    } else if (inline_sequence()) {
+        block = pool.alloc(nsize);
+        memcpy(block, seq.bases, size);
+    } else
+        block = pool.grow(sequence_region.address(seq.block), size, nsize);
+    
+    seq.block = sequence_region.offset(block);
+    move_runs(block, len, runs);
+}
+
+bool node::share_sequence(const node* n, uint32_t offset, uint32_t len) {
+    // short sequences are always copied into the node
+    if (len <= NODE_INLINE_BASES)
+        return false;
+    
+    seq.block = n->seq.block + offset;
+    
+    return true;
+}
+#else
+void node::resize_sequence(uint32_t len, uint32_t runs, nibble_pool& pool) {
+    size_t size = sequence_size(this->len, run_count());
+    size_t nsize = sequence_size(len, runs);
+    
+    if (len == 0) {
+        seq = NULL;
+        sym &= ~NODE_N_RUNS;
+        this->len = 0;
+    } else {
+        seq = pool.grow(seq, size, nsize);
+        move_runs(seq, len, runs);
+    }
+}
+
+bool node::share_sequence(const node* n, uint32_t offset, uint32_t len) {
+    seq = len ? n->seq + offset : NULL;
+    
+    return true;
+}
+#endif
 #endif
 
 node * node::create(int base, node_allocator& allocator) {
@@ -264,25 +512,26 @@ node * node::create(int base, node_allocator& allocator) {
     //node* n = get(base);
     //if (n)
     //    throw runtime_exception("there is already a child node for the given base");
+    node* tmp[NODE_TABLE_SIZE];
     node* n;
     
-    if (deg == 0)
-        children = n = allocator.alloc(base, this);
-    else {
-        node** tmp = allocator.alloc_children(deg + 1);
-        if (deg == 1)
-            tmp[0] = (node*)children;
-        else {
-            for (uint8_t i = 0; i < deg; i++)
-                tmp[i] = ((node**)children)[i];
-            allocator.free_children((node**)children, deg);
-        }
-        tmp[deg] = n = allocator.alloc(base, this);
-        children = tmp;
+    if (deg == 0) {
+        n = allocator.alloc(base, this);
+        set_only_child(n);
+        deg++;
+    } else if (deg >= NODE_TABLE_DEGREE) {
+        // there is an empty slot for the new child in the child table
+        node_ref* c = allocator.resize_children(child_array(), deg, deg + 1);
+        n = allocator.alloc(base, this);
+        c[base] = ref(n);
+        deg++;
+    } else {
+        get_children(tmp);
+        n = allocator.alloc(base, this);
+        tmp[deg] = n;
+        set_children(tmp, deg + 1, allocator);
     }
     
-    deg++;
-    
     return n;
 }
 
@@ -290,16 +539,19 @@ node * node::get(int base) {
     if (deg == 0)
         return NULL;
     else if (deg == 1) {
-        if (base == ((node*)children)->symbol())
-            return (node*)children;
+        node* c = only_child();
+        if (base == c->symbol())
+            return c;
         else
             return NULL;
-    }
+    } else if (deg >= NODE_TABLE_DEGREE)
+        return deref(child_array()[base]);
     
-    node** tmp = (node**)children;
+    node_ref* tmp = child_array();
     for (uint8_t i = 0; i < deg; i++) {
-        if (tmp[i]->symbol() == base)
-            return tmp[i];
+        node* c = deref(tmp[i]);
+        if (c->symbol() == base)
+            return c;
     }
     
     return NULL;
@@ -309,16 +561,19 @@ const node * node::get(int base) const {
     if (deg == 0)
         return NULL;
     else if (deg == 1) {
-        if (base == ((node*)children)->symbol())
-            return (node*)children;
+        const node* c = only_child();
+        if (base == c->symbol())
+            return c;
         else
             return NULL;
-    }
+    } else if (deg >= NODE_TABLE_DEGREE)
+        return deref(child_array()[base]);
     
-    node** tmp = (node**)children;
+    const node_ref* tmp = child_array();
     for (uint8_t i = 0; i < deg; i++) {
-        if (tmp[i]->symbol() == base)
-            return tmp[i];
+        const node* c = deref(tmp[i]);
+        if (c->symbol() == base)
+            return c;
     }
     
     return NULL;
@@ -326,40 +581,63 @@ const node * node::get(int base) const {
 
 void node::get_children(node** c) {
     if (deg < 2)
-        c[0] = (node*)children;
-    else {
+        c[0] = only_child();
+    else if (deg < NODE_TABLE_DEGREE) {
+        node_ref* tmp = child_array();
         for (uint8_t i = 0; i < deg; i++)
-            c[i] = ((node**)children)[i];
+            c[i] = deref(tmp[i]);
+    } else {
+        node_ref* tmp = child_array();
+        for (uint8_t i = 0; i < NODE_TABLE_SIZE; i++) {
+            if (tmp[i])
+                *c++ = deref(tmp[i]);
+        }
     }
 }
 
 void node::get_children(const node** c) const {
     if (deg < 2)
-        c[0] = (const node*)children;
-    else {
+        c[0] = only_child();
+    else if (deg < NODE_TABLE_DEGREE) {
+        const node_ref* tmp = child_array();
         for (uint8_t i = 0; i < deg; i++)
-            c[i] = ((node**)children)[i];
+            c[i] = deref(tmp[i]);
+    } else {
+        const node_ref* tmp = child_array();
+        for (uint8_t i = 0; i < NODE_TABLE_SIZE; i++) {
+            if (tmp[i])
+                *c++ = deref(tmp[i]);
+        }
     }
 }
 
 void node::set_children(node** c, uint8_t count, node_allocator& allocator) {
     if (count != deg) {
-        if (deg > 1)
-            allocator.free_children((node**)children, deg);
+        node_ref* tmp = allocator.resize_children(
+            deg > 1 ? child_array() : NULL, deg, count);
         if (count > 1)
-            children = allocator.alloc_children(count);
+            set_child_array(tmp);
         deg = count;
     }
     
     if (deg == 0)
-        children = NULL;
+        set_only_child(NULL);
     else if (deg == 1) {
-        c[0]->par = this;
-        children = c[0];
+        c[0]->par = ref(this);
+        set_only_child(c[0]);
+    } else if (deg < NODE_TABLE_DEGREE) {
+        node_ref* tmp = child_array();
+        for (uint8_t i = 0; i < deg; i++) {
+            c[i]->par = ref(this);
+            tmp[i] = ref(c[i]);
+        }
     } else {
+        node_ref* tmp = child_array();
+        for (uint8_t i = 0; i < NODE_TABLE_SIZE; i++)
+            tmp[i] = ref(NULL);
         for (uint8_t i = 0; i < deg; i++) {
-            c[i]->par = this;
-            ((node**)children)[i] = c[i];
+            c[i]->par = ref(this);
+            tmp[c[i]->symbol()] = ref(c[i]);
         }
     }
 }
@@ -368,7 +646,7 @@ void node::set(int base, node* child, node_allocator& allocator) {
     // use this for debugging:
     //if (child && base != child->symbol())
     //    throw runtime_exception("given base does not match to the symbol of the given node");
-
+    
     node* tmp[256];
     uint32_t d = deg;
     uint8_t i;
@@ -395,26 +673,118 @@ void node::set(int base, node* child, node_allocator& allocator) {
 
 void node::set_base(uint32_t index, int base) {
 #ifdef NODE_COLLAPSING
-    uint32_t i = index >> 1;
-    uint32_t mask = 0xf << ((index & 1) << 2);
-    seq[i] = (seq[i] & mask) | (base << ((~index & 1) << 2));
+    uint8_t* p = sequence() + (index >> 2);
+    uint32_t shift = (index & 3) << 1;
+    *p = (*p & ~(3 << shift)) | ((base & 3) << shift);
 #endif
 }
 
 uint8_t node::get_base(uint32_t index) const {
 #ifdef NODE_COLLAPSING
-    uint32_t i = index >> 1;
-    return (seq[i] >> ((~index & 1) << 2)) & 0xf;
+    uint32_t start, end;
+    uint32_t l = 0;
+    uint32_t r = run_count();
+    
+    // find the last run starting at the index or before
+    while (l < r) {
+        uint32_t m = (l + r) >> 1;
+        get_run(m, start, end);
+        if (start <= index)
+            l = m + 1;
+        else
+            r = m;
+    }
+    
+    if (l > 0) {
+        get_run(l - 1, start, end);
+        if (index < end)
+            return NODE_N_SYMBOL;
+    }
+    
+    return (sequence()[index >> 2] >> ((index & 3) << 1)) & 3;
 #else
     return 0;
 #endif
 }
 
+uint32_t node::match(uint32_t offset, const uint8_t* bases, 
+    uint32_t count) const {
+#ifdef NODE_COLLAPSING
+    uint32_t n = std::min(count, len - offset);
+    uint32_t i = 0;
+    
+    // sequences with N runs are compared symbol by symbol
+    if (!has_runs()) {
+        for (; i < n && ((offset + i) & 3); i++) {
+            if (get_base(offset + i) != bases[i])
+                return i;
+        }
+        
+        // the offset is aligned to whole bytes here
+        const uint8_t* p = sequence() + ((offset + i) >> 2);
+        for (; (i + 32) <= n; i += 32, p += 8) {
+            uint64_t w = 0;
+            uint8_t any = 0;
+            for (uint32_t j = 0; j < 32; j++) {
+                w |= (uint64_t)bases[i + j] << (j << 1);
+                any |= bases[i + j];
+            }
+            
+            // there are no N symbols in the collapsed sequence
+            if (any & NODE_N_SYMBOL)
+                break;
+            
+            w ^= load_bases(p);
+            if (w)
+                return i + (__builtin_ctzll(w) >> 1);
+        }
+    }
+    
+    while (i < n && get_base(offset + i) == bases[i])
+        i++;
+    
+    return i;
+#else
+    return 0;
+#endif
+}
+
+void node::expand(char* dst, uint32_t count) const {
+#ifdef NODE_COLLAPSING
+    const uint8_t* p = sequence();
+    uint32_t start, end;
+    uint32_t i;
+    
+    for (i = 0; (i + 4) <= count; i += 4)
+        memcpy(dst + i, unpack_table.chars[*p++], 4);
+    
+    for (uint32_t j = 0; i < count; i++, j++)
+        dst[i] = unpack_table.chars[*p][j];
+    
+    for (i = 0; i < run_count(); i++) {
+        get_run(i, start, end);
+        if (start >= count)
+            break;
+        
+        memset(dst + start, utils::base2char(NODE_N_SYMBOL), 
+            std::min(end, count) - start);
+    }
+#endif
+}
+
 // ##################
 // dictionary methods
 // ##################
 
 dictionary::dictionary(bool indexed) {
+    init(indexed);
+}
+
+dictionary::~dictionary() {
+    release();
+}
+
+void dictionary::init(bool indexed) {
     if (indexed) {
         this->node_index = new indexed_node_allocator;
         this->allocator  = node_index;
@@ -423,11 +793,12 @@ dictionary::dictionary(bool indexed) {
         this->node_index = NULL;
     }
     
-    this->root = new node;
+    this->root = allocator->alloc_root();
     
     cur_node = root;
     cur_id = 0;
     offset = 0;
+    dpth = 0;
     
     addBufferSize = 4096;
     addBuffer = new uint8_t[addBufferSize];
@@ -444,33 +815,20 @@ dictionary::dictionary(bool indexed) {
     wnode = allocator->alloc(0, NULL);
 }
 
-dictionary::~dictionary() {
-    std::deque<node*> nodes;
-    nodes.push_back(root);
-    nodes.push_back(inode);
-    nodes.push_back(dnode);
-    nodes.push_back(wnode);
-    node* n;
-    
-    node* children[256];
-    
-    while (!nodes.empty()) {
-        n = nodes.back();
-        nodes.pop_back();
-        
-        n->get_children(children);
-        for (unsigned i = 0; i < n->degree(); i++)
-            nodes.push_back(children[i]);
-        
-        n->release_children(*allocator);
-        delete n;
-    }
-    
+void dictionary::release() {
+    // all nodes are owned by the allocator
     delete allocator;
     
     delete [] addBuffer;
 }
 
+void dictionary::clear() {
+    bool indexed = node_index != NULL;
+    
+    release();
+    init(indexed);
+}
+
 void dictionary::split_current() {
     if (addLen > 0)
         return;
@@ -481,7 +839,7 @@ void dictionary::split_current() {
 uint64_t dictionary::add(char c) {
     if (follow(c))
         return cur_id;
-
+    
     int base = utils::char2base(c);
     
     // we need to split the current node first if the it is collapsed
@@ -531,7 +889,7 @@ const node * dictionary::get(uint64_t id) const {
 bool dictionary::follow(char c) {
     if (addLen > 0)
         return false;
-
+    
     int base = utils::char2base(c);
     node* child = cur_node->child(base, offset);
     if (child)
@@ -549,6 +907,89 @@ bool dictionary::follow(char c) {
     return child;
 }
 
+/**
+ * Character to base conversion table.
+ */
+static struct base_table {
+    uint8_t bases[256];
+    
+    base_table() {
+        for (int i = 0; i < 256; i++)
+            bases[i] = utils::char2base(i);
+    }
+} base_table;
+
+size_t dictionary::follow_run(const char* s, size_t count) {
+    uint8_t bases[256];
+    size_t done = 0;
+    
+    if (addLen > 0)
+        return 0;
+    
+    while (done < count) {
+        size_t n = std::min(count - done, sizeof(bases));
+        size_t k = 0;
+        
+        for (size_t i = 0; i < n; i++)
+            bases[i] = base_table.bases[(uint8_t)s[done + i]];
+        
+        while (k < n) {
+            if (offset < cur_node->length()) {
+                uint32_t m = cur_node->match(offset, bases + k, n - k);
+                if (m == 0)
+                    return done + k;
+                
+                offset += m;
+                cur_id += m;
+                dpth   += m;
+                k      += m;
+            } else {
+                node* child = cur_node->get(bases[k]);
+                if (!child)
+                    return done + k;
+                
+                cur_node = child;
+                cur_id   = child->id();
+                offset   = 0;
+                dpth++;
+                k++;
+            }
+        }
+        
+        done += n;
+    }
+    
+    return done;
+}
+
+size_t dictionary::add_run(const char* s, size_t count, uint64_t id) {
+    size_t done = follow_run(s, count);
+    
+    while (done < count && cur_id < id) {
+        if (addLen == 0) {
+            add(s[done++]);
+            continue;
+        }
+        
+        // the rest of the phrase extends the pending collapsed node
+        size_t n = std::min(count - done, (size_t)(id - cur_id));
+        if ((addLen + n) > addBufferSize)
+            addBufferSize = utils::crealloc(&addBuffer, addBufferSize, 
+                std::max(addBufferSize << 1, addLen + n));
+        
+        for (size_t i = 0; i < n; i++)
+            addBuffer[addLen + i] = base_table.bases[(uint8_t)s[done + i]];
+        
+        addLen += n;
+        offset  = cur_node->length() + addLen;
+        cur_id  = cur_node->id() + offset;
+        dpth   += n;
+        done   += n;
+    }
+    
+    return done;
+}
+
 bool dictionary::can_follow(char c) {
     if (addLen > 0)
         return false;
@@ -579,6 +1020,10 @@ size_t dictionary::used_memory() const {
     return allocator->used_memory();
 }
 
+size_t dictionary::node_memory() const {
+    return allocator->node_memory();
+}
+
 size_t dictionary::used_nodes() const {
     return allocator->used_nodes();
 }
@@ -659,433 +1104,213 @@ void dictionary_view::reset_phrase() {
 // ##################
 
 node_index::node_index() {
-    root = NULL;
+    pages = NULL;
+    page_count = 0;
+    page_capacity = 0;
     count = 0;
+    mem = 0;
 }
 
 node_index::~node_index() {
-    free_tree(root);
-}
-
-node_index::rb_node::rb_node(node* n) {
-    this->n = n;
-    this->parent = NULL;
-    this->left = NULL;
-    this->right = NULL;
-    this->black = false;
-}
-
-node_index::iterator::iterator(rb_node* root) {
-    this->n = root;
-    this->state = 0;
-}
-
-node * node_index::iterator::next() {
-    while (n) {
-        if (state == 0 && n->left)
-            n = n->left;
-        else if (state == 0) {
-            state = 1;
-            return n->n;
-        } else if (state == 1 && n->right) {
-            n = n->right;
-            state = 0;
-        } else if (state == 1)
-            state = 2;
-        else if (n->parent && n == n->parent->left) {
-            state = 1;
-            n = n->parent;
-            return n->n;
-        } else
-            n = n->parent;
-    }
-    
-    return NULL;
-}
-
-node_index::rb_node * node_index::alloc_node(node* n) {
-    return new rb_node(n);
-}
-
-void node_index::free_node(rb_node* n) {
-    delete n;
-}
-
-void node_index::free_tree(rb_node* n) {
-    if (!n)
-        return;
-    
-    free_tree(n->left);
-    free_tree(n->right);
-    free_node(n);
+    clear();
 }
 
 void node_index::clear() {
-    free_tree(root);
-    root = NULL;
-    count = 0;
-}
-
-void node_index::insert(rb_node* n) {
-    if (root)
-        insert(root, n);
-    else
-        root = n;
+    for (size_t i = 0; i < page_count; i++) {
+        delete [] pages[i].nodes;
+        delete [] pages[i].offsets;
+    }
     
-    insert_normalize(n);
+    delete [] pages;
     
-    count++;
-}
-
-void node_index::insert(rb_node* tree, rb_node* n) {
-    uint64_t tid, nid = n->n->id();
-    
-    while (!n->parent) {
-        tid = tree->n->id();
-        if (nid == tid)
-            throw runtime_exception("duplicate id");
-        else if (nid < tid && tree->left)
-            tree = tree->left;
-        else if (nid < tid) {
-            tree->left = n;
-            n->parent = tree;
-        } else if (tree->right)
-            tree = tree->right;
-        else {
-            tree->right = n;
-            n->parent = tree;
-        }
-    }
+    pages = NULL;
+    page_count = 0;
+    page_capacity = 0;
+    count = 0;
+    mem = 0;
 }
 
-void node_index::insert_normalize(rb_node* n) {
-    rb_node* parent = n->parent;
-    rb_node* gp = grandparent(n);
-    rb_node* u = uncle(n);
-    
-    if (!parent)
-        n->black = true;
-    if (!parent || parent->black)
+void node_index::ensure_page(uint64_t id) {
+    size_t p = id >> NODE_INDEX_PAGE_BITS;
+    if (p < page_count)
         return;
     
-    if (u && !u->black) {
-        parent->black = true;
-        u->black = true;
-        gp->black = false;
-        insert_normalize(gp);
-    } else {
-        if (n == parent->right && parent == gp->left) {
-            rotate_left(parent);
-            n = n->left;
-        } else if (n == parent->left && parent == gp->right) {
-            rotate_right(parent);
-            n = n->right;
-        }
+    if (p >= page_capacity) {
+        size_t ncap = page_capacity ? page_capacity << 1 : 64;
+        while (ncap <= p)
+            ncap <<= 1;
         
-        parent = n->parent;
-        parent->black = true;
-        gp->black = false;
+        page* npages = new page[ncap];
+        if (page_count)
+            memcpy(npages, pages, page_count * sizeof(page));
+        delete [] pages;
         
-        if (n == parent->left)
-            rotate_right(gp);
-        else
-            rotate_left(gp);
+        mem += (ncap - page_capacity) * sizeof(page);
+        
+        pages = npages;
+        page_capacity = ncap;
     }
-}
-
-node_index::rb_node * node_index::grandparent(rb_node* n) {
-    if (n && n->parent)
-        return n->parent->parent;
-    
-    return NULL;
-}
-
-node_index::rb_node * node_index::uncle(rb_node* n) {
-    rb_node* gp = grandparent(n);
-    if (!gp)
-        return NULL;
     
-    if (n->parent == gp->left)
-        return gp->right;
+    node* floor = page_count ? last(page_count - 1) : NULL;
     
-    return gp->left;
-}
-
-void node_index::add(node* n) {
-    insert(alloc_node(n));
+    for (; page_count <= p; page_count++) {
+        page& pg = pages[page_count];
+        pg.floor = floor;
+        pg.nodes = NULL;
+        pg.offsets = NULL;
+        pg.count = 0;
+        pg.capacity = 0;
+    }
 }
 
-void node_index::remove(rb_node* n) {
-    // swap with predecessor if the node has both children
-    if (n->left && n->right) {
-        rb_node* tmp = pred(n);
-        n->n = tmp->n;
-        n = tmp;
-    }
+void node_index::grow(page& pg) {
+    uint32_t ncap = pg.capacity ? pg.capacity << 1 : 4;
+    node_ref* nnodes = new node_ref[ncap];
+    uint8_t* noffsets = new uint8_t[ncap];
     
-    rb_node* tmp = n->left ? n->left : n->right;
-    rb_node* parent = n->parent;
+    if (pg.count) {
+        memcpy(nnodes, pg.nodes, pg.count * sizeof(node_ref));
+        memcpy(noffsets, pg.offsets, pg.count);
+    }
     
-    // set the child's parent
-    if (tmp)    
-        tmp->parent = parent;
+    delete [] pg.nodes;
+    delete [] pg.offsets;
     
-    // move the only child (if any) to the parent
-    if (!parent) {
-        if (tmp)
-            tmp->black = true;
-        root = tmp;
-    } else if (n == parent->left)
-        parent->left = tmp;
-    else
-        parent->right = tmp;
+    mem += (ncap - pg.capacity) * (sizeof(node_ref) + 1);
     
-    if (is_black(n)) {
-        if (!is_black(tmp))
-            tmp->black = true;
-        else
-            remove_normalize(parent, tmp);
-    }
-    
-    free_node(n);
-    count--;
+    pg.nodes = nnodes;
+    pg.offsets = noffsets;
+    pg.capacity = ncap;
 }
 
-void node_index::remove_normalize(rb_node* parent, rb_node* n) {
-    if (!parent)
-        return;
-    
-    rb_node* sibling = parent->left == n ? parent->right : parent->left;
-    if (!is_black(sibling)) {
-        parent->black = false;
-        sibling->black = true;
-        if (sibling == parent->left)
-            rotate_right(parent);
-        else
-            rotate_left(parent);
-    }
-    
-    remove_normalize2(parent, n);
+node * node_index::last(size_t p) const {
+    const page& pg = pages[p];
+    return pg.count ? node::deref(pg.nodes[pg.count - 1]) : pg.floor;
 }
 
-void node_index::remove_normalize2(rb_node* parent, rb_node* n) {
-    rb_node* sibling = parent->left == n ? parent->right : parent->left;
-    
-    if (is_black(parent)
-        && is_black(sibling)
-        && is_black(sibling->left) 
-        && is_black(sibling->right)) {
-        sibling->black = false;
-        remove_normalize(parent->parent, parent);
-    } else if (!is_black(parent)
-        && is_black(sibling)
-        && is_black(sibling->left) 
-        && is_black(sibling->right)) {
-        sibling->black = false;
-        parent->black = true;
-    } else
-        remove_normalize3(parent, n);
-}
-
-void node_index::remove_normalize3(rb_node* parent, rb_node* n) {
-    rb_node* sibling = parent->left == n ? parent->right : parent->left;
-    
-    if (n == parent->left && is_black(sibling->right)) {
-        sibling->black = false;
-        sibling->left->black = true;
-        rotate_right(sibling);
-        sibling = sibling->parent;
-    } else if (n == parent->right && is_black(sibling->left)) {
-        sibling->black = false;
-        sibling->right->black = true;
-        rotate_left(sibling);
-        sibling = sibling->parent;
-    }
+void node_index::update_floors(size_t p) {
+    node* n = last(p);
     
-    sibling->black = parent->black;
-    parent->black = true;
-    
-    if (n == parent->left) {
-        sibling->right->black = true;
-        rotate_left(parent);
-    } else {
-        sibling->left->black = true;
-        rotate_right(parent);
+    for (size_t i = p + 1; i < page_count; i++) {
+        pages[i].floor = n;
+        if (pages[i].count)
+            break;
     }
 }
 
-void node_index::rotate_left(rb_node* n) {
-    rb_node* parent = n->parent;
-    rb_node* right = n->right;
+void node_index::add(node* n) {
+    uint64_t id = n->id();
+    size_t p = id >> NODE_INDEX_PAGE_BITS;
+    uint8_t offset = id & ((1 << NODE_INDEX_PAGE_BITS) - 1);
     
-    n->right = right->left;
-    if (n->right)
-        n->right->parent = n;
+    ensure_page(id);
     
-    right->left = n;
-    right->parent = parent;
-    n->parent = right;
+    page& pg = pages[p];
+    if (pg.count == pg.capacity)
+        grow(pg);
     
-    if (!parent)
-        root = right;
-    else if (n == parent->left)
-        parent->left = right;
-    else
-        parent->right = right;
-}
-
-void node_index::rotate_right(rb_node* n) {
-    rb_node* parent = n->parent;
-    rb_node* left = n->left;
-    
-    n->left = left->right;
-    if (n->left)
-        n->left->parent = n;
+    // nodes are usually appended at the end
+    uint32_t i = pg.count;
+    for (; i > 0 && pg.offsets[i - 1] > offset; i--) {
+        pg.nodes[i] = pg.nodes[i - 1];
+        pg.offsets[i] = pg.offsets[i - 1];
+    }
     
-    left->right = n;
-    left->parent = parent;
-    n->parent = left;
+    pg.nodes[i] = node::ref(n);
+    pg.offsets[i] = offset;
+    pg.count++;
+    count++;
     
-    if (!parent)
-        root = left;
-    else if (n == parent->left)
-        parent->left = left;
-    else
-        parent->right = left;
-}
-
-bool node_index::is_black(rb_node* n) {
-    return !n || n->black;
+    if ((i + 1) == pg.count)
+        update_floors(p);
 }
 
 void node_index::remove(node* n) {
-    uint64_t cid, nid = n->id();
-    rb_node* current = root;
-    
-    while (current && nid != (cid = current->n->id())) {
-        if (nid < cid)
-            current = current->left;
-        else
-            current = current->right;
-    }
-    
-    if (current)
-        remove(current);
-}
-
-node_index::rb_node * node_index::pred(rb_node* n) {
-    if (n->left)
-        return max(n->left);
-    
-    rb_node* prev;
+    size_t p = n->id() >> NODE_INDEX_PAGE_BITS;
+    if (p >= page_count)
+        return;
     
-    while ((prev = n->parent)) {
-        if (prev->right == n)
-            return prev;
-        n = prev;
-    }
+    page& pg = pages[p];
+    uint32_t i = 0;
+    while (i < pg.count && pg.nodes[i] != node::ref(n))
+        i++;
     
-    return NULL;
-}
-
-node_index::rb_node * node_index::max(rb_node* tree) {
-    if (!tree)
-        return NULL;
+    if (i == pg.count)
+        return;
     
-    while (tree->right)
-        tree = tree->right;
+    // floors of the following pages refer to the last node of this page
+    bool last = i == pg.count - 1;
     
-    return tree;
-}
-
-node * node_index::get(uint64_t id) {
-    if (!root)
-        return NULL;
+    pg.count--;
+    count--;
     
-    rb_node* prev = NULL;
-    rb_node* current = root;
-    uint64_t cid;
-    
-    while (current != prev) {
-        cid = current->n->id();
-        prev = current;
-        if (id < cid && current->left)
-            current = current->left;
-        else if (id > cid && current->right)
-            current = current->right;
+    for (; i < pg.count; i++) {
+        pg.nodes[i] = pg.nodes[i + 1];
+        pg.offsets[i] = pg.offsets[i + 1];
     }
     
-    if (cid <= id)
-        return current->n;
-    
-    current = pred(current);
-    if (current)
-        return current->n;
-    
-    return NULL;
-}
-
-node_index::iterator node_index::begin() {
-    return iterator(root);
-}
-
-void node_index::print() {
-    print(root);
-    printf("\n");
+    if (last)
+        update_floors(p);
 }
 
-void node_index::print(rb_node* n) {
-    if (n) {
-        printf("(");
-        print(n->left);
-        printf(" %lu", n->n->id());
-        if (n->black)
-            printf("B ");
-        else
-            printf("R ");
-        print(n->right);
-        printf(")");
-    } else
-        printf("NULL");
-}
-
-void node_index::validate() {
-    if (!root)
-        return;
-    if (!root->black)
-        throw runtime_exception("root is red");
+node * node_index::get(uint64_t id) const {
+    if (!page_count)
+        return NULL;
     
-    validate(root, -1, 0);
-}
-
-int node_index::validate(rb_node* n, int bdepth, int cdepth) {
-    if (!n) {
-        if (bdepth == -1 || bdepth == cdepth)
-            return cdepth;
+    size_t p = id >> NODE_INDEX_PAGE_BITS;
+    uint32_t offset = id & ((1 << NODE_INDEX_PAGE_BITS) - 1);
+    
+    // IDs beyond the last page belong to the last indexed node
+    if (p >= page_count)
+        return last(page_count - 1);
+    
+    // find the first node with greater offset
+    const page& pg = pages[p];
+    uint32_t l = 0;
+    uint32_t r = pg.count;
+    uint32_t m;
+    while (l < r) {
+        m = (l + r) >> 1;
+        if (pg.offsets[m] <= offset)
+            l = m + 1;
         else
-            throw runtime_exception("black depth violated");
+            r = m;
     }
     
-    if (is_black(n))
-        cdepth++;
-    else if (!is_black(n->left) || !is_black(n->right))
-        throw runtime_exception("red node has a red child");
-    
-    bdepth = validate(n->left, bdepth, cdepth);
-    return validate(n->right, bdepth, cdepth);
+    return l ? node::deref(pg.nodes[l - 1]) : pg.floor;
 }
 
 // ######################
 // node allocator methods
 // ######################
 
-node_allocator::node_allocator() {
+#ifdef COMPACT_NODES
+node_allocator::node_allocator() 
+    : node_arena(sizeof(node), &node::node_region), 
+      pool(&node::sequence_region) {
+#else
+node_allocator::node_allocator() 
+    : node_arena(sizeof(node)) {
+#endif
     this->nodes = 0;
     this->mem = 0;
+    
+    for (int i = 0; i < 256; i++)
+        child_arenas[i] = NULL;
+}
+
+node_allocator::~node_allocator() {
+    // nodes own no other memory than the arenas and the sequence pool
+    for (int i = 0; i < 256; i++)
+        delete child_arenas[i];
+}
+
+node * node_allocator::alloc_root() {
+    return new (node_arena.alloc()) node();
 }
 
 node * node_allocator::alloc(uint8_t sym, node* parent) {
-    node* n = new node(nodes++, sym, parent);
+    node* n = new (node_arena.alloc()) node(nodes++, sym, parent);
     insert(n);
     
     mem += n->size();
@@ -1098,10 +1323,10 @@ node * node_allocator::alloc(uint8_t* phrase, uint32_t len, node* parent) {
     if (len == 0)
         return NULL;
     else if (len == 1)
-        n = new node(nodes++, phrase[0], parent);
+        n = new (node_arena.alloc()) node(nodes++, phrase[0], parent);
     else
 #ifdef NODE_COLLAPSING
-        n = new node(nodes++, phrase, len, parent);
+        n = new (node_arena.alloc()) node(nodes++, phrase, len, parent, pool);
 #else
         throw runtime_exception("node collapsing is disabled");
 #endif
@@ -1128,12 +1353,14 @@ node * node_allocator::split(node* n, uint32_t at) {
     id += at + 1;
     
     if ((at + 1) == len)
-        child = new node(id, base, n->phrase_length(), n);
+        child = new (node_arena.alloc()) 
+            node(id, base, n->phrase_length(), n);
     else
-        child = new node(n, at + 1, len - at - 1, n->phrase_length(), n);
+        child = new (node_arena.alloc()) 
+            node(n, at + 1, len - at - 1, n->phrase_length(), n, pool);
     
     mem -= n->size();
-    n->shrink(at);
+    n->shrink(at, pool);
     mem += n->size();
     mem += child->size();
     
@@ -1155,7 +1382,7 @@ node * node_allocator::split(node* n, uint32_t at) {
 void node_allocator::append(node* n, uint8_t sym) {
 #ifdef NODE_COLLAPSING
     mem -= n->size();
-    n->append(sym);
+    n->append(sym, pool);
     mem += n->size();
     nodes++;
 #else
@@ -1166,7 +1393,7 @@ void node_allocator::append(node* n, uint8_t sym) {
 void node_allocator::append(node* n, uint8_t* phrase, uint32_t len) {
 #ifdef NODE_COLLAPSING
     mem -= n->size();
-    n->append(phrase, len);
+    n->append(phrase, len, pool);
     mem += n->size();
     nodes += len;
 #else
@@ -1174,16 +1401,49 @@ void node_allocator::append(node* n, uint8_t* phrase, uint32_t len) {
 #endif
 }
 
-node ** node_allocator::alloc_children(uint8_t count) {
-    node** result = new node*[count];
-    mem += count * sizeof(node*);
+node_ref * node_allocator::alloc_children(uint8_t count) {
+    uint8_t width = count < NODE_TABLE_DEGREE ? count : NODE_TABLE_SIZE;
+    slab_arena* arena = child_arenas[width];
+    if (!arena) {
+#ifdef COMPACT_NODES
+        arena = new slab_arena(width * sizeof(node_ref), &node::link_region);
+#else
+        arena = new slab_arena(width * sizeof(node_ref));
+#endif
+        child_arenas[width] = arena;
+    }
     
-    return result;
+    // memory is accounted by the number of children, so it does not depend 
+    // on the representation of children
+    mem += count * NODE_NOMINAL_LINK_SIZE;
+    
+    node_ref* children = (node_ref*)arena->alloc();
+    if (count >= NODE_TABLE_DEGREE) {
+        for (uint8_t i = 0; i < NODE_TABLE_SIZE; i++)
+            children[i] = node::ref(NULL);
+    }
+    
+    return children;
 }
 
-void node_allocator::free_children(node** children, uint8_t count) {
-    delete [] children;
-    mem -= count * sizeof(node*);
+void node_allocator::free_children(node_ref* children, uint8_t count) {
+    uint8_t width = count < NODE_TABLE_DEGREE ? count : NODE_TABLE_SIZE;
+    child_arenas[width]->free(children);
+    mem -= count * NODE_NOMINAL_LINK_SIZE;
+}
+
+node_ref * node_allocator::resize_children(node_ref* children, 
+    uint8_t count, uint8_t ncount) {
+    if (count >= NODE_TABLE_DEGREE && ncount >= NODE_TABLE_DEGREE) {
+        mem += ncount * NODE_NOMINAL_LINK_SIZE;
+        mem -= count * NODE_NOMINAL_LINK_SIZE;
+        return children;
+    }
+    
+    if (count > 1)
+        free_children(children, count);
+    
+    return ncount > 1 ? alloc_children(ncount) : NULL;
 }
 
 simple_node_allocator::simple_node_allocator() {
@@ -23,17 +23,11 @@ THE SOFTWARE.
 #include <cmath>
 
 #include "encoder.hpp"
+#include "utils.hpp"
 
 using namespace alzw;
 
-encoder::encoder(int sync_period)
-    : dict(false) {
-    this->sync_period = sync_period;
-    
-    ndel = 0;
-    nins = 0;
-    nmm = 0;
-    
+encoder_stats::encoder_stats() {
     nmatches = 0;
     nmismatches = 0;
     ninserts = 0;
@@ -51,9 +45,53 @@ encoder::encoder(int sync_period)
     nmmbits = 0;
     nibits = 0;
     ndbits = 0;
+}
+
+encoder_stats& encoder_stats::operator+=(const encoder_stats& s) {
+    nmatches += s.nmatches;
+    nmismatches += s.nmismatches;
+    ninserts += s.ninserts;
+    ndeletes += s.ndeletes;
+    
+    nmmseqs += s.nmmseqs;
+    nmseqs += s.nmseqs;
+    niseqs += s.niseqs;
+    ndseqs += s.ndseqs;
+    
+    nmmouts += s.nmmouts;
+    niouts += s.niouts;
+    ndouts += s.ndouts;
+    
+    nmmbits += s.nmmbits;
+    nibits += s.nibits;
+    ndbits += s.ndbits;
+    
+    return *this;
+}
+
+encoder::encoder(int sync_period)
+    : own_dict(new dictionary(false))
+    , dict(*own_dict) {
+    this->sync_period = sync_period;
+    
+    index = NULL;
+    seq = 0;
+    
+    sync_map = NULL;
+    roffset = 0;
+    aoffset = 0;
+    next_sp = 0;
+    smi = 0;
+    
+    ndel = 0;
+    nins = 0;
+    nmm = 0;
     
     width = (int)ceil(log(dict.used_nodes()) / log(2));
     
+    coder     = CODER_FIXED;
+    cw_writer = codeword_writer::create(coder);
+    
     last_op = -1;
     
     fmismatch = false;
@@ -61,6 +99,55 @@ encoder::encoder(int sync_period)
     fwidth_inc = false;
 }
 
+encoder::encoder(int sync_period, dictionary& d, int width)
+    : own_dict(NULL)
+    , dict(d) {
+    this->sync_period = sync_period;
+    this->width = width;
+    
+    index = NULL;
+    seq = 0;
+    
+    sync_map = NULL;
+    roffset = 0;
+    aoffset = 0;
+    next_sp = 0;
+    smi = 0;
+    
+    ndel = 0;
+    nins = 0;
+    nmm = 0;
+    
+    coder     = CODER_FIXED;
+    cw_writer = codeword_writer::create(coder);
+    
+    last_op = -1;
+    
+    dict.reset_phrase();
+    
+    // the width is incremented before adding the first node which does not 
+    // fit into the previous width
+    uint64_t next = dict.next_id();
+    
+    fmismatch = false;
+    fnew_node = false;
+    fwidth_inc = next == ((uint64_t)1 << (width - 1));
+}
+
+encoder::~encoder() {
+    delete own_dict;
+    delete cw_writer;
+}
+
+void encoder::set_coder(uint8_t coder) {
+    codeword_writer* writer = codeword_writer::create(coder);
+    
+    delete cw_writer;
+    
+    this->coder = coder;
+    cw_writer   = writer;
+}
+
 static void next_sync_point(size_t& current, 
     size_t& index, std::vector<uint32_t>* sync_map, size_t sync_period) {
     if (sync_map && sync_period) {
@@ -74,26 +161,63 @@ static void next_sync_point(size_t& current,
 
 void encoder::encode(const std::string& rseq, const std::string& aseq, 
     bwriter& out, std::vector<uint32_t>* sync_map) {
-    size_t alen = aseq.size();
-    size_t roffset = 0;
-    size_t next_sp = 0;
-    size_t smi = 0;
-    char c1, c2;
+    begin_sequence(out, sync_map);
+    encode_block(rseq.data(), aseq.data(), aseq.size(), out);
+    end_sequence(out);
+}
+
+void encoder::begin_sequence(bwriter& out, std::vector<uint32_t>* sync_map) {
+    this->sync_map = sync_map;
+    
+    roffset = 0;
+    aoffset = 0;
+    next_sp = 0;
+    smi = 0;
     
     next_sync_point(next_sp, smi, sync_map, sync_period);
+    add_seek_point(0, 0, out);
     
-    for (size_t i = 0; i < alen; i++) {
-        c1 = rseq[i];
-        c2 = aseq[i];
+    cw_writer->begin_sequence(out);
+}
+
+void encoder::encode_block(const char* rblock, const char* ablock, 
+    size_t len, bwriter& out) {
+    char c1, c2;
+    
+    for (size_t i = 0; i < len; i++) {
+        c1 = rblock[i];
+        c2 = ablock[i];
+        
+        // fast path for runs of matches which can be followed in the 
+        // dictionary (the run must not cross the next synchronization point)
+        if (c1 == c2 && last_op == OP_MATCH && c1 != '-') {
+            size_t n = utils::match_run(rblock + i, ablock + i, len - i);
+            if (next_sp > roffset)
+                n = std::min(n, next_sp - roffset);
+            else if (next_sp > 0 && next_sp == roffset)
+                n = 0;
+            
+            size_t m = n > 0 ? follow_matches(ablock + i, n) : 0;
+            if (m > 0) {
+                roffset += m;
+                aoffset += m;
+                i += m - 1;
+                continue;
+            }
+        }
         
         if (c1 != '-') {
             if (next_sp > 0 && next_sp == roffset) {
                 next_sync_point(next_sp, smi, sync_map, sync_period);
                 sync(out);
+                add_seek_point(roffset, aoffset, out);
             }
             roffset++;
         }
         
+        if (c2 != '-')
+            aoffset++;
+        
         if (c1 == '-')
             ins(c2, out);
         else if (c2 == '-')
@@ -103,8 +227,30 @@ void encoder::encode(const std::string& rseq, const std::string& aseq,
         else
             mismatch(c2, out);
     }
-    
+}
+
+void encoder::end_sequence(bwriter& out) {
     flush(out);
+    cw_writer->end_sequence(out);
+    
+    seq++;
+}
+
+void encoder::reset_dictionary() {
+    dict.clear();
+    ins_queue.clear();
+    
+    ndel = 0;
+    nins = 0;
+    nmm = 0;
+    
+    width = (int)ceil(log(dict.used_nodes()) / log(2));
+    
+    last_op = -1;
+    
+    fmismatch = false;
+    fnew_node = false;
+    fwidth_inc = false;
 }
 
 void encoder::match(char c, bwriter& out) {
@@ -116,9 +262,9 @@ void encoder::match(char c, bwriter& out) {
     flush_del(out);
     
     if (last_op != OP_MATCH)
-        nmseqs++;
+        stats.nmseqs++;
     if (last_op != OP_MATCH && last_op != OP_MISMATCH)
-        nmmseqs++;
+        stats.nmmseqs++;
     last_op = OP_MATCH;
     
     if (!fmismatch) {
@@ -157,7 +303,25 @@ void encoder::match(char c, bwriter& out) {
     }
     
     nmm++;
-    nmatches++;
+    stats.nmatches++;
+}
+
+size_t encoder::follow_matches(const char* s, size_t len) {
+    uint64_t next = dict.next_id();
+    size_t m = dict.follow_run(s, len);
+    
+    if (m == 0)
+        return 0;
+    
+    // following existing transitions has the same effect as match() except
+    // that adding of the next node (if allowed) is postponed
+    if (!fmismatch && (next & (next - 1)) != 0)
+        fnew_node = false;
+    
+    nmm += m;
+    stats.nmatches += m;
+    
+    return m;
 }
 
 void encoder::mismatch(char c, bwriter& out) {
@@ -165,7 +329,7 @@ void encoder::mismatch(char c, bwriter& out) {
     flush_del(out);
     
     if (last_op != OP_MATCH && last_op != OP_MISMATCH)
-        nmmseqs++;
+        stats.nmmseqs++;
     last_op = OP_MISMATCH;
     
     fmismatch = true;
@@ -179,7 +343,7 @@ void encoder::mismatch(char c, bwriter& out) {
     }
     
     nmm++;
-    nmismatches++;
+    stats.nmismatches++;
 }
 
 void encoder::ins(char c, bwriter& out) {
@@ -187,7 +351,7 @@ void encoder::ins(char c, bwriter& out) {
     flush_del(out);
     
     if (last_op != OP_INS)
-        niseqs++;
+        stats.niseqs++;
     last_op = OP_INS;
     
     if (dict.follow(c))
@@ -199,7 +363,7 @@ void encoder::ins(char c, bwriter& out) {
         nins = 1;
     }
     
-    ninserts++;
+    stats.ninserts++;
 }
 
 void encoder::del(bwriter& out) {
@@ -207,30 +371,28 @@ void encoder::del(bwriter& out) {
     flush_ins(out);
     
     if (last_op != OP_DEL)
-        ndseqs++;
+        stats.ndseqs++;
     last_op = OP_DEL;
     
     ndel++;
-    ndeletes++;
+    stats.ndeletes++;
 }
 
 void encoder::out_mm(size_t id, bwriter& out) {
-    out.write(id, width);
-    nmmbits += width;
-    nmmouts++;
+    stats.nmmbits += cw_writer->write_cw(id, width, out);
+    stats.nmmouts++;
 }
 
 void encoder::out_ins(size_t id, bwriter& out) {
     ins_queue.push_back(id);
-    niouts++;
+    stats.niouts++;
 }
 
 void encoder::out_del(size_t size, bwriter& out) {
     const node* dnode = dict.get_dnode();
-    out.write(dnode->id(), width);
-    ndbits += out.write_delta(size);
-    ndbits += width;
-    ndouts++;
+    stats.ndbits += cw_writer->write_cw(dnode->id(), width, out);
+    stats.ndbits += cw_writer->write_del_length(size, out);
+    stats.ndouts++;
 }
 
 void encoder::flush_mm(bwriter& out) {
@@ -257,15 +419,12 @@ void encoder::flush_ins(bwriter& out) {
         return;
     
     const node* inode = dict.get_inode();
-    out.write(inode->id(), width);
-    nibits += width;
-    
-    nibits += out.write_delta(ins_queue.size());
+    stats.nibits += cw_writer->write_cw(inode->id(), width, out);
+    stats.nibits += cw_writer->write_ins_count(ins_queue.size(), out);
     
     while (!ins_queue.empty()) {
-        out.write(ins_queue.front(), width);
+        stats.nibits += cw_writer->write_ins_cw(ins_queue.front(), width, out);
         ins_queue.pop_front();
-        nibits += width;
     }
 }
 
@@ -290,3 +449,220 @@ void encoder::sync(bwriter& out) {
     flush_del(out);
 }
 
+void encoder::add_seek_point(size_t roffset, size_t aoffset, bwriter& out) {
+    if (!index)
+        return;
+    
+    seek_point p;
+    p.offset  = out.tell();
+    p.next_id = dict.next_id();
+    p.roffset = roffset;
+    p.aoffset = aoffset;
+    p.seq     = seq;
+    p.width   = width;
+    
+    index->add(p);
+}
+
+frozen_encoder::frozen_encoder(const encoder& enc)
+    : dict(enc.get_dictionary()) {
+    sync_period = enc.get_sync_period();
+    next_id = enc.get_dictionary().next_id();
+    width = enc.get_width();
+    
+    cw_writer = codeword_writer::create(enc.get_coder());
+    
+    sync_map = NULL;
+    points   = NULL;
+    roffset  = 0;
+    aoffset  = 0;
+    next_sp  = 0;
+    smi      = 0;
+    
+    ndel = 0;
+    nins = 0;
+    nmm = 0;
+    
+    last_op = -1;
+}
+
+frozen_encoder::~frozen_encoder() {
+    delete cw_writer;
+}
+
+void frozen_encoder::encode(const std::string& rseq, const std::string& aseq, 
+    bwriter& out, std::vector<uint32_t>* sync_map, 
+    uint32_t seq, std::vector<seek_point>* points) {
+    begin_sequence(out, sync_map, seq, points);
+    encode_block(rseq.data(), aseq.data(), aseq.size(), out);
+    end_sequence(out);
+}
+
+void frozen_encoder::begin_sequence(bwriter& out, 
+    std::vector<uint32_t>* sync_map, uint32_t seq, 
+    std::vector<seek_point>* points) {
+    this->sync_map = sync_map;
+    this->points   = points;
+    
+    roffset = 0;
+    aoffset = 0;
+    next_sp = 0;
+    smi = 0;
+    
+    point.next_id = next_id;
+    point.seq     = seq;
+    point.width   = width;
+    
+    next_sync_point(next_sp, smi, sync_map, sync_period);
+    
+    if (points) {
+        point.offset  = out.tell();
+        point.roffset = 0;
+        point.aoffset = 0;
+        points->push_back(point);
+    }
+    
+    cw_writer->begin_sequence(out);
+}
+
+void frozen_encoder::encode_block(const char* rblock, const char* ablock, 
+    size_t len, bwriter& out) {
+    char c1, c2;
+    
+    for (size_t i = 0; i < len; i++) {
+        c1 = rblock[i];
+        c2 = ablock[i];
+        
+        if (c1 != '-') {
+            if (next_sp > 0 && next_sp == roffset) {
+                next_sync_point(next_sp, smi, sync_map, sync_period);
+                flush(out);
+                if (points) {
+                    point.offset  = out.tell();
+                    point.roffset = roffset;
+                    point.aoffset = aoffset;
+                    points->push_back(point);
+                }
+            }
+            roffset++;
+        }
+        
+        if (c2 != '-')
+            aoffset++;
+        
+        if (c1 == '-')
+            ins(c2, out);
+        else if (c2 == '-')
+            del(out);
+        else
+            mm(c2, c1 == c2, out);
+    }
+}
+
+void frozen_encoder::end_sequence(bwriter& out) {
+    flush(out);
+    cw_writer->end_sequence(out);
+}
+
+void frozen_encoder::mm(char c, bool match, bwriter& out) {
+    flush_ins(out);
+    flush_del(out);
+    
+    if (match && last_op != OP_MATCH)
+        stats.nmseqs++;
+    if (last_op != OP_MATCH && last_op != OP_MISMATCH)
+        stats.nmmseqs++;
+    last_op = match ? OP_MATCH : OP_MISMATCH;
+    
+    if (!dict.follow(c)) {
+        flush_mm(out);
+        dict.follow(c);
+    }
+    
+    nmm++;
+    if (match)
+        stats.nmatches++;
+    else
+        stats.nmismatches++;
+}
+
+void frozen_encoder::ins(char c, bwriter& out) {
+    flush_mm(out);
+    flush_del(out);
+    
+    if (last_op != OP_INS)
+        stats.niseqs++;
+    last_op = OP_INS;
+    
+    if (dict.follow(c))
+        nins++;
+    else {
+        ins_queue.push_back(dict.get_id());
+        stats.niouts++;
+        dict.reset_phrase();
+        dict.follow(c);
+        nins = 1;
+    }
+    
+    stats.ninserts++;
+}
+
+void frozen_encoder::del(bwriter& out) {
+    flush_mm(out);
+    flush_ins(out);
+    
+    if (last_op != OP_DEL)
+        stats.ndseqs++;
+    last_op = OP_DEL;
+    
+    ndel++;
+    stats.ndeletes++;
+}
+
+void frozen_encoder::flush_mm(bwriter& out) {
+    if (nmm == 0)
+        return;
+    
+    stats.nmmbits += cw_writer->write_cw(dict.get_id(), width, out);
+    stats.nmmouts++;
+    
+    dict.reset_phrase();
+    nmm = 0;
+}
+
+void frozen_encoder::flush_ins(bwriter& out) {
+    if (nins > 0) {
+        ins_queue.push_back(dict.get_id());
+        stats.niouts++;
+        dict.reset_phrase();
+        nins = 0;
+    }
+    
+    if (ins_queue.empty())
+        return;
+    
+    stats.nibits += cw_writer->write_cw(dict.get_inode()->id(), width, out);
+    stats.nibits += cw_writer->write_ins_count(ins_queue.size(), out);
+    
+    while (!ins_queue.empty()) {
+        stats.nibits += cw_writer->write_ins_cw(ins_queue.front(), width, out);
+        ins_queue.pop_front();
+    }
+}
+
+void frozen_encoder::flush_del(bwriter& out) {
+    if (ndel == 0)
+        return;
+    
+    stats.ndbits += cw_writer->write_cw(dict.get_dnode()->id(), width, out);
+    stats.ndbits += cw_writer->write_del_length(ndel, out);
+    stats.ndouts++;
+    
+    ndel = 0;
+}
+
+void frozen_encoder::flush(bwriter& out) {
+    flush_mm(out);
+    flush_ins(out);
+    flush_del(out);
+}
@@ -21,6 +21,7 @@ THE SOFTWARE.
 */
 
 #include <sstream>
+#include <algorithm>
 #include <cstring>
 
 #include "fasta-alignment.hpp"
@@ -28,6 +29,24 @@ THE SOFTWARE.
 
 using namespace alzw;
 
+/**
+ * Check if a given character is a valid DNA alignment symbol.
+ *
+ * @param c upper-case character
+ * @returns true if the character is a valid symbol
+ */
+static bool is_symbol(char c) {
+    switch (c) {
+        case 'A':
+        case 'C':
+        case 'G':
+        case 'T':
+        case 'N':
+        case '-': return true;
+        default:  return false;
+    }
+}
+
 fasta_alignment fasta_alignment::load(FILE* file) {
     std::stringstream seq_stream;
     fasta_alignment result;
@@ -47,15 +66,10 @@ fasta_alignment fasta_alignment::load(FILE* file) {
                 if (isspace(c))
                     continue;
                 
-                switch (c) {
-                    case 'A':
-                    case 'C':
-                    case 'G':
-                    case 'T':
-                    case 'N':
-                    case '-': seq_stream << c; break;
-                    default:  throw parse_exception("unexpected DNA alignment character: %c", c);
-                }
+                if (!is_symbol(c))
+                    throw parse_exception("unexpected DNA alignment character: %c", c);
+                
+                seq_stream << c;
             }
         }
     }
@@ -85,3 +99,288 @@ fasta_alignment fasta_alignment::load(const char* file) {
     return result;
 }
 
+/**
+ * Find the first symbol of a sequence starting at a given offset (header 
+ * lines of empty sequences and blank lines are skipped).
+ *
+ * @param file stream
+ * @param pos  offset of a header line or the beginning of the file
+ * @returns offset of the first symbol or -1 if there is none
+ */
+static long first_symbol(FILE* file, long pos) {
+    bool bol = true;
+    int c;
+    
+    if (fseek(file, pos, SEEK_SET))
+        throw io_exception("error while reading from a file");
+    
+    for (; (c = getc(file)) != EOF; pos++) {
+        if (bol && c == '>') {
+            while ((c = getc(file)) != EOF && c != '\n')
+                pos++;
+            pos++;
+        } else if (!isspace(c))
+            return pos;
+        
+        bol = c == '\n';
+    }
+    
+    if (ferror(file))
+        throw io_exception("error while reading from a file");
+    
+    return -1;
+}
+
+/**
+ * Find the first header line starting within a given range of file offsets 
+ * after a given symbol and followed by a non-empty sequence.
+ *
+ * @param file  stream
+ * @param from  the first offset (at least 1)
+ * @param to    end of the range
+ * @param after offset of the first symbol of the reference sequence
+ * @returns offset of the header line or -1 if there is no such line
+ */
+static long find_header(FILE* file, long from, long to, long after) {
+    char buffer[4097];
+    size_t len = to - from + 1;
+    
+    if (fseek(file, from - 1, SEEK_SET) || fread(buffer, 1, len, file) != len)
+        throw io_exception("error while reading from a file");
+    
+    for (long i = 1; i < (long)len; i++) {
+        if (buffer[i] == '>' && buffer[i - 1] == '\n' 
+            && (from + i - 1) > after 
+            && first_symbol(file, from + i - 1) >= 0)
+            return from + i - 1;
+    }
+    
+    return -1;
+}
+
+/**
+ * Find the header line of the second sequence of a given pairwise 
+ * alignment. Both sequences have the same number of symbols, so the file is 
+ * searched starting from its middle in both directions and usually only 
+ * a small part of the file is read. Header lines of empty sequences are 
+ * ignored.
+ *
+ * @param file stream
+ * @returns offset of the header line or -1 if there is no such line
+ */
+static long find_second_header(FILE* file) {
+    long size, lo, hi, next, res;
+    long after = first_symbol(file, 0);
+    
+    if (after < 0)
+        return -1;
+    if (fseek(file, 0, SEEK_END) || (size = ftell(file)) < 0)
+        throw io_exception("error while reading from a file");
+    
+    lo = hi = std::max(size >> 1, 1L);
+    
+    while (lo > 1 || hi < size) {
+        if (hi < size) {
+            next = std::min(size, hi + 4096);
+            if ((res = find_header(file, hi, next, after)) >= 0)
+                return res;
+            hi = next;
+        }
+        
+        if (lo > 1) {
+            next = std::max(1L, lo - 4096);
+            if ((res = find_header(file, next, lo, after)) >= 0)
+                return res;
+            lo = next;
+        }
+    }
+    
+    return -1;
+}
+
+void fasta_alignment_reader::sequence_stream::seek(long pos) {
+    if (fseek(file, pos, SEEK_SET))
+        throw io_exception("error while reading from a file");
+    
+    reset(pos);
+}
+
+void fasta_alignment_reader::sequence_stream::reset(long pos) {
+    base    = pos;
+    offset  = 0;
+    size    = 0;
+    bol     = true;
+    end     = false;
+    started = false;
+}
+
+void fasta_alignment_reader::sequence_stream::skip_line() {
+    for (size_t len = 1; offset < size || fill(); len++) {
+        if (buffer[offset++] == '\n')
+            break;
+        if (len >= 4095)
+            throw parse_exception("comment line is too long, maximum supported length is 4095 characters");
+    }
+    
+    bol = true;
+}
+
+bool fasta_alignment_reader::sequence_stream::skip_empty(long pos) {
+    while (pos < 0 || tell() < pos) {
+        if (offset >= size && !fill())
+            return pos < 0;
+        
+        if (bol && buffer[offset] == '>')
+            skip_line();
+        else if (isspace(buffer[offset]))
+            bol = buffer[offset++] == '\n';
+        else
+            return false;
+    }
+    
+    return tell() == pos;
+}
+
+bool fasta_alignment_reader::sequence_stream::fill() {
+    base  += size;
+    size   = fread(buffer, 1, sizeof(buffer), file);
+    offset = 0;
+    
+    if (size == 0 && ferror(file))
+        throw io_exception("error while reading from a file");
+    
+    return size > 0;
+}
+
+size_t fasta_alignment_reader::sequence_stream::read(char* symbols, 
+    size_t count) {
+    size_t res = 0;
+    char c;
+    
+    while (res < count && !end) {
+        if (offset >= size && !fill()) {
+            end = true;
+            break;
+        }
+        
+        // header lines of empty sequences are skipped
+        c = buffer[offset];
+        if (bol && c == '>' && started) {
+            end = true;
+            break;
+        } else if (bol && c == '>') {
+            skip_line();
+            continue;
+        }
+        
+        offset++;
+        bol = c == '\n';
+        
+        c = toupper(c);
+        if (isspace(c))
+            continue;
+        
+        if (!is_symbol(c))
+            throw parse_exception("unexpected DNA alignment character: %c", c);
+        
+        symbols[res++] = c;
+        started = true;
+    }
+    
+    return res;
+}
+
+fasta_alignment_reader::fasta_alignment_reader(const char* file) {
+    rstream.file = fopen(file, "rt");
+    astream.file = NULL;
+    astart   = -1;
+    columns  = 0;
+    r_offset = 0;
+    
+    if (!rstream.file)
+        throw io_exception("unable to open FASTA alignment file: %s", file);
+    
+    try {
+        // a pipe can be read only once
+        if (fseek(rstream.file, 0, SEEK_END) || ftell(rstream.file) < 0) {
+            clearerr(rstream.file);
+            rstream.reset(0);
+            buffer_reference();
+            return;
+        }
+        
+        // the aligned sequence is read using its own stream
+        if (!(astream.file = fopen(file, "rt")))
+            throw io_exception("unable to open FASTA alignment file: %s", file);
+        
+        if ((astart = find_second_header(astream.file)) < 0)
+            throw parse_exception("given FASTA alignment contains less than two sequences");
+        
+        rstream.seek(0);
+        astream.seek(astart);
+    } catch (...) {
+        if (rstream.file)
+            fclose(rstream.file);
+        if (astream.file)
+            fclose(astream.file);
+        throw;
+    }
+}
+
+fasta_alignment_reader::~fasta_alignment_reader() {
+    if (rstream.file)
+        fclose(rstream.file);
+    fclose(astream.file);
+}
+
+void fasta_alignment_reader::buffer_reference() {
+    char block[65536];
+    size_t len;
+    
+    do {
+        len = rstream.read(block, sizeof(block));
+        reference.insert(reference.end(), block, block + len);
+    } while (len == sizeof(block));
+    
+    if (reference.empty() || !rstream.at_header())
+        throw parse_exception("given FASTA alignment contains less than two sequences");
+    
+    // the stream continues with the aligned sequence
+    astream = rstream;
+    astream.next_sequence();
+    rstream.file = NULL;
+}
+
+size_t fasta_alignment_reader::read(char* rblock, char* ablock, 
+    size_t size) {
+    size_t count;
+    char c;
+    
+    if (rstream.file)
+        count = rstream.read(rblock, size);
+    else {
+        count = std::min(size, reference.size() - r_offset);
+        memcpy(rblock, reference.data() + r_offset, count);
+        r_offset += count;
+    }
+    
+    if (astream.read(ablock, count) < count)
+        throw parse_exception("sequences of the FASTA alignment have different lengths");
+    
+    columns += count;
+    if (count == size)
+        return count;
+    
+    // the reference sequence must end right at the header of the aligned 
+    // sequence and the aligned sequence at the end of the file (empty 
+    // sequences are ignored)
+    if (columns == 0)
+        throw parse_exception("given FASTA alignment contains less than two sequences");
+    if (astream.read(&c, 1) > 0)
+        throw parse_exception("sequences of the FASTA alignment have different lengths");
+    if ((rstream.file && !rstream.skip_empty(astart)) || !astream.skip_empty(-1))
+        throw parse_exception("given FASTA alignment contains more than two sequences");
+    
+    return count;
+}
+
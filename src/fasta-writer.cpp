@@ -0,0 +1,146 @@
+/*
+Copyright (c) 2015 Perutka, Ondrej
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <algorithm>
+
+#include "fasta-writer.hpp"
+#include "exception.hpp"
+
+using namespace alzw;
+
+async_fasta_writer::async_fasta_writer(FILE* stream, size_t capacity)
+    : buffer(FASTA_BLOCK_SIZE)
+    , symbols(capacity)
+    , lines(capacity) {
+    this->stream = stream;
+    this->failed = false;
+    
+    setp(buffer.data(), buffer.data() + buffer.size());
+    
+    formatter_thread = std::thread(&async_fasta_writer::formatter, this);
+    writer_thread    = std::thread(&async_fasta_writer::writer, this);
+}
+
+async_fasta_writer::~async_fasta_writer() {
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+void async_fasta_writer::formatter() {
+    std::vector<char> data;
+    size_t column = 0;
+    
+    while (symbols.pop(data)) {
+        std::vector<char> block(data.size() 
+            + data.size() / FASTA_LINE_LENGTH + 1);
+        const char* s = data.data();
+        size_t len = data.size();
+        size_t offset = 0;
+        size_t n;
+        
+        while (len > 0) {
+            n = std::min(len, FASTA_LINE_LENGTH - column);
+            std::copy(s, s + n, block.begin() + offset);
+            offset += n;
+            column += n;
+            s   += n;
+            len -= n;
+            
+            if (column == FASTA_LINE_LENGTH) {
+                block[offset++] = '\n';
+                column = 0;
+            }
+        }
+        
+        block.resize(offset);
+        
+        if (!lines.push(std::move(block))) {
+            symbols.close();
+            return;
+        }
+    }
+    
+    lines.close();
+}
+
+void async_fasta_writer::writer() {
+    std::vector<char> data;
+    
+    while (lines.pop(data)) {
+        fwrite(data.data(), sizeof(char), data.size(), stream);
+        if (ferror(stream)) {
+            failed = true;
+            lines.close();
+            return;
+        }
+    }
+    
+    fflush(stream);
+    if (ferror(stream))
+        failed = true;
+}
+
+bool async_fasta_writer::submit() {
+    size_t len = pptr() - pbase();
+    if (len == 0)
+        return true;
+    
+    std::vector<char> data(FASTA_BLOCK_SIZE);
+    
+    data.swap(buffer);
+    data.resize(len);
+    
+    setp(buffer.data(), buffer.data() + buffer.size());
+    
+    return symbols.push(std::move(data));
+}
+
+async_fasta_writer::int_type async_fasta_writer::overflow(int_type c) {
+    if (!writer_thread.joinable() || !submit())
+        return traits_type::eof();
+    
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+        return traits_type::not_eof(c);
+    
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+    
+    return c;
+}
+
+void async_fasta_writer::close() {
+    if (!writer_thread.joinable())
+        return;
+    
+    bool submitted = submit();
+    
+    setp(NULL, NULL);
+    symbols.close();
+    formatter_thread.join();
+    writer_thread.join();
+    
+    if (!submitted || failed)
+        throw io_exception("error while writing into a file");
+}
+
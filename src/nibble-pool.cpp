@@ -0,0 +1,106 @@
+/*
+Copyright (c) 2015 Perutka, Ondrej
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <cstring>
+#include <algorithm>
+
+#include "nibble-pool.hpp"
+
+using namespace alzw;
+
+nibble_pool::nibble_pool(slab_region* region) {
+    this->region = region;
+    next = NULL;
+    end = NULL;
+    allocated = 0;
+    abandoned = 0;
+}
+
+nibble_pool::~nibble_pool() {
+    for (size_t i = 0; i < segments.size(); i++) {
+        if (region)
+            region->release(segments[i], sizes[i]);
+        else
+            delete [] segments[i];
+    }
+}
+
+void nibble_pool::add_segment(size_t size) {
+    uint8_t* segment;
+    
+    size = std::max(size, (size_t)NIBBLE_POOL_SEGMENT);
+    
+    if (region) {
+        size = (size + SLAB_SIZE - 1) & ~((size_t)SLAB_SIZE - 1);
+        segment = region->acquire(size);
+    } else
+        segment = new uint8_t[size];
+    
+    segments.push_back(segment);
+    sizes.push_back(size);
+    allocated += size;
+    
+    // the tail of the current segment will never be used
+    abandoned += end - next;
+    
+    next = segment;
+    end = segment + size;
+}
+
+uint8_t * nibble_pool::alloc(size_t size) {
+    if (size == 0)
+        return NULL;
+    
+    if ((size_t)(end - next) < size)
+        add_segment(size);
+    
+    uint8_t* result = next;
+    next += size;
+    
+    return result;
+}
+
+uint8_t * nibble_pool::grow(uint8_t* block, size_t size, size_t nsize) {
+    if (nsize <= size)
+        return block;
+    
+    // the last block grows in place
+    if (block && (block + size) == next 
+        && (size_t)(end - block) >= nsize) {
+        next = block + nsize;
+        return block;
+    }
+    
+    // leave enough space for the block to grow in place
+    if (block && (block + size) == next)
+        add_segment(nsize << 1);
+    
+    uint8_t* result = alloc(nsize);
+    if (size)
+        memcpy(result, block, size);
+    
+    // the old copy stays in the pool
+    abandoned += size;
+    
+    return result;
+}
+
@@ -25,8 +25,11 @@ THE SOFTWARE.
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <cmath>
+#include <unistd.h>
 
 #include "search-engine.hpp"
+#include "thread-pool.hpp"
 #include "utils.hpp"
 #include "exception.hpp"
 
@@ -233,8 +236,9 @@ void representative_table::print() const {
 // stream_searcher methods
 // #######################
 
-stream_searcher::stream_searcher(const decoder& d, const std::string& query)
-    : dec(d) {
+stream_searcher::stream_searcher(const dictionary_snapshot& d, 
+    const std::string& query)
+    : dict(d) {
     this->plen     = query.length();
     this->pattern  = new uint8_t[plen];
     
@@ -255,20 +259,25 @@ stream_searcher::~stream_searcher() {
 }
 
 void stream_searcher::load_phrase(uint64_t cw) {
-    const node_map& nmap = dec.get_phrases();
-    node_map::const_iterator it = nmap.find(cw);
-    if (it == nmap.end())
+    const snapshot_node* n = dict.get_node(cw);
+    if (!n)
         throw runtime_exception("unknown codeword: 0x%016lx", (unsigned long)cw);
     
-    const node* n = it->second;
+    uint64_t id = dict.id(n);
+    size_t len = n->phrase_length() - (id + n->length() - cw);
+    uint32_t count;
     
-    while (n->parent()) {
-        if (cw > n->id())
-            phrase.push_back(n->get_base(--cw - n->id()));
-        else {
-            phrase.push_back(n->symbol());
-            n = n->parent();
-            cw = n->id() + n->length();
+    phrase.resize(len);
+    
+    // the phrase is filled from its end, symbols of a node are copied at once
+    while (n) {
+        count = cw - id + 1;
+        len  -= count;
+        dict.get_symbols(n, id, count, &phrase[len]);
+        
+        if ((n = dict.parent(n))) {
+            id = dict.id(n);
+            cw = id + n->length();
         }
     }
 }
@@ -288,13 +297,12 @@ size_t stream_searcher::process_cw(uint64_t cw,
     size_t res = phrase.size();
     size_t i;
     
-    while (!phrase.empty()) {
+    for (size_t j = 0; j < res; j++) {
         if (sb_size >= sb_cap)
             search_step(h, misc);
         
         i = offset + sb_size++;
-        sbuffer[i % sb_cap] = phrase.back();
-        phrase.pop_back();
+        sbuffer[i % sb_cap] = phrase[j];
     }
     
     search_step(h, misc);
@@ -307,8 +315,8 @@ size_t stream_searcher::process_cw(uint64_t cw,
 // ##############################
 
 simple_stream_searcher::simple_stream_searcher(
-    const decoder& dec, const std::string& query)
-    : stream_searcher(dec, query) {
+    const dictionary_snapshot& dict, const std::string& query)
+    : stream_searcher(dict, query) {
 }
 
 void simple_stream_searcher::search_step(
@@ -330,8 +338,8 @@ void simple_stream_searcher::search_step(
 // ###########################
 
 bmh_stream_searcher::bmh_stream_searcher(
-    const decoder& dec, const std::string& query)
-    : stream_searcher(dec, query) {
+    const dictionary_snapshot& dict, const std::string& query)
+    : stream_searcher(dict, query) {
     size_t end = plen - 1;
     
     for (size_t i = 0; i < DFA_ALPHABET_SIZE; i++)
@@ -363,9 +371,9 @@ void bmh_stream_searcher::search_step(
 // dfa_stream_searcher methods
 // ###########################
 
-dfa_stream_searcher::dfa_stream_searcher(
-    const decoder& dec, const std::string& query, const df_automaton& fa)
-    : stream_searcher(dec, query)
+dfa_stream_searcher::dfa_stream_searcher(const dictionary_snapshot& dict, 
+    const std::string& query, const df_automaton& fa)
+    : stream_searcher(dict, query)
     , dfa(fa) {
     state  = 0;
     fstate = query.length();
@@ -391,51 +399,153 @@ void dfa_stream_searcher::reset(size_t seq, size_t offset) {
 // search_task methods
 // ###################
 
-search_task::search_task(const std::string& alzwf, const decoder& dec, 
-    const std::string& rs)
+search_task::search_task(const std::string& alzwf, 
+    const dictionary_snapshot& d, const std::string& rs)
     : alzw_file(alzwf)
     , rseq(rs)
-    , dict(dec.get_dictionary()) {
+    , dict(d)
+    , selection(NULL)
+    , index(NULL)
+    , first(0)
+    , last(SIZE_MAX)
+    , cw_reader(NULL) {
     dictionary tmpd(false);
     initial_pwidth = (int)ceil(log(tmpd.used_nodes()) / log(2));
 }
 
+search_task::~search_task() {
+    delete cw_reader;
+}
+
+void search_task::select(const std::vector<size_t>* seqs, 
+    const seek_index* index) {
+    this->selection = seqs && !seqs->empty() ? seqs : NULL;
+    this->index     = index;
+}
+
+void search_task::set_range(size_t first, size_t last) {
+    this->first = first;
+    this->last  = last;
+}
+
 void search_task::search(search_engine::match_handler* h, void* misc) {
+    const seek_point* p;
+    
     fprintf(stderr, "searching...\n");
     
     file_breader in(alzw_file.c_str());
-    size_t seqc = skip_file_table(in);
+    hdr.read(in);
+    if (index) {
+        hdr.read_segments(in, *index);
+        hdr.read_budget(*index);
+    }
+    
+    delete cw_reader;
+    cw_reader = codeword_reader::create(hdr.get_coder());
+    
+    size_t seqc = std::min(last, hdr.sequences());
     init_search();
     
-    const node* inode = dict.get_inode();
-    const node* dnode = dict.get_dnode();
-    const node* wnode = dict.get_wnode();
+    if (selection && selection->back() > seqc)
+        throw runtime_exception("no such sequence: %lu", (unsigned long)selection->back());
+    
+    if (first > 0) {
+        if (!index || index->sequences() != hdr.sequences())
+            throw runtime_exception("seek index does not match the ALZW stream");
+        
+        p = index->sequence_start(first);
+        
+        in.seek(p->offset);
+        pwidth = p->width;
+        seq    = p->seq;
+        new_sequence();
+        
+        seqc -= first;
+    }
+    
+    if (!selection)
+        scan(in, seqc, h, misc);
+    else if (index)
+        search_indexed(in, seqc, h, misc);
+    else
+        search_filtered(in, seqc, h, misc);
+}
+
+void search_task::search_indexed(breader& in, size_t seqc, 
+    search_engine::match_handler* h, void* misc) {
+    const seek_point* p;
+    
+    if (index->sequences() != hdr.sequences())
+        throw runtime_exception("seek index does not match the ALZW stream");
+    
+    for (size_t i = 0; i < selection->size(); i++) {
+        p = index->sequence_start((*selection)[i] - 1);
+        
+        in.seek(p->offset);
+        pwidth = p->width;
+        seq    = p->seq;
+        new_sequence();
+        
+        scan(in, 1, h, misc);
+    }
+}
+
+void search_task::search_filtered(breader& in, size_t seqc, 
+    search_engine::match_handler* h, void* misc) {
+    size_t i = 0;
+    
+    seqc = selection->back();
+    
+    while (seq <= seqc) {
+        if (seq == (*selection)[i]) {
+            scan(in, 1, h, misc);
+            i++;
+        } else
+            scan(in, 1, drop_match, NULL);
+    }
+}
+
+void search_task::scan(breader& in, size_t seqc, 
+    search_engine::match_handler* h, void* misc) {
+    uint64_t inode = dict.inode_id();
+    uint64_t dnode = dict.dnode_id();
+    uint64_t wnode = dict.wnode_id();
     uint64_t cw;
     size_t plen;
     size_t i = 0;
     
     while (i < seqc) {
-        if (pwidth > in.read(cw, pwidth))
-            throw runtime_exception("unexpected EOF in ALZW stream");
+        // sequences encoded using frozen dictionary start at a byte boundary
+        if (hdr.is_frozen(seq - 1))
+            in.align();
         
-        if (cw == dnode->id())
-            rseq_offset += in.read_delta();
-        else if (cw == inode->id())
-            read_insert(in, h, misc);
-        else if (cw == wnode->id()) {
-            if (pwidth == (sizeof(cw) << 3))
-                throw runtime_exception("codeword width overflow");
-            pwidth++;
-        } else {
-            plen = process_cw(cw, h, misc);
-            seq_offset  += plen;
-            rseq_offset += plen;
-        }
+        // skip segment header unless the sequence was accessed directly
+        if (index && hdr.is_segment_start(seq - 1) 
+            && in.tell() < index->sequence_start(seq - 1)->offset)
+            hdr.skip_segment(in);
         
-        if (rseq_offset >= rseq.length()) {
-            new_sequence();
-            i++;
-        }
+        cw_reader->begin_sequence(in);
+        
+        do {
+            cw = cw_reader->read_cw(pwidth, in);
+            
+            if (cw == dnode)
+                rseq_offset += cw_reader->read_del_length(in);
+            else if (cw == inode)
+                read_insert(in, h, misc);
+            else if (cw == wnode) {
+                if (pwidth == (sizeof(cw) << 3))
+                    throw runtime_exception("codeword width overflow");
+                pwidth++;
+            } else {
+                plen = process_cw(cw, h, misc);
+                seq_offset  += plen;
+                rseq_offset += plen;
+            }
+        } while (rseq_offset < rseq.length());
+        
+        new_sequence();
+        i++;
     }
 }
 
@@ -452,32 +562,13 @@ void search_task::new_sequence() {
     seq++;
 }
 
-size_t search_task::skip_file_table(breader& in) {
-    char buffer[4096];
-    
-    int seqc = in.read_int();
-    for (int i = 0; i < seqc; i++) {
-        if (in.read_str(buffer, sizeof(buffer)) < 0)
-            throw runtime_exception("ALZW sequence file name is too long, maximum supported length is 4095 characters");
-    }
-    
-    if (seqc < 0)
-        throw runtime_exception("negative number of ALZW sequences");
-    else if (seqc == 0)
-        return 1;
-    
-    return seqc;
-}
-
 void search_task::read_insert(breader& in, 
     search_engine::match_handler* h, void* misc) {
-    size_t icount = in.read_delta();
-    uint64_t cw   = 0;
+    size_t icount = cw_reader->read_ins_count(in);
+    uint64_t cw;
     
     for (size_t i = 0; i < icount; i++) {
-        if (pwidth > in.read(cw, pwidth))
-            throw runtime_exception("unexpected EOF in ALZW stream");
-        
+        cw = cw_reader->read_ins_cw(pwidth, in);
         seq_offset += process_cw(cw, h, misc);
     }
 }
@@ -486,9 +577,10 @@ void search_task::read_insert(breader& in,
 // ss_task methods
 // ###############
 
-ss_task::ss_task(const std::string& alzw_file, const decoder& dec, 
-    const std::string& rseq, stream_searcher& s)
-    : search_task(alzw_file, dec, rseq)
+ss_task::ss_task(const std::string& alzw_file, 
+    const dictionary_snapshot& dict, const std::string& rseq, 
+    stream_searcher& s)
+    : search_task(alzw_file, dict, rseq)
     , ss(s) {
 }
 
@@ -511,18 +603,22 @@ size_t ss_task::process_cw(uint64_t cw,
 // lm_task methods
 // ###############
 
-lm_task::lm_task(const std::string& alzw_file, const decoder& d, 
-    const std::string& rseq, const std::string& query)
+lm_task::lm_task(const std::string& alzw_file, 
+    const dictionary_snapshot& d, const std::string& rseq, 
+    const std::string& query)
     : search_task(alzw_file, d, rseq)
-    , dec(d)
-    , ss(dec, query, dfa) {
+    , dict(d)
+    , ss(dict, query, dfa) {
     pattern_matching_dfa_builder bldr;
     bldr.build(dfa, query);
     rtable = new representative_table(dfa);
+    
+    rmap = new const representative*[dict.phrase_count()]();
 }
 
 lm_task::~lm_task() {
     delete rtable;
+    delete [] rmap;
 }
 
 void lm_task::init_search() {
@@ -589,54 +685,77 @@ const signature * lm_task::get_signature(uint64_t cw) {
 }
 
 const representative * lm_task::get_representative(uint64_t cw) {
-    representative_map::iterator it = rmap.find(cw);
-    if (it != rmap.end())
-        return it->second;
+    size_t slot = dict.phrase_slot(cw);
     
-    const node* n = get_node(cw);
+    const representative* r = cached_representative(cw, slot);
+    if (r)
+        return r;
+    
+    const snapshot_node* n = get_node(cw);
     uint64_t orig_cw = cw;
+    size_t orig_slot = slot;
     
     if (!n)
         throw runtime_exception("unknown codeword: 0x%016lx", (unsigned long)cw);
     
-    while (!rmap.count(cw) && n->parent()) {
-        if (cw > n->id())
-            suffix_stack.push_back(n->get_base(--cw - n->id()));
-        else {
-            suffix_stack.push_back(n->symbol());
-            n = n->parent();
-            cw = n->id() + n->length();
+    uint64_t id = dict.id(n);
+    
+    while (n && !(r = cached_representative(cw, slot))) {
+        if (cw > id) {
+            suffix_stack.push_back(dict.get_symbol(n, cw--));
+            if (slot > 0 && dict.is_phrase(slot - 1, cw))
+                slot--;
+        } else {
+            suffix_stack.push_back(dict.get_symbol(n, cw));
+            if ((n = dict.parent(n))) {
+                id   = dict.id(n);
+                cw   = id + n->length();
+                slot = dict.phrase_slot(cw);
+            }
         }
     }
     
-    const representative* r = n->parent()
-        ? rmap[cw]
-        : rtable->epsilon();
+    if (!n)
+        r = rtable->epsilon();
     
     while (!suffix_stack.empty()) {
         r = r->get_transition(suffix_stack.back());
         suffix_stack.pop_back();
     }
     
-    return rmap[orig_cw] = r;
+    if (dict.is_phrase(orig_slot, orig_cw))
+        rmap[orig_slot] = r;
+    else
+        omap[orig_cw] = r;
+    
+    return r;
 }
 
-const node * lm_task::get_node(uint64_t id) {
-    const node_map& nmap = dec.get_phrases();
-    node_map::const_iterator it = nmap.find(id);
-    if (it == nmap.end())
+const representative * lm_task::cached_representative(uint64_t cw, 
+    size_t slot) const {
+    if (dict.is_phrase(slot, cw))
+        return rmap[slot];
+    else if (omap.empty())
+        return NULL;
+    
+    representative_map::const_iterator it = omap.find(cw);
+    if (it == omap.end())
         return NULL;
     
     return it->second;
 }
 
+const snapshot_node * lm_task::get_node(uint64_t id) {
+    return dict.get_node(id);
+}
+
 size_t lm_task::phrase_length(uint64_t id) {
-    const node* n = get_node(id);
+    const snapshot_node* n = get_node(id);
     if (!n)
         return 0;
     
     size_t plen = n->phrase_length();
-    size_t roffset = n->id() + n->length() - id;
+    size_t roffset = dict.id(n) + n->length() - id;
     
     return plen - roffset;
 }
@@ -662,76 +781,179 @@ void lm_task::match_filter(size_t seq, size_t offset, void* misc) {
 // search_engine methods
 // #####################
 
-search_engine::search_engine(const char* rseqf, const char* alzwf)
+search_engine::search_engine(const char* rseqf, const char* alzwf, 
+    size_t threads)
     : construction_time(utils::time())
     , alzw_file(alzwf)
     , rseq(utils::load_fasta(rseqf))
-    , dec(rseq) {
-    file_breader br(alzw_file.c_str());
-    char buffer[4096];
-    
-    int seqc = br.read_int();
-    for (int i = 0; i < seqc; i++) {
-        if (br.read_str(buffer, sizeof(buffer)) < 0)
-            throw runtime_exception("ALZW sequence file name is too long, maximum supported length is 4095 characters");
+    , index(NULL)
+    , threads(threads) {
+    file_breader in(alzwf);
+    hdr.read(in);
+    
+    index = seek_index::load(alzwf);
+    if (index) {
+        fprintf(stderr, "using seek index (%lu seek points)\n", (unsigned long)index->size());
+        hdr.read_segments(in, *index);
+        hdr.read_budget(*index);
+    } else if (hdr.has_budget())
+        throw runtime_exception("missing seek index of an ALZW stream with dictionary budget");
+    
+    dicts.resize(hdr.chunks(), NULL);
+    
+    // the whole archive is hashed, do it only once for all chunks
+    dictionary_snapshot::origin origin(alzwf, rseq);
+    
+    if (dicts.size() == 1)
+        dicts[0] = load_dictionary(0, origin);
+    else {
+        thread_pool pool(threads);
+        
+        for (size_t i = 0; i < dicts.size(); i++)
+            pool.submit([&, i] {
+                dicts[i] = load_dictionary(i, origin);
+            });
+        
+        pool.wait();
     }
     
-    if (seqc < 0)
-        throw runtime_exception("negative number of ALZW sequences");
-    else if (seqc == 0)
-        seqc = 1;
+    double t = utils::time() - construction_time;
+    fprintf(stderr, "index loaded in [s]: %.6f\n", t);
+}
+
+search_engine::~search_engine() {
+    for (size_t i = 0; i < dicts.size(); i++)
+        delete dicts[i];
     
-    for (int i = 0; i < seqc; i++)
-        dec.decode(br);
+    delete index;
+}
+
+dictionary_snapshot * search_engine::load_dictionary(size_t chunk, 
+    const dictionary_snapshot::origin& origin) {
+    const char* alzwf = alzw_file.c_str();
+    std::string sfile = dictionary_snapshot::snapshot_file(alzwf, chunk);
+    dictionary_snapshot* dict = NULL;
     
-    dec.freeze();
+    if (access(sfile.c_str(), R_OK) == 0) {
+        try {
+            dict = new dictionary_snapshot(sfile.c_str());
+        } catch (parse_exception& ex) {
+            fprintf(stderr, "%s, ignoring: %s\n", ex.what(), sfile.c_str());
+        }
+    }
     
-    double t = utils::time() - construction_time;
-    fprintf(stderr, "index loaded in [s]: %.6f\n", t);
+    if (dict) {
+        if (dict->matches(origin))
+            fprintf(stderr, "using dictionary snapshot: %s\n", sfile.c_str());
+        else {
+            fprintf(stderr, "dictionary snapshot is out of date, ignoring: %s\n", sfile.c_str());
+            delete dict;
+            dict = NULL;
+        }
+    }
+    
+    if (!dict)
+        dict = dictionary_snapshot::create(rseq, alzwf, chunk, origin);
+    
+    return dict;
 }
 
-void search_engine::search(search_task& stask, match_handler* h, void* misc) {
+void search_engine::collect_match(size_t seq, size_t offset, void* misc) {
+    std::vector<std::pair<size_t, size_t>>* matches = 
+        (std::vector<std::pair<size_t, size_t>>*)misc;
+    
+    matches->push_back(std::make_pair(seq, offset));
+}
+
+void search_engine::search(search_task& stask, size_t chunk, 
+    match_handler* h, void* misc) {
+    size_t first = hdr.chunk_start(chunk);
+    size_t end   = hdr.chunk_end(chunk);
+    std::vector<size_t> cselection;
+    
+    // select only sequences from the given chunk
+    for (size_t i = 0; i < selection.size(); i++) {
+        if (selection[i] > first && selection[i] <= end)
+            cselection.push_back(selection[i]);
+    }
+    
+    if (!selection.empty() && cselection.empty())
+        return;
+    
     double t = utils::time();
+    stask.select(&cselection, index);
+    stask.set_range(first, end);
     stask.search(h, misc);
     t = utils::time() - t;
     fprintf(stderr, "search time [s]: %.6f\n", t);
 }
 
-void search_engine::search(int alg, const std::string& query, 
+void search_engine::search(int alg, const std::string& query, size_t chunk, 
     match_handler* h, void* misc) {
+    const dictionary_snapshot& dict = *dicts[chunk];
     double t = utils::time();
+    
     if (alg == SE_ALG_SIMPLE) {
-        simple_stream_searcher sss(dec, query);
-        ss_task stask(alzw_file, dec, rseq, sss);
+        simple_stream_searcher sss(dict, query);
+        ss_task stask(alzw_file, dict, rseq, sss);
         
         double t2 = utils::time() - t;
         fprintf(stderr, "preprocessing time [s]: %.9f\n", t2);
-        search(stask, h, misc);
+        search(stask, chunk, h, misc);
     } else if (alg == SE_ALG_BMH) {
-        bmh_stream_searcher bmh(dec, query);
-        ss_task stask(alzw_file, dec, rseq, bmh);
+        bmh_stream_searcher bmh(dict, query);
+        ss_task stask(alzw_file, dict, rseq, bmh);
         
         double t2 = utils::time() - t;
         fprintf(stderr, "preprocessing time [s]: %.9f\n", t2);
-        search(stask, h, misc);
+        search(stask, chunk, h, misc);
     } else if (alg == SE_ALG_DFA) {
         pattern_matching_dfa_builder bldr;
         df_automaton dfa;
         
         bldr.build(dfa, query);
         
-        dfa_stream_searcher dfa_ss(dec, query, dfa);
-        ss_task stask(alzw_file, dec, rseq, dfa_ss);
+        dfa_stream_searcher dfa_ss(dict, query, dfa);
+        ss_task stask(alzw_file, dict, rseq, dfa_ss);
         
         double t2 = utils::time() - t;
         fprintf(stderr, "preprocessing time [s]: %.9f\n", t2);
-        search(stask, h, misc);
+        search(stask, chunk, h, misc);
     } else if (alg == SE_ALG_LM) {
-        lm_task stask(alzw_file, dec, rseq, query);
+        lm_task stask(alzw_file, dict, rseq, query);
         
         double t2 = utils::time() - t;
         fprintf(stderr, "preprocessing time [s]: %.9f\n", t2);
-        search(stask, h, misc);
+        search(stask, chunk, h, misc);
+    }
+}
+
+void search_engine::search(int alg, const std::string& query, 
+    match_handler* h, void* misc) {
+    double t = utils::time();
+    
+    if (!selection.empty() && selection.back() > hdr.sequences())
+        throw runtime_exception("no such sequence: %lu", (unsigned long)selection.back());
+    
+    if (dicts.size() == 1)
+        search(alg, query, 0, h, misc);
+    else {
+        std::vector<std::vector<std::pair<size_t, size_t>>> matches(dicts.size());
+        thread_pool pool(threads);
+        
+        for (size_t i = 0; i < dicts.size(); i++) {
+            pool.submit([&, i] {
+                search(alg, query, i, collect_match, &matches[i]);
+            });
+        }
+        
+        pool.wait();
+        
+        // report matches in the stream order
+        for (size_t i = 0; i < matches.size(); i++) {
+            for (size_t j = 0; j < matches[i].size(); j++)
+                h(matches[i][j].first, matches[i][j].second, misc);
+        }
     }
     
     t = utils::time() - t;
@@ -0,0 +1,257 @@
+/*
+Copyright (c) 2015 Perutka, Ondrej
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <cstring>
+
+#include "seek-index.hpp"
+#include "utils.hpp"
+#include "exception.hpp"
+
+using namespace alzw;
+
+#define SEEK_INDEX_MAGIC    "ALZWSIDX"
+
+// trailer size in bytes (footer offset + magic)
+#define SEEK_INDEX_TRAILER  16
+
+/**
+ * Map a given signed number to an unsigned one (0, -1, 1, -2, 2, ...).
+ *
+ * @param n number
+ * @returns zig-zag encoded number
+ */
+static uint64_t zigzag(int64_t n) {
+    return ((uint64_t)n << 1) ^ (uint64_t)(n >> 63);
+}
+
+/**
+ * Inverse function to zigzag().
+ *
+ * @param n zig-zag encoded number
+ * @returns number
+ */
+static int64_t unzigzag(uint64_t n) {
+    return (int64_t)(n >> 1) ^ -(int64_t)(n & 1);
+}
+
+void seek_index::add(const seek_point& p) {
+    if (!points.empty() && p.seq < points.back().seq)
+        throw runtime_exception("seek points must be added in the stream order");
+    if (!sync_points && p.roffset > 0)
+        return;
+    
+    while (seq_starts.size() <= p.seq)
+        seq_starts.push_back(points.size());
+    
+    points.push_back(p);
+}
+
+const seek_point * seek_index::sequence_start(size_t seq) const {
+    if (seq >= seq_starts.size())
+        return NULL;
+    
+    return &points[seq_starts[seq]];
+}
+
+const seek_point * seek_index::find(size_t seq, uint64_t roffset) const {
+    if (seq >= seq_starts.size())
+        return NULL;
+    
+    size_t l = seq_starts[seq];
+    size_t r = (seq + 1) < seq_starts.size() 
+        ? seq_starts[seq + 1] 
+        : points.size();
+    size_t m;
+    
+    // the first point of a sequence always has reference offset 0
+    l++;
+    
+    while (l < r) {
+        m = (l + r) >> 1;
+        if (points[m].roffset <= roffset)
+            l = m + 1;
+        else
+            r = m;
+    }
+    
+    return &points[l - 1];
+}
+
+const seek_point * seek_index::find_reachable(const seek_point* from, 
+    const seek_point* to, uint64_t next_id) const {
+    const seek_point* l = from;
+    const seek_point* r = to + 1;
+    const seek_point* m;
+    
+    // next node IDs are non-decreasing in the stream order
+    while (l < r) {
+        m = l + ((r - l) >> 1);
+        if (m->next_id <= next_id)
+            l = m + 1;
+        else
+            r = m;
+    }
+    
+    if (l == from || (l - 1)->next_id != next_id)
+        return NULL;
+    
+    return l - 1;
+}
+
+void seek_index::write(bwriter& out) const {
+    out.flush();
+    
+    uint64_t footer_offset = out.tell() >> 3;
+    const seek_point* prev = NULL;
+    
+    out.write(SEEK_INDEX_VERSION, 8);
+    out.write_delta(seq_starts.size() + 1);
+    out.write_delta(points.size() + 1);
+    
+    // all values are delta-encoded relatively to the previous seek point, 
+    // the sequence offset is encoded relatively to the reference offset as 
+    // the two are usually very close to each other
+    for (size_t i = 0; i < points.size(); i++) {
+        const seek_point& p = points[i];
+        bool nseq = !prev || prev->seq != p.seq;
+        uint64_t rdelta = p.roffset - (nseq ? 0 : prev->roffset);
+        uint64_t adelta = p.aoffset - (nseq ? 0 : prev->aoffset);
+        
+        out.write(nseq ? 1 : 0, 1);
+        if (nseq)
+            out.write_delta(p.seq - (prev ? prev->seq : 0) + 1);
+        
+        // the dictionary (and so the next node ID and the codeword width) 
+        // is reset at the beginning of every chunk
+        out.write_delta(p.offset - (prev ? prev->offset : 0) + 1);
+        out.write_delta(zigzag(p.next_id - (prev ? prev->next_id : 0)) + 1);
+        out.write_delta(zigzag(p.width - (prev ? prev->width : 0)) + 1);
+        out.write_delta(rdelta + 1);
+        out.write_delta(zigzag((int64_t)(adelta - rdelta)) + 1);
+        
+        prev = &p;
+    }
+    
+    out.write_delta(segments.size() + 1);
+    for (size_t i = 0; i < segments.size(); i++)
+        out.write_delta(segments[i] - (i > 0 ? segments[i - 1] : 0) + 1);
+    
+    out.write_delta(budget_points.size() + 1);
+    for (size_t i = 0; i < budget_points.size(); i++) {
+        out.write_delta(budget_points[i] 
+            - (i > 0 ? budget_points[i - 1] : 0) + 1);
+    }
+    
+    out.flush();
+    
+    out.write(footer_offset, 64);
+    out.write_buf((const uint8_t*)SEEK_INDEX_MAGIC, 64);
+    out.flush();
+}
+
+seek_index * seek_index::load(const char* alzw_file) {
+    size_t size = utils::file_size(alzw_file);
+    uint64_t footer_offset;
+    char magic[sizeof(SEEK_INDEX_MAGIC)];
+    uint64_t tmp;
+    
+    if (size < SEEK_INDEX_TRAILER)
+        return NULL;
+    
+    file_breader in(alzw_file);
+    in.seek((uint64_t)(size - SEEK_INDEX_TRAILER) << 3);
+    if (in.read(footer_offset, 64) < 64)
+        throw io_exception("unable to read ALZW footer");
+    
+    for (size_t i = 0; i < 8; i++) {
+        in.read(tmp, 8);
+        magic[i] = (char)tmp;
+    }
+    
+    magic[8] = 0;
+    
+    if (strcmp(magic, SEEK_INDEX_MAGIC))
+        return NULL;
+    if (footer_offset >= size)
+        throw parse_exception("invalid ALZW footer offset");
+    
+    in.seek(footer_offset << 3);
+    if (in.read(tmp, 8) < 8 || tmp != SEEK_INDEX_VERSION)
+        throw parse_exception("unsupported ALZW seek index version: %u", (unsigned)tmp);
+    
+    uint64_t segment = 0;
+    uint32_t bpoint  = 0;
+    
+    seek_index* index = new seek_index();
+    seek_point p;
+    
+    memset(&p, 0, sizeof(p));
+    
+    try {
+        size_t seqc   = in.read_delta() - 1;
+        size_t points = in.read_delta() - 1;
+        bool nseq;
+        
+        for (size_t i = 0; i < points; i++) {
+            in.read(tmp, 1);
+            if ((nseq = tmp != 0))
+                p.seq += in.read_delta() - 1;
+            
+            p.offset  += in.read_delta() - 1;
+            p.next_id += unzigzag(in.read_delta() - 1);
+            p.width   += unzigzag(in.read_delta() - 1);
+            
+            if (nseq) {
+                p.roffset = 0;
+                p.aoffset = 0;
+            }
+            
+            uint64_t rdelta = in.read_delta() - 1;
+            int64_t adiff = unzigzag(in.read_delta() - 1);
+            
+            p.roffset += rdelta;
+            p.aoffset += rdelta + adiff;
+            
+            index->add(p);
+        }
+        
+        size_t segments = in.read_delta() - 1;
+        for (size_t i = 0; i < segments; i++) {
+            segment += in.read_delta() - 1;
+            index->add_segment(segment);
+        }
+        
+        size_t bpoints = in.read_delta() - 1;
+        for (size_t i = 0; i < bpoints; i++) {
+            bpoint += in.read_delta() - 1;
+            index->add_budget_point(bpoint);
+        }
+        
+        if (index->sequences() != seqc)
+            throw parse_exception("corrupted ALZW seek index");
+    } catch (...) {
+        delete index;
+        throw;
+    }
+    
+    return index;
+}
@@ -0,0 +1,277 @@
+/*
+Copyright (c) 2015 Perutka, Ondrej
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <cstring>
+#include <algorithm>
+
+#include "sequence-reader.hpp"
+#include "utils.hpp"
+#include "exception.hpp"
+
+using namespace alzw;
+
+sequence_reader::sequence_reader(const std::string& rs, 
+    const char* alzw_file)
+    : rseq(rs)
+    , br(alzw_file) {
+    hdr.read(br);
+    data_start = br.tell();
+    
+    index = seek_index::load(alzw_file);
+    
+    if (index) {
+        hdr.read_segments(br, *index);
+        hdr.read_budget(*index);
+        
+        if (index->sequences() != hdr.sequences()) {
+            delete index;
+            throw runtime_exception("seek index does not match the ALZW stream");
+        }
+    } else if (hdr.has_budget())
+        throw runtime_exception("missing seek index of an ALZW stream with dictionary budget");
+    
+    dec       = NULL;
+    dec_chunk = 0;
+    next      = 0;
+    reading   = false;
+    format    = SYMBOLS_ASCII;
+    
+    obuffer     = NULL;
+    ob_capacity = 0;
+    ob_size     = 0;
+    
+    p_offset = 0;
+    
+    delivered = 0;
+}
+
+sequence_reader::~sequence_reader() {
+    delete dec;
+    delete index;
+}
+
+void sequence_reader::restart(size_t chunk) {
+    size_t first = hdr.chunk_start(chunk);
+    
+    delete dec;
+    dec = NULL;
+    dec = new decoder(rseq, false);
+    dec->set_coder(hdr.get_coder());
+    dec->set_line_length(0);
+    
+    br.seek(first > 0 ? index->sequence_start(first)->offset : data_start);
+    next = first;
+    
+    dec_chunk = chunk;
+}
+
+void sequence_reader::skip(size_t seq) {
+    const seek_point* from = index->sequence_start(next);
+    const seek_point* to   = index->find(seq, 0);
+    const seek_point* p;
+    
+    if (from->next_id != dec->next_id())
+        throw runtime_exception("seek index does not match the ALZW stream");
+    
+    p = index->find_reachable(from, to, dec->next_id());
+    if (p != from)
+        dec->seek(br, *p);
+    
+    next = p->seq;
+}
+
+void sequence_reader::enter_sequence() {
+    bool reset = hdr.apply_budget(next, dec->node_memory()) == BUDGET_RESET;
+    
+    // a new chunk starts with an empty dictionary at a byte boundary
+    if (reset || (next > 0 && hdr.is_chunk_start(next))) {
+        dec->reset_dictionary();
+        br.align();
+    }
+    
+    if (hdr.is_frozen(next))
+        dec->freeze_dictionary();
+    
+    if (index) {
+        if (hdr.is_segment_start(next) 
+            && br.tell() < index->sequence_start(next)->offset)
+            hdr.skip_segment(br);
+    } else if (next >= hdr.sequences() && !hdr.read_segment(br))
+        throw runtime_exception("no such sequence: %lu", (unsigned long)next);
+}
+
+void sequence_reader::decode_codeword(symbol_sink* out) {
+    if (dec->decode_codeword(br, out))
+        return;
+    
+    reading = false;
+    next++;
+}
+
+void sequence_reader::open(size_t seq, int format) {
+    if (format != SYMBOLS_ASCII && format != SYMBOLS_4BIT 
+        && format != SYMBOLS_2BIT)
+        throw runtime_exception("unknown symbol encoding: %d", format);
+    if (index && seq >= hdr.sequences())
+        throw runtime_exception("no such sequence: %lu", (unsigned long)seq);
+    
+    pending.clear();
+    p_offset = 0;
+    
+    runs.clear();
+    delivered = 0;
+    
+    // the decoder can continue only towards a later sequence of the same 
+    // chunk (other chunks cannot be reached directly without seek index)
+    size_t chunk = index ? hdr.chunk_of(seq) : 0;
+    bool forward = reading ? seq > next : seq >= next;
+    
+    if (dec && forward && chunk == dec_chunk) {
+        // the rest of the current sequence is needed for the dictionary
+        while (reading)
+            decode_codeword(NULL);
+    } else {
+        reading = false;
+        restart(chunk);
+    }
+    
+    // skip all sequences before the selected one
+    while (true) {
+        if (index)
+            skip(seq);
+        
+        enter_sequence();
+        if (next == seq)
+            break;
+        
+        dec->decode(br);
+        next++;
+    }
+    
+    this->format = format;
+    
+    dec->start_sequence(br);
+    reading = true;
+}
+
+size_t sequence_reader::read(void* buffer, size_t capacity) {
+    obuffer     = (uint8_t*)buffer;
+    ob_capacity = capacity;
+    ob_size     = 0;
+    
+    // symbols left from the previous call go first
+    if (p_offset < pending.size()) {
+        size_t n = std::min(pending.size() - p_offset, capacity);
+        put(pending.data() + p_offset, n);
+        p_offset += n;
+        
+        if (p_offset == pending.size()) {
+            pending.clear();
+            p_offset = 0;
+        }
+    }
+    
+    while (reading && ob_size < ob_capacity)
+        decode_codeword(this);
+    
+    obuffer = NULL;
+    delivered += ob_size;
+    
+    return ob_size;
+}
+
+size_t sequence_reader::decode(size_t seq, void* buffer, size_t capacity, 
+    int format) {
+    open(seq, format);
+    
+    size_t res = read(buffer, capacity);
+    
+    // the buffer is full, make sure there is nothing else
+    ob_capacity = 0;
+    ob_size     = 0;
+    while (reading && pending.empty())
+        decode_codeword(this);
+    
+    if (!pending.empty())
+        throw runtime_exception("buffer is too small for sequence: %lu", (unsigned long)seq);
+    
+    return res;
+}
+
+size_t sequence_reader::buffer_size(size_t symbols, int format) {
+    switch (format) {
+        case SYMBOLS_4BIT: return (symbols + 1) >> 1;
+        case SYMBOLS_2BIT: return (symbols + 3) >> 2;
+        default: return symbols;
+    }
+}
+
+void sequence_reader::put(const char* s, size_t len) {
+    uint8_t code;
+    
+    switch (format) {
+        case SYMBOLS_4BIT:
+            for (size_t i = 0; i < len; i++, ob_size++) {
+                code = utils::char2base(s[i]);
+                if (ob_size & 1)
+                    obuffer[ob_size >> 1] |= code;
+                else
+                    obuffer[ob_size >> 1] = code << 4;
+            }
+            break;
+        case SYMBOLS_2BIT:
+            for (size_t i = 0; i < len; i++, ob_size++) {
+                code = utils::char2base(s[i]);
+                if (code > 3) {
+                    add_run(delivered + ob_size);
+                    code = 0;
+                }
+                if (ob_size & 3)
+                    obuffer[ob_size >> 2] |= code << ((3 - (ob_size & 3)) << 1);
+                else
+                    obuffer[ob_size >> 2] = code << 6;
+            }
+            break;
+        default:
+            memcpy(obuffer + ob_size, s, len);
+            ob_size += len;
+            break;
+    }
+}
+
+void sequence_reader::add_run(uint64_t offset) {
+    if (!runs.empty() && runs.back().end == offset)
+        runs.back().end++;
+    else {
+        n_run r = { offset, offset + 1 };
+        runs.push_back(r);
+    }
+}
+
+void sequence_reader::write(const char* s, size_t len) {
+    size_t n = std::min(len, ob_capacity - ob_size);
+    
+    if (n > 0)
+        put(s, n);
+    pending.insert(pending.end(), s + n, s + len);
+}
+
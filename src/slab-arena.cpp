@@ -0,0 +1,169 @@
+/*
+Copyright (c) 2015 Perutka, Ondrej
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <sys/mman.h>
+
+#include "slab-arena.hpp"
+#include "exception.hpp"
+
+using namespace alzw;
+
+// ###################
+// slab_region methods
+// ###################
+
+slab_region::slab_region(size_t size) {
+    void* addr = mmap(NULL, size, PROT_NONE, 
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (addr == MAP_FAILED)
+        throw runtime_exception("unable to reserve a slab region");
+    
+    this->base = (uint8_t*)addr;
+    this->size = size;
+    this->used = SLAB_SIZE;
+}
+
+slab_region::~slab_region() {
+    munmap(base, size);
+}
+
+void slab_region::remove_free(std::map<uint8_t*, size_t>::iterator it) {
+    auto range = free_sizes.equal_range(it->second);
+    while (range.first->second != it->first)
+        range.first++;
+    
+    free_sizes.erase(range.first);
+    free_blocks.erase(it);
+}
+
+uint8_t * slab_region::acquire(size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    // the smallest free block large enough, the rest of it stays free
+    auto fit = free_sizes.lower_bound(size);
+    if (fit != free_sizes.end()) {
+        uint8_t* block = fit->second;
+        size_t bsize = fit->first;
+        
+        remove_free(free_blocks.find(block));
+        if (bsize > size) {
+            free_blocks[block + size] = bsize - size;
+            free_sizes.insert(std::make_pair(bsize - size, block + size));
+        }
+        
+        return block;
+    }
+    
+    if (size > (this->size - used))
+        throw runtime_exception("slab region is exhausted");
+    
+    uint8_t* block = base + used;
+    if (mprotect(block, size, PROT_READ | PROT_WRITE) == -1)
+        throw runtime_exception("unable to commit a slab");
+        
+#if defined(SLAB_HUGE_PAGES) && defined(MADV_HUGEPAGE)
+    madvise(block, size, MADV_HUGEPAGE);
+#endif
+    
+    used += size;
+    
+    return block;
+}
+
+void slab_region::release(uint8_t* block, size_t size) {
+    madvise(block, size, MADV_DONTNEED);
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    // merge the block with the following free block
+    auto it = free_blocks.find(block + size);
+    if (it != free_blocks.end()) {
+        size += it->second;
+        remove_free(it);
+    }
+    
+    // merge the block with the preceding free block
+    it = free_blocks.lower_bound(block);
+    if (it != free_blocks.begin() && (--it)->first + it->second == block) {
+        block = it->first;
+        size += it->second;
+        remove_free(it);
+    }
+    
+    // a block at the end of the used space is returned to the region
+    if (block + size == base + used)
+        used -= size;
+    else {
+        free_blocks[block] = size;
+        free_sizes.insert(std::make_pair(size, block));
+    }
+}
+
+// ##################
+// slab_arena methods
+// ##################
+
+slab_arena::slab_arena(size_t obj_size, slab_region* region) {
+    // every object must be able to hold a free list link
+    if (obj_size < sizeof(void*))
+        obj_size = sizeof(void*);
+    
+    this->region = region;
+    this->obj_size = obj_size;
+    this->per_slab = SLAB_SIZE / obj_size;
+    this->count = 0;
+    this->next = NULL;
+    this->end = NULL;
+    this->free_list = NULL;
+}
+
+slab_arena::~slab_arena() {
+    for (size_t i = 0; i < slabs.size(); i++) {
+        if (region)
+            region->release(slabs[i], SLAB_SIZE);
+        else
+            munmap(slabs[i], SLAB_SIZE);
+    }
+}
+
+void slab_arena::grow() {
+    void* addr;
+    
+    if (region)
+        addr = region->acquire(SLAB_SIZE);
+    else {
+        addr = mmap(NULL, SLAB_SIZE, PROT_READ | PROT_WRITE, 
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (addr == MAP_FAILED)
+            throw runtime_exception("unable to map a new slab");
+
+#if defined(SLAB_HUGE_PAGES) && defined(MADV_HUGEPAGE)
+        madvise(addr, SLAB_SIZE, MADV_HUGEPAGE);
+#endif
+    }
+    
+    slabs.push_back((uint8_t*)addr);
+    
+    next = (uint8_t*)addr;
+    end = next + per_slab * obj_size;
+}
+
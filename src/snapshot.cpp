@@ -0,0 +1,560 @@
+/*
+Copyright (c) 2015 Perutka, Ondrej
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "snapshot.hpp"
+#include "archive.hpp"
+#include "seek-index.hpp"
+#include "utils.hpp"
+#include "exception.hpp"
+
+using namespace alzw;
+
+#define SNAPSHOT_MAGIC      "ALZWDICT"
+#define SNAPSHOT_BOM        0x01020304
+#define SNAPSHOT_ALIGN(x)   (((x) + 7) & ~(uint64_t)7)
+
+/**
+ * Packed byte to symbols conversion table.
+ */
+static struct symbol_table {
+    uint8_t symbols[256][4];
+    
+    symbol_table() {
+        for (int i = 0; i < 256; i++) {
+            for (int j = 0; j < 4; j++)
+                symbols[i][j] = (i >> (j << 1)) & 3;
+        }
+    }
+} symbol_table;
+
+/**
+ * Node ID comparator.
+ */
+static bool node_id_less(const node* a, const node* b) {
+    return a->id() < b->id();
+}
+
+/**
+ * Get index of a node with a given ID in a sorted array of nodes.
+ *
+ * @param nodes sorted nodes
+ * @param id    node ID
+ * @returns index of the last node with ID lower than or equal to the given
+ * ID or -1
+ */
+static int64_t find_node(const std::vector<const node*>& nodes, uint64_t id) {
+    size_t l = 0;
+    size_t r = nodes.size();
+    size_t m;
+    
+    while (l < r) {
+        m = (l + r) >> 1;
+        if (nodes[m]->id() <= id)
+            l = m + 1;
+        else
+            r = m;
+    }
+    
+    return (int64_t)l - 1;
+}
+
+/**
+ * Build page index of a given array sorted by codewords. The i-th entry of 
+ * the index is index of the first item with codeword greater than or equal 
+ * to (i << SNAPSHOT_PAGE_BITS), the last entry is the number of items.
+ *
+ * @param pages      page index with (page_count + 1) entries
+ * @param page_count number of pages
+ * @param count      number of items
+ * @param key        function returning codeword of a given item
+ */
+template <class K>
+static void page_index(uint32_t* pages, size_t page_count, size_t count, 
+    K key) {
+    size_t i = 0;
+    
+    for (size_t p = 0; p < page_count; p++) {
+        while (i < count && key(i) < ((uint64_t)p << SNAPSHOT_PAGE_BITS))
+            i++;
+        pages[p] = i;
+    }
+    
+    pages[page_count] = count;
+}
+
+dictionary_snapshot::origin::origin(const char* alzw_file, 
+    const std::string& rseq) {
+    archive_size = utils::file_size(alzw_file);
+    archive_hash = utils::file_checksum(alzw_file);
+    rseq_length  = rseq.length();
+    rseq_hash    = utils::checksum(rseq.data(), rseq.length());
+}
+
+dictionary_snapshot::dictionary_snapshot(const decoder& dec, 
+    const origin& o) {
+    image = NULL;
+    image_size = 0;
+    mapped = false;
+    
+    build(dec, o);
+    init();
+}
+
+dictionary_snapshot::dictionary_snapshot(const char* file) {
+    struct stat st;
+    void* addr;
+    int fd;
+    
+    if ((fd = open(file, O_RDONLY)) == -1)
+        throw io_exception("unable to open dictionary snapshot: %s", file);
+    
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        throw io_exception("unable to stat dictionary snapshot: %s", file);
+    }
+    
+    if ((size_t)st.st_size < sizeof(header)) {
+        close(fd);
+        throw parse_exception("dictionary snapshot is truncated: %s", file);
+    }
+    
+    addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    
+    if (addr == MAP_FAILED)
+        throw io_exception("unable to map dictionary snapshot: %s", file);
+    
+    image = (uint8_t*)addr;
+    image_size = st.st_size;
+    mapped = true;
+    
+    try {
+        init();
+    } catch (...) {
+        munmap(image, image_size);
+        throw;
+    }
+}
+
+dictionary_snapshot::~dictionary_snapshot() {
+    if (mapped)
+        munmap(image, image_size);
+    else
+        delete [] image;
+}
+
+void dictionary_snapshot::init() {
+    hdr = (const header*)image;
+    
+    if (memcmp(hdr->magic, SNAPSHOT_MAGIC, sizeof(hdr->magic)))
+        throw parse_exception("not a dictionary snapshot");
+    if (hdr->byte_order != SNAPSHOT_BOM)
+        throw parse_exception("dictionary snapshot was created on a platform with different byte order");
+    if (hdr->version != SNAPSHOT_VERSION)
+        throw parse_exception("unsupported dictionary snapshot version: %u", hdr->version);
+    
+    uint64_t block_count = (hdr->node_count 
+        + (1 << SNAPSHOT_BLOCK_BITS) - 1) >> SNAPSHOT_BLOCK_BITS;
+    uint64_t page_size = (hdr->page_count + 1) * sizeof(uint32_t);
+    
+    if (hdr->size != image_size
+        || hdr->page_count != (hdr->used_nodes >> SNAPSHOT_PAGE_BITS) + 1
+        || hdr->nodes_offset + hdr->node_count * sizeof(snapshot_node) > image_size
+        || hdr->blocks_offset + block_count * sizeof(uint64_t) > image_size
+        || hdr->node_pages_offset + page_size > image_size
+        || hdr->phrase_pages_offset + page_size > image_size
+        || hdr->phrases_offset + hdr->phrase_count > image_size
+        || hdr->runs_offset + hdr->run_count * sizeof(run) > image_size
+        || hdr->symbols_offset + ((hdr->used_nodes + 3) >> 2) > image_size)
+        throw parse_exception("dictionary snapshot is corrupted");
+    
+    nodes        = (const snapshot_node*)(image + hdr->nodes_offset);
+    blocks       = (const uint64_t*)(image + hdr->blocks_offset);
+    node_pages   = (const uint32_t*)(image + hdr->node_pages_offset);
+    phrase_pages = (const uint32_t*)(image + hdr->phrase_pages_offset);
+    phrases      = image + hdr->phrases_offset;
+    runs         = (const run*)(image + hdr->runs_offset);
+    symbols      = image + hdr->symbols_offset;
+}
+
+void dictionary_snapshot::build(const decoder& dec, const origin& o) {
+    const dictionary& dict = dec.get_dictionary();
+    const node* root = dict.get_root();
+    const node* children[256];
+    std::vector<const node*> dnodes;
+    std::vector<const node*> stack;
+    const node* n;
+    
+    // collect all nodes reachable from the root
+    stack.push_back(root);
+    while (!stack.empty()) {
+        n = stack.back();
+        stack.pop_back();
+        if (n != root)
+            dnodes.push_back(n);
+        
+        n->get_children(children);
+        for (unsigned i = 0; i < n->degree(); i++)
+            stack.push_back(children[i]);
+    }
+    
+    const std::vector<bool>& dphrases = dec.get_phrases();
+    size_t phrase_count = std::count(dphrases.begin(), dphrases.end(), true);
+    
+    if (dnodes.size() >= SNAPSHOT_ROOT || phrase_count >= SNAPSHOT_ROOT)
+        throw runtime_exception("dictionary is too large for a snapshot");
+    
+    std::sort(dnodes.begin(), dnodes.end(), node_id_less);
+    
+    // pack symbols of all codewords, every node covers codewords from its 
+    // ID to its ID + length of its collapsed sequence
+    uint64_t used_nodes = dict.used_nodes();
+    std::vector<uint8_t> dsymbols((used_nodes + 3) >> 2);
+    std::vector<run> druns;
+    std::vector<bool> nruns(dnodes.size());
+    uint64_t cw, id;
+    uint32_t len;
+    uint8_t sym;
+    
+    for (size_t i = 0; i < dnodes.size(); i++) {
+        n   = dnodes[i];
+        id  = n->id();
+        len = n->length();
+        
+        if (len & SNAPSHOT_N_RUNS)
+            throw runtime_exception("dictionary is too large for a snapshot");
+        if ((id + len) >= used_nodes)
+            throw runtime_exception("unknown codeword: 0x%016lx", (unsigned long)(id + len));
+        
+        for (uint32_t j = 0; j <= len; j++) {
+            cw  = id + j;
+            sym = j > 0 ? n->get_base(j - 1) : n->symbol();
+            if (sym != NODE_N_SYMBOL) {
+                dsymbols[cw >> 2] |= sym << ((cw & 3) << 1);
+                continue;
+            }
+            
+            nruns[i] = true;
+            if (!druns.empty() && druns.back().end == cw)
+                druns.back().end++;
+            else {
+                run r = { cw, cw + 1 };
+                druns.push_back(r);
+            }
+        }
+    }
+    
+    uint64_t block_count = (dnodes.size() 
+        + (1 << SNAPSHOT_BLOCK_BITS) - 1) >> SNAPSHOT_BLOCK_BITS;
+    uint64_t page_count  = (used_nodes >> SNAPSHOT_PAGE_BITS) + 1;
+    uint64_t page_size   = (page_count + 1) * sizeof(uint32_t);
+    
+    uint64_t nodes_offset        = SNAPSHOT_ALIGN(sizeof(header));
+    uint64_t blocks_offset       = SNAPSHOT_ALIGN(nodes_offset
+        + dnodes.size() * sizeof(snapshot_node));
+    uint64_t node_pages_offset   = SNAPSHOT_ALIGN(blocks_offset
+        + block_count * sizeof(uint64_t));
+    uint64_t phrase_pages_offset = SNAPSHOT_ALIGN(node_pages_offset 
+        + page_size);
+    uint64_t phrases_offset      = SNAPSHOT_ALIGN(phrase_pages_offset 
+        + page_size);
+    uint64_t runs_offset         = SNAPSHOT_ALIGN(phrases_offset 
+        + phrase_count);
+    uint64_t symbols_offset      = SNAPSHOT_ALIGN(runs_offset
+        + druns.size() * sizeof(run));
+    
+    image_size = SNAPSHOT_ALIGN(symbols_offset + dsymbols.size());
+    image = new uint8_t[image_size];
+    memset(image, 0, image_size);
+    
+    header* h = (header*)image;
+    memcpy(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic));
+    h->version             = SNAPSHOT_VERSION;
+    h->byte_order          = SNAPSHOT_BOM;
+    h->archive_size        = o.archive_size;
+    h->archive_hash        = o.archive_hash;
+    h->rseq_length         = o.rseq_length;
+    h->rseq_hash           = o.rseq_hash;
+    h->used_nodes          = used_nodes;
+    h->inode               = dict.get_inode()->id();
+    h->dnode               = dict.get_dnode()->id();
+    h->wnode               = dict.get_wnode()->id();
+    h->node_count          = dnodes.size();
+    h->phrase_count        = phrase_count;
+    h->run_count           = druns.size();
+    h->page_count          = page_count;
+    h->nodes_offset        = nodes_offset;
+    h->blocks_offset       = blocks_offset;
+    h->node_pages_offset   = node_pages_offset;
+    h->phrase_pages_offset = phrase_pages_offset;
+    h->phrases_offset      = phrases_offset;
+    h->runs_offset         = runs_offset;
+    h->symbols_offset      = symbols_offset;
+    h->size                = image_size;
+    
+    snapshot_node* snodes = (snapshot_node*)(image + nodes_offset);
+    uint64_t* sblocks = (uint64_t*)(image + blocks_offset);
+    uint64_t base = 0;
+    
+    for (size_t i = 0; i < dnodes.size(); i++) {
+        n  = dnodes[i];
+        id = n->id();
+        
+        if ((i & ((1 << SNAPSHOT_BLOCK_BITS) - 1)) == 0)
+            sblocks[i >> SNAPSHOT_BLOCK_BITS] = base = id;
+        if ((id - base) > 0xffffffff)
+            throw runtime_exception("dictionary is too large for a snapshot");
+        
+        snapshot_node& sn = snodes[i];
+        sn.ido  = id - base;
+        sn.plen = n->phrase_length();
+        sn.len  = n->length();
+        
+        if (nruns[i])
+            sn.len |= SNAPSHOT_N_RUNS;
+        
+        if (n->parent() == root)
+            sn.par = SNAPSHOT_ROOT;
+        else
+            sn.par = find_node(dnodes, n->parent()->id());
+    }
+    
+    page_index((uint32_t*)(image + node_pages_offset), page_count, 
+        dnodes.size(), [&](size_t i) { return dnodes[i]->id(); });
+    
+    // the phrase index is ordered by codewords, so is the phrase table
+    std::vector<uint64_t> pcws;
+    uint8_t* sphrases = image + phrases_offset;
+    int64_t index = -1;
+    
+    pcws.reserve(phrase_count);
+    
+    for (cw = 0; cw < dphrases.size(); cw++) {
+        if (!dphrases[cw])
+            continue;
+        
+        while ((size_t)(index + 1) < dnodes.size() && dnodes[index + 1]->id() <= cw)
+            index++;
+        
+        if (index < 0 || cw > (dnodes[index]->id() + dnodes[index]->length()))
+            throw runtime_exception("unknown codeword: 0x%016lx", (unsigned long)cw);
+        
+        *sphrases++ = cw & SNAPSHOT_PAGE_MASK;
+        pcws.push_back(cw);
+    }
+    
+    page_index((uint32_t*)(image + phrase_pages_offset), page_count, 
+        phrase_count, [&](size_t i) { return pcws[i]; });
+    
+    memcpy(image + runs_offset, druns.data(), druns.size() * sizeof(run));
+    memcpy(image + symbols_offset, dsymbols.data(), dsymbols.size());
+}
+
+dictionary_snapshot * dictionary_snapshot::create(const std::string& rseq,
+    const char* alzw_file, size_t chunk) {
+    return create(rseq, alzw_file, chunk, origin(alzw_file, rseq));
+}
+
+dictionary_snapshot * dictionary_snapshot::create(const std::string& rseq,
+    const char* alzw_file, size_t chunk, const origin& o) {
+    file_breader br(alzw_file);
+    archive_header hdr;
+    decoder dec(rseq);
+    
+    hdr.read(br);
+    dec.set_coder(hdr.get_coder());
+    
+    seek_index* index = seek_index::load(alzw_file);
+    
+    if (index) {
+        hdr.read_segments(br, *index);
+        hdr.read_budget(*index);
+    } else if (hdr.has_budget())
+        throw runtime_exception("missing seek index of an ALZW stream with dictionary budget");
+    
+    if (chunk >= hdr.chunks()) {
+        delete index;
+        throw runtime_exception("no such chunk: %lu", (unsigned long)chunk);
+    }
+    
+    size_t first = hdr.chunk_start(chunk);
+    
+    if (index) {
+        if (index->sequences() != hdr.sequences()) {
+            delete index;
+            throw runtime_exception("seek index does not match the ALZW stream");
+        }
+        
+        if (first > 0)
+            br.seek(index->sequence_start(first)->offset);
+        
+        delete index;
+    } else if (first > 0)
+        throw runtime_exception("seek index does not match the ALZW stream");
+    
+    // sequences encoded using a frozen dictionary do not change it
+    size_t seqc = std::min(hdr.chunk_end(chunk), hdr.freeze_point());
+    for (size_t i = first; i < seqc; i++) {
+        if (hdr.is_segment_start(i))
+            hdr.skip_segment(br);
+        dec.decode(br);
+    }
+    
+    return new dictionary_snapshot(dec, o);
+}
+
+std::string dictionary_snapshot::snapshot_file(const char* alzw_file, 
+    size_t chunk) {
+    char buffer[32];
+    
+    if (chunk == 0)
+        return std::string(alzw_file) + ".dict";
+    
+    snprintf(buffer, sizeof(buffer), ".dict.%lu", (unsigned long)chunk);
+    
+    return std::string(alzw_file) + buffer;
+}
+
+void dictionary_snapshot::save(const char* file) const {
+    std::string tmp_file = std::string(file) + ".tmp";
+    
+    FILE* fout = fopen(tmp_file.c_str(), "wb");
+    if (!fout)
+        throw io_exception("unable to open output file: %s", tmp_file.c_str());
+    
+    if (fwrite(image, sizeof(uint8_t), image_size, fout) != image_size
+        || fflush(fout) || fsync(fileno(fout))) {
+        fclose(fout);
+        remove(tmp_file.c_str());
+        throw io_exception("unable to write output file: %s", tmp_file.c_str());
+    }
+    
+    if (fclose(fout) || rename(tmp_file.c_str(), file)) {
+        remove(tmp_file.c_str());
+        throw io_exception("unable to replace dictionary snapshot: %s", file);
+    }
+}
+
+bool dictionary_snapshot::matches(const origin& o) const {
+    return hdr->archive_size == o.archive_size
+        && hdr->archive_hash == o.archive_hash
+        && hdr->rseq_length == o.rseq_length
+        && hdr->rseq_hash == o.rseq_hash;
+}
+
+size_t dictionary_snapshot::phrase_slot(uint64_t cw) const {
+    uint64_t page = cw >> SNAPSHOT_PAGE_BITS;
+    if (page >= hdr->page_count)
+        return hdr->phrase_count;
+    
+    uint8_t offset = cw & SNAPSHOT_PAGE_MASK;
+    size_t l = phrase_pages[page];
+    size_t r = phrase_pages[page + 1];
+    size_t m;
+    
+    while (l < r) {
+        m = (l + r) >> 1;
+        if (phrases[m] < offset)
+            l = m + 1;
+        else
+            r = m;
+    }
+    
+    return l;
+}
+
+const snapshot_node * dictionary_snapshot::get_node(uint64_t cw) const {
+    uint64_t page = std::min(cw >> SNAPSHOT_PAGE_BITS, hdr->page_count - 1);
+    size_t l = node_pages[page];
+    size_t r = node_pages[page + 1];
+    size_t m;
+    
+    while (l < r) {
+        m = (l + r) >> 1;
+        if (id(nodes + m) <= cw)
+            l = m + 1;
+        else
+            r = m;
+    }
+    
+    if (l == 0 || cw > (id(nodes + l - 1) + nodes[l - 1].length()))
+        return NULL;
+    
+    return nodes + l - 1;
+}
+
+void dictionary_snapshot::get_symbols(const snapshot_node* n, uint64_t cw, 
+    uint32_t count, uint8_t* dst) const {
+    uint64_t end = cw + count;
+    uint32_t i = 0;
+    
+    for (; i < count && (cw & 3); i++, cw++)
+        dst[i] = (symbols[cw >> 2] >> ((cw & 3) << 1)) & 3;
+    
+    for (; (i + 4) <= count; i += 4, cw += 4)
+        memcpy(dst + i, symbol_table.symbols[symbols[cw >> 2]], 4);
+    
+    for (; i < count; i++, cw++)
+        dst[i] = (symbols[cw >> 2] >> ((cw & 3) << 1)) & 3;
+    
+    if (!(n->len & SNAPSHOT_N_RUNS))
+        return;
+    
+    cw = end - count;
+    
+    for (size_t j = find_run(cw); j < hdr->run_count && runs[j].start < end; j++) {
+        uint64_t start = std::max(runs[j].start, cw);
+        memset(dst + (start - cw), NODE_N_SYMBOL, 
+            std::min(runs[j].end, end) - start);
+    }
+}
+
+size_t dictionary_snapshot::find_run(uint64_t cw) const {
+    size_t l = 0;
+    size_t r = hdr->run_count;
+    size_t m;
+    
+    while (l < r) {
+        m = (l + r) >> 1;
+        if (runs[m].end <= cw)
+            l = m + 1;
+        else
+            r = m;
+    }
+    
+    return l;
+}
+
+bool dictionary_snapshot::in_run(uint64_t cw) const {
+    size_t i = find_run(cw);
+    return i < hdr->run_count && runs[i].start <= cw;
+}
+
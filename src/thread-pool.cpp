@@ -0,0 +1,104 @@
+/*
+Copyright (c) 2015 Perutka, Ondrej
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "thread-pool.hpp"
+
+using namespace alzw;
+
+thread_pool::thread_pool(size_t threads) {
+    running = 0;
+    stop = false;
+    
+    if (threads < 1)
+        threads = 1;
+    
+    for (size_t i = 0; i < threads; i++)
+        workers.push_back(std::thread(&thread_pool::worker, this));
+}
+
+thread_pool::~thread_pool() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done_cv.wait(lock, [this] { return tasks.empty() && running == 0; });
+        stop = true;
+    }
+    
+    task_cv.notify_all();
+    
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+void thread_pool::worker() {
+    std::function<void()> task;
+    
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            task_cv.wait(lock, [this] { return stop || !tasks.empty(); });
+            if (tasks.empty())
+                return;
+            
+            task = tasks.front();
+            tasks.pop_front();
+            running++;
+        }
+        
+        try {
+            task();
+        } catch (...) {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (!error)
+                error = std::current_exception();
+        }
+        
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            running--;
+            if (tasks.empty() && running == 0)
+                done_cv.notify_all();
+        }
+    }
+}
+
+void thread_pool::submit(const std::function<void()>& task) {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        tasks.push_back(task);
+    }
+    
+    task_cv.notify_one();
+}
+
+void thread_pool::wait() {
+    std::exception_ptr ex;
+    
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done_cv.wait(lock, [this] { return tasks.empty() && running == 0; });
+        ex = error;
+        error = std::exception_ptr();
+    }
+    
+    if (ex)
+        std::rethrow_exception(ex);
+}
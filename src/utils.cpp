@@ -22,8 +22,17 @@ THE SOFTWARE.
 
 #include <sstream>
 #include <cstring>
+#include <cstdlib>
+#include <algorithm>
 #include <ctime>
 #include <unistd.h>
+#include <sys/stat.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "utils.hpp"
 #include "exception.hpp"
@@ -119,6 +128,41 @@ char alzw::utils::base2char(uint8_t base) {
     return ALPHABET[base];
 }
 
+size_t alzw::utils::match_run(const char* s1, const char* s2, size_t len) {
+    size_t i = 0;
+    
+#if defined(__AVX2__)
+    const __m256i gap = _mm256_set1_epi8('-');
+    
+    for (; (i + 32) <= len; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(s1 + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(s2 + i));
+        uint32_t eq = _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+        uint32_t gp = _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, gap));
+        uint32_t mask = ~eq | gp;
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+#elif defined(__SSE2__)
+    const __m128i gap = _mm_set1_epi8('-');
+    
+    for (; (i + 16) <= len; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(s1 + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(s2 + i));
+        uint32_t eq = _mm_movemask_epi8(_mm_cmpeq_epi8(a, b));
+        uint32_t gp = _mm_movemask_epi8(_mm_cmpeq_epi8(a, gap));
+        uint32_t mask = (~eq | gp) & 0xffff;
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+#endif
+    
+    while (i < len && s1[i] == s2[i] && s1[i] != '-')
+        i++;
+    
+    return i;
+}
+
 int alzw::utils::number_width(uint64_t n) {
     int w = 0;
     
@@ -130,6 +174,93 @@ int alzw::utils::number_width(uint64_t n) {
     return w;
 }
 
+size_t alzw::utils::file_size(const char* file) {
+    struct stat st;
+    
+    if (stat(file, &st) == -1)
+        throw io_exception("unable to stat file: %s", file);
+    
+    return st.st_size;
+}
+
+/**
+ * Update FNV-1a hash with given data.
+ *
+ * @param hash current hash
+ * @param data data
+ * @param len  data length in bytes
+ * @returns updated hash
+ */
+static uint64_t fnv1a(uint64_t hash, const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++)
+        hash = (hash ^ data[i]) * 0x100000001b3ULL;
+    
+    return hash;
+}
+
+uint64_t alzw::utils::file_checksum(const char* file) {
+    uint8_t buffer[65536];
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    size_t len;
+    
+    FILE* fin = fopen(file, "rb");
+    if (!fin)
+        throw io_exception("unable to open input file: %s", file);
+    
+    while ((len = fread(buffer, sizeof(uint8_t), sizeof(buffer), fin)) > 0)
+        hash = fnv1a(hash, buffer, len);
+    
+    bool error = ferror(fin);
+    fclose(fin);
+    
+    if (error)
+        throw io_exception("error while reading from a file");
+    
+    return hash;
+}
+
+uint64_t alzw::utils::checksum(const void* data, size_t len) {
+    return fnv1a(0xcbf29ce484222325ULL, (const uint8_t*)data, len);
+}
+
+std::vector<size_t> alzw::utils::parse_seq_list(const char* list) {
+    std::vector<size_t> seqs;
+    const char* p = list;
+    char* end;
+    size_t first, last;
+    
+    while (*p) {
+        first = last = strtoul(p, &end, 10);
+        if (end == p)
+            throw parse_exception("invalid sequence list: %s", list);
+        
+        if (*end == '-') {
+            p = end + 1;
+            last = strtoul(p, &end, 10);
+            if (end == p)
+                throw parse_exception("invalid sequence list: %s", list);
+        }
+        
+        if (first == 0 || first > last)
+            throw parse_exception("invalid sequence range in list: %s", list);
+        
+        for (size_t i = first; i <= last; i++)
+            seqs.push_back(i);
+        
+        if (*end == ',')
+            end++;
+        else if (*end)
+            throw parse_exception("invalid sequence list: %s", list);
+        
+        p = end;
+    }
+    
+    std::sort(seqs.begin(), seqs.end());
+    seqs.erase(std::unique(seqs.begin(), seqs.end()), seqs.end());
+    
+    return seqs;
+}
+
 double alzw::utils::time() {
 #if defined(_POSIX_TIMERS) && (_POSIX_TIMERS > 0)
 	clockid_t id;
@@ -157,3 +288,27 @@ double alzw::utils::time() {
 	return -1;
 }
 
+double alzw::utils::thread_time() {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != -1)
+        return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+#endif
+    
+    return time();
+}
+
+double alzw::utils::wall_time() {
+    struct timespec ts;
+    
+#if defined(CLOCK_MONOTONIC)
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != -1)
+        return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+#endif
+    
+    if (clock_gettime(CLOCK_REALTIME, &ts) == -1)
+        return -1;
+    
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
@@ -0,0 +1,69 @@
+#!/bin/sh
+#
+# Tests of FASTA alignment input: alignments read from a FIFO and
+# alignments containing empty sequences.
+#
+# usage: test/fasta-input.sh [BINDIR]
+
+BIN=$(cd "${1:-bin}" && pwd)
+TMP=$(mktemp -d)
+FAILED=0
+
+trap 'rm -rf "$TMP"' EXIT
+
+fail() {
+    echo "FAILED: $1"
+    FAILED=1
+}
+
+mkdir "$TMP/file" "$TMP/fifo"
+cd "$TMP"
+
+# reference and a pairwise alignment spanning several input blocks
+awk 'BEGIN {
+    srand(7);
+    for (i = 0; i < 20000; i++)
+        r = r substr("ACGT", int(rand() * 4) + 1, 1);
+    a = r;
+    for (i = 0; i < 200; i++) {
+        p = int(rand() * 19990) + 1;
+        a = substr(a, 1, p - 1) (i % 2 ? "-" : "T") substr(a, p + 1);
+    }
+    print ">ref" > "ref.fa";
+    print ">ref" > "file/a.fa";
+    for (i = 1; i <= 20000; i += 60) {
+        print substr(r, i, 60) > "ref.fa";
+        print substr(r, i, 60) > "file/a.fa";
+    }
+    print ">seq" > "file/a.fa";
+    for (i = 1; i <= 20000; i += 60)
+        print substr(a, i, 60) > "file/a.fa";
+}'
+
+# a FIFO cannot be read twice, the output must not differ from a file
+mkfifo fifo/a.fa
+cat file/a.fa > fifo/a.fa &
+(cd fifo && "$BIN/alzw" a.fa > ../fifo.alzw 2> ../fifo.log) \
+    || fail "compression of a FIFO: $(tail -n 1 fifo.log)"
+(cd file && "$BIN/alzw" a.fa > ../file.alzw 2> /dev/null) \
+    || fail "compression of a file"
+cmp -s fifo.alzw file.alzw || fail "FIFO and file compress differently"
+
+# empty sequences are ignored (in files and in FIFOs)
+printf ">r\nACGTACGTNN\n" > r.fa
+printf ">r\nACGTACGTNN\n>e\n>s\nACG-ACGTAA\n" > e.fa
+printf ">e\n\n>r\nACGTACGTNN\n>e\n\n>s\nACG-ACGTAA\n>x\n" > ee.fa
+for f in e ee; do
+    rm -f $f.fa.fa
+    "$BIN/alzw" $f.fa > $f.alzw 2> $f.log \
+        || fail "empty sequences in $f.fa: $(tail -n 1 $f.log)"
+    "$BIN/alzw" -d r.fa $f.alzw 2> /dev/null
+    [ "$(tail -n 1 $f.fa.fa)" = "ACGACGTAA" ] || fail "decoding of $f.fa"
+
+    cat $f.fa | "$BIN/alzw" /dev/stdin > /dev/null 2> $f.log \
+        || fail "empty sequences in piped $f.fa: $(tail -n 1 $f.log)"
+done
+
+[ $FAILED -eq 0 ] && echo "fasta-input: ok"
+
+exit $FAILED